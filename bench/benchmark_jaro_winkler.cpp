@@ -0,0 +1,373 @@
+/* SPDX-License-Identifier: MIT */
+/* Copyright © 2022-present Max Bachmann */
+
+/*
+ * Microbenchmarks calling the C++ implementation directly, so changes of the kernels can be
+ * judged separately from changes of the Python bindings. Like bench/benchmark_jaro_winkler.py
+ * every benchmark compares one string with PAIR_COUNT other strings of the same length.
+ *
+ * The benchmarks sweep
+ *   len         length of the strings. Up to 64 characters the single word kernel is used,
+ *               longer strings use the kernel working on blocks of 64 characters. The many
+ *               benchmark scores strings of up to 16 characters with the SIMD kernel instead
+ *   alphabet    binary, dna, ascii (printable characters) or cjk. cjk strings use 32 bit
+ *               characters, which are looked up through the hashmap instead of a table
+ *   similarity  random strings, similar strings with about 10% substituted characters and a
+ *               transposition, or equal strings
+ *
+ * Besides the time they report
+ *   ns/pair     time per comparison
+ *   cycles/char cycles per character of both strings, estimated from the nominal clock rate
+ *
+ * On Linux the hardware counters cycles, instructions, branch-misses, L1d-misses and LLC-misses
+ * are read with perf_event_open and reported per pair as e.g. branch-misses/pair. Counters which
+ * can not be opened (no PMU in a virtual machine, perf_event_paranoid > 2) are left out.
+ *
+ * Build with -DJAROWINKLER_BUILD_BENCHMARKS=ON and run e.g.
+ *   ./benchmark_jaro_winkler --benchmark_filter='CachedJaroWinkler/len:64/alphabet:1'
+ */
+
+#include <benchmark/benchmark.h>
+#include <jarowinkler/jarowinkler.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#    include <linux/perf_event.h>
+#    include <sys/ioctl.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
+#endif
+
+namespace {
+
+enum Alphabet { BINARY, DNA, ASCII, CJK };
+enum Similarity { RANDOM, SIMILAR, EQUAL };
+
+const char* const ALPHABET_NAMES[] = {"binary", "dna", "ascii", "cjk"};
+const char* const SIMILARITY_NAMES[] = {"random", "similar", "equal"};
+const std::vector<int64_t> LENGTHS = {1, 4, 8, 16, 32, 63, 64, 65, 128, 256, 512};
+
+const size_t PAIR_COUNT = 256;
+
+uint32_t random_char(Alphabet alphabet, std::mt19937& rng)
+{
+    switch (alphabet) {
+    case BINARY: return 'a' + rng() % 2;
+    case DNA: return static_cast<uint32_t>("ACGT"[rng() % 4]);
+    case ASCII: return 32 + rng() % 95;
+    default: return 0x4E00 + rng() % 2000; /* CJK unified ideographs */
+    }
+}
+
+/**
+ * @brief hardware counters of the calling thread, excluding the kernel. Events, which can not be
+ * opened are skipped, so on other platforms the counters are simply empty
+ */
+class PerfCounters {
+public:
+    PerfCounters()
+    {
+#ifdef __linux__
+        auto cache_miss = [](uint64_t cache) {
+            return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        };
+        open("cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        open("instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        open("branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+        open("L1d-misses", PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_L1D));
+        open("LLC-misses", PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_LL));
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    ~PerfCounters()
+    {
+#ifdef __linux__
+        for (const auto& event : m_events)
+            close(event.second);
+#endif
+    }
+
+    void start()
+    {
+#ifdef __linux__
+        for (const auto& event : m_events)
+            ioctl(event.second, PERF_EVENT_IOC_RESET, 0);
+        for (const auto& event : m_events)
+            ioctl(event.second, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    }
+
+    /**
+     * @brief stops counting and returns the counts since start. Multiplexed counters are scaled
+     * to the time the events were enabled
+     */
+    std::vector<std::pair<const char*, double>> stop()
+    {
+        std::vector<std::pair<const char*, double>> counts;
+#ifdef __linux__
+        for (const auto& event : m_events)
+            ioctl(event.second, PERF_EVENT_IOC_DISABLE, 0);
+
+        for (const auto& event : m_events) {
+            uint64_t values[3]; /* value, time enabled, time running */
+            if (read(event.second, values, sizeof(values)) != static_cast<ssize_t>(sizeof(values))) continue;
+            if (values[2] == 0) continue;
+            counts.emplace_back(event.first, static_cast<double>(values[0]) * static_cast<double>(values[1]) /
+                                                 static_cast<double>(values[2]));
+        }
+#endif
+        return counts;
+    }
+
+private:
+#ifdef __linux__
+    void open(const char* name, uint32_t type, uint64_t config)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.type = type;
+        attr.size = sizeof(attr);
+        attr.config = config;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        long fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fd >= 0) m_events.emplace_back(name, static_cast<int>(fd));
+    }
+#endif
+
+    std::vector<std::pair<const char*, int>> m_events;
+};
+
+template <typename CharT>
+struct Workload {
+    std::vector<CharT> s1;
+    std::vector<std::vector<CharT>> s2;
+    /* characters of both strings summed over all pairs */
+    double chars;
+};
+
+template <typename CharT>
+Workload<CharT> make_workload(size_t length, Alphabet alphabet, Similarity similarity)
+{
+    /* fixed seed, so every run compares the same strings */
+    std::mt19937 rng(18);
+    auto random_string = [&]() {
+        std::vector<CharT> str(length);
+        for (CharT& ch : str)
+            ch = static_cast<CharT>(random_char(alphabet, rng));
+        return str;
+    };
+
+    Workload<CharT> workload;
+    workload.s1 = random_string();
+    for (size_t i = 0; i < PAIR_COUNT; ++i) {
+        if (similarity == RANDOM) {
+            workload.s2.push_back(random_string());
+            continue;
+        }
+
+        std::vector<CharT> str = workload.s1;
+        if (similarity == SIMILAR) {
+            for (size_t edit = 0; edit < std::max<size_t>(1, length / 10); ++edit)
+                str[rng() % length] = static_cast<CharT>(random_char(alphabet, rng));
+            if (length > 1) {
+                size_t pos = rng() % (length - 1);
+                std::swap(str[pos], str[pos + 1]);
+            }
+        }
+        workload.s2.push_back(std::move(str));
+    }
+    workload.chars = static_cast<double>(2 * length * PAIR_COUNT);
+    return workload;
+}
+
+/**
+ * @brief measures the time and the hardware counters of the benchmark loop. The benchmarks call
+ * start directly before and stop directly after their loop, so the preparation of the scorer and
+ * the arguments is not included
+ */
+class LoopTimer {
+public:
+    void start()
+    {
+        m_perf.start();
+        m_start = std::chrono::steady_clock::now();
+    }
+
+    void stop()
+    {
+        m_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+        m_perf_counts = m_perf.stop();
+    }
+
+    double seconds() const
+    {
+        return m_seconds;
+    }
+
+    const std::vector<std::pair<const char*, double>>& perf_counts() const
+    {
+        return m_perf_counts;
+    }
+
+private:
+    /* opening the counters takes several syscalls, so it is done outside of the measured range */
+    PerfCounters m_perf;
+    std::chrono::steady_clock::time_point m_start;
+    double m_seconds = 0.0;
+    std::vector<std::pair<const char*, double>> m_perf_counts;
+};
+
+/**
+ * @brief kernel used for strings of the given length
+ *
+ * @param simd_many similarity_many, which scores Latin-1 strings of up to 16 characters with the
+ *   SIMD kernel when the CPU supports it
+ */
+const char* kernel_name(size_t length, bool simd_many)
+{
+    if (simd_many && length > 0 && static_cast<int64_t>(length) <= jaro_winkler::detail::SIMD_BUCKET_MAX_LEN[1] &&
+        jaro_winkler::detail::simd_vector_bytes(jaro_winkler::detail::simd_level()))
+        return "simd";
+    return (length <= 64) ? "single-word" : "multi-word";
+}
+
+/**
+ * @brief creates the workload for the arguments of state and passes it to bench together with a
+ * LoopTimer, which bench starts and stops around the benchmark loop. Afterwards the counters are
+ * reported for PAIR_COUNT comparisons per iteration
+ */
+template <typename CharT, typename Func>
+void run(benchmark::State& state, Func bench, bool simd_many = false)
+{
+    size_t length = static_cast<size_t>(state.range(0));
+    Alphabet alphabet = static_cast<Alphabet>(state.range(1));
+    Similarity similarity = static_cast<Similarity>(state.range(2));
+    const Workload<CharT> workload = make_workload<CharT>(length, alphabet, similarity);
+
+    /* inverted rate counters would be printed in seconds, so the time is measured here as well */
+    LoopTimer timer;
+    bench(workload, timer);
+
+    double iterations = static_cast<double>(std::max<benchmark::IterationCount>(1, state.iterations()));
+    double cycles_per_second = benchmark::CPUInfo::Get().cycles_per_second;
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(PAIR_COUNT));
+    state.counters["ns/pair"] = timer.seconds() * 1e9 / (iterations * PAIR_COUNT);
+    state.counters["cycles/char"] = timer.seconds() * cycles_per_second / (iterations * workload.chars);
+    for (const auto& count : timer.perf_counts())
+        state.counters[std::string(count.first) + "/pair"] = count.second / (iterations * PAIR_COUNT);
+    state.SetLabel(std::string(ALPHABET_NAMES[alphabet]) + "/" + SIMILARITY_NAMES[similarity] + "/" +
+                   kernel_name(length, simd_many));
+}
+
+/* the cjk alphabet needs 32 bit characters, all others are stored in bytes */
+template <typename Func>
+void run_any(benchmark::State& state, Func bench)
+{
+    if (state.range(1) == CJK)
+        run<uint32_t>(state, bench);
+    else
+        run<uint8_t>(state, bench);
+}
+
+template <typename Workload>
+using CharOf = typename decltype(Workload::s1)::value_type;
+
+void BM_Jaro(benchmark::State& state)
+{
+    run_any(state, [&](const auto& workload, LoopTimer& timer) {
+        timer.start();
+        for (auto _ : state)
+            for (const auto& s2 : workload.s2)
+                benchmark::DoNotOptimize(
+                    jaro_winkler::jaro_similarity(workload.s1.begin(), workload.s1.end(), s2.begin(), s2.end()));
+        timer.stop();
+    });
+}
+
+void BM_JaroWinkler(benchmark::State& state)
+{
+    run_any(state, [&](const auto& workload, LoopTimer& timer) {
+        timer.start();
+        for (auto _ : state)
+            for (const auto& s2 : workload.s2)
+                benchmark::DoNotOptimize(jaro_winkler::jarowinkler_similarity(workload.s1.begin(), workload.s1.end(),
+                                                                              s2.begin(), s2.end()));
+        timer.stop();
+    });
+}
+
+/* the bit masks of s1 are calculated once outside of the timed loop, so only the kernel is measured */
+void BM_CachedJaroWinkler(benchmark::State& state)
+{
+    run_any(state, [&](const auto& workload, LoopTimer& timer) {
+        using CharT = CharOf<typename std::decay<decltype(workload)>::type>;
+        jaro_winkler::CachedJaroWinklerSimilarity<CharT> scorer(workload.s1.begin(), workload.s1.end());
+
+        timer.start();
+        for (auto _ : state)
+            for (const auto& s2 : workload.s2)
+                benchmark::DoNotOptimize(scorer.similarity(s2.begin(), s2.end()));
+        timer.stop();
+    });
+}
+
+/* byte strings are compared several at a time using the SIMD kernel for up to 16 characters. Longer
+ * strings and CPUs without SIMD support fall back to the single-word and multi-word kernels */
+void BM_CachedJaroWinklerMany(benchmark::State& state)
+{
+    auto bench = [&](const Workload<uint8_t>& workload, LoopTimer& timer) {
+        jaro_winkler::CachedJaroWinklerSimilarity<uint8_t> scorer(workload.s1.begin(), workload.s1.end());
+        std::vector<const uint8_t*> data;
+        std::vector<int64_t> lengths;
+        for (const auto& s2 : workload.s2) {
+            data.push_back(s2.data());
+            lengths.push_back(static_cast<int64_t>(s2.size()));
+        }
+        std::vector<double> scores(PAIR_COUNT);
+
+        timer.start();
+        for (auto _ : state) {
+            scorer.similarity_many(data.data(), lengths.data(), data.size(), scores.data());
+            benchmark::DoNotOptimize(scores.data());
+        }
+        timer.stop();
+    };
+    run<uint8_t>(state, bench, true);
+}
+
+void all_args(benchmark::internal::Benchmark* bench)
+{
+    bench->ArgNames({"len", "alphabet", "similarity"});
+    bench->ArgsProduct({LENGTHS, {BINARY, DNA, ASCII, CJK}, {RANDOM, SIMILAR, EQUAL}});
+}
+
+void latin1_args(benchmark::internal::Benchmark* bench)
+{
+    bench->ArgNames({"len", "alphabet", "similarity"});
+    bench->ArgsProduct({LENGTHS, {BINARY, DNA, ASCII}, {RANDOM, SIMILAR, EQUAL}});
+}
+
+} // namespace
+
+BENCHMARK(BM_Jaro)->Apply(all_args);
+BENCHMARK(BM_JaroWinkler)->Apply(all_args);
+BENCHMARK(BM_CachedJaroWinkler)->Apply(all_args);
+BENCHMARK(BM_CachedJaroWinklerMany)->Apply(latin1_args);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,405 @@
+"""
+Benchmark runner, which stores machine readable results and compares them to a baseline.
+
+    # measure and store the results
+    python bench/benchmark_regression.py run -o results/current.json
+
+    # compare two results, exits with 1 when a length bucket regressed
+    python bench/benchmark_regression.py compare results/baseline.json results/current.json
+
+    # both in one step, e.g. before a release
+    python bench/benchmark_regression.py run -o current.json --baseline results/baseline.json
+
+Every scenario is measured ``--repetitions`` times. The results store the time per pair of every
+repetition together with their median and median absolute deviation (MAD), and the context of
+the run (CPU model, compiler, commit, Python and library version). ``--native`` additionally runs
+the Google Benchmark binary built with -DJAROWINKLER_BUILD_BENCHMARKS=ON.
+
+On Linux the hardware performance counters of perf_counters.py (cycles, instructions,
+branch-misses, L1d-misses and LLC-misses) are read around every scenario and stored per pair. The
+report shows their change next to the timings, to tell apart e.g. branch mispredictions from
+cache misses. Counters, which are not available, are skipped.
+
+The random suite compares uniformly random strings like benchmark_jaro_winkler.py. The realistic
+suite runs one to one, one to many and thresholded (score_cutoff=0.9) matching on names,
+addresses, token lists and long documents generated by corpus_generator.py.
+
+The lengths are grouped into buckets matching the kernel paths. A bucket regressed when the
+geometric mean of the ratios current / baseline of its lengths exceeds 1 + threshold and the
+slowdown is larger than 3 times the noise estimated from the MAD of both runs.
+
+results/jaro_winkler.csv (written by benchmark_jaro_winkler.py) can be passed as baseline as well.
+It only holds a single timing per length from an unknown machine, so its noise is assumed to be 0
+and the comparison is only meaningful for results measured on the same machine.
+"""
+
+import argparse
+import csv
+import itertools
+import json
+import math
+import os
+import platform
+import random
+import statistics
+import string
+import subprocess
+import sys
+import time
+
+from perf_counters import EVENTS, PerfCounters, describe
+
+BENCH_DIR = os.path.dirname(os.path.abspath(__file__))
+REPO_DIR = os.path.dirname(BENCH_DIR)
+
+LENGTHS = list(range(1, 512, 4))
+# SIMD kernel for Latin-1 choices, single 64 bit word, blocks of 64 characters
+BUCKETS = [(1, 16), (17, 64), (65, 128), (129, 256), (257, 512), (513, None)]
+# scale factor of the MAD for a consistent estimate of the standard deviation
+MAD_TO_SIGMA = 1.4826
+
+
+def cpu_model():
+    if sys.platform.startswith("linux"):
+        try:
+            with open("/proc/cpuinfo") as f:
+                for line in f:
+                    if line.startswith("model name"):
+                        return line.split(":", 1)[1].strip()
+        except OSError:
+            pass
+    elif sys.platform == "darwin":
+        try:
+            return subprocess.check_output(["sysctl", "-n", "machdep.cpu.brand_string"], text=True).strip()
+        except (OSError, subprocess.CalledProcessError):
+            pass
+    return platform.processor() or platform.machine()
+
+
+def git_commit():
+    try:
+        commit = subprocess.check_output(["git", "rev-parse", "HEAD"], cwd=REPO_DIR, text=True).strip()
+        dirty = subprocess.check_output(
+            ["git", "status", "--porcelain", "--untracked-files=no"], cwd=REPO_DIR, text=True
+        )
+    except (OSError, subprocess.CalledProcessError):
+        return None
+    return commit + ("-dirty" if dirty.strip() else "")
+
+
+def run_context():
+    import jarowinkler
+    from jarowinkler import _initialize_cpp
+
+    return {
+        "cpu": cpu_model(),
+        "cpu_count": os.cpu_count(),
+        "platform": platform.platform(),
+        "compiler": getattr(_initialize_cpp, "_compiler", None),
+        "python": platform.python_implementation() + " " + platform.python_version(),
+        "jarowinkler": jarowinkler.__version__,
+        "commit": git_commit(),
+        "date": time.strftime("%Y-%m-%dT%H:%M:%S%z"),
+    }
+
+
+def summarize(name, length, samples, counters=None):
+    median = statistics.median(samples)
+    mad = statistics.median(abs(x - median) for x in samples)
+    result = {"name": name, "length": length, "samples": samples, "median": median, "mad": mad}
+    if counters:
+        result["counters"] = counters
+    return result
+
+
+def measure(func, pairs, repetitions, perf):
+    """
+    time per pair of every repetition. One call is made before measuring, so caches are warm.
+    The performance counters are summed over the repetitions and reported per pair
+    """
+    func()
+    samples = []
+    counts = {}
+    for _ in range(repetitions):
+        perf.start()
+        start = time.perf_counter()
+        func()
+        samples.append((time.perf_counter() - start) / pairs)
+        for event, value in perf.stop().items():
+            counts[event] = counts.get(event, 0) + value
+    return samples, {event: value / (pairs * repetitions) for event, value in counts.items()}
+
+
+def format_counters(counters):
+    return ", ".join(f"{event} {value:.1f}" for event, value in counters.items())
+
+
+def python_scenarios(lengths, count):
+    """
+    the workload of benchmark_jaro_winkler.py, so the results can be compared with its csv file
+    """
+    from jarowinkler import jarowinkler_similarity
+
+    characters = string.ascii_letters + string.digits + string.whitespace + string.punctuation
+    for length in lengths:
+        random.seed(18)
+        a = "".join(random.choice(characters) for _ in range(length))
+        b_list = ["".join(random.choice(characters) for _ in range(length)) for _ in range(count)]
+        yield "python/jarowinkler_similarity", length, count, lambda a=a, b_list=b_list: [
+            jarowinkler_similarity(a, b) for b in b_list
+        ]
+
+
+def realistic_scenarios(count):
+    """
+    one to one, one to many and thresholded matching on the data of corpus_generator.py. The
+    length of these scenarios is the median length of the records
+    """
+    import corpus_generator
+    from jarowinkler import extract, jarowinkler_similarity, jarowinkler_similarity_many
+
+    # documents are about 100 times longer than the other records
+    for kind, records, query_count in [
+        ("names", count, 20),
+        ("addresses", count, 20),
+        ("tokens", count, 20),
+        ("documents", count // 20, 5),
+    ]:
+        pairs = corpus_generator.generate_pairs(kind, records)
+        choices = corpus_generator.generate(kind, records)
+        queries = corpus_generator.generate_queries(kind, choices, query_count)
+        length = sorted(len(choice) for choice in choices)[len(choices) // 2]
+        name = f"realistic/{kind}"
+
+        yield f"{name}/one-to-one", length, len(pairs), lambda pairs=pairs: [
+            jarowinkler_similarity(a, b) for a, b in pairs
+        ]
+        yield f"{name}/one-to-many", length, len(queries) * len(choices), lambda q=queries, c=choices: [
+            jarowinkler_similarity_many(query, c) for query in q
+        ]
+        yield f"{name}/threshold-0.9", length, len(queries) * len(choices), lambda q=queries, c=choices: [
+            extract(query, c, score_cutoff=0.9, limit=None) for query in q
+        ]
+
+
+def run_scenarios(scenarios, repetitions, perf):
+    results = []
+    for name, length, pairs, func in scenarios:
+        results.append(summarize(name, length, *measure(func, pairs, repetitions, perf)))
+        line = f"{name} length={length}: {results[-1]['median'] * 1e9:.1f} ns/pair"
+        if "counters" in results[-1]:
+            line += f" ({format_counters(results[-1]['counters'])} per pair)"
+        print(line, file=sys.stderr)
+    return results
+
+
+def run_native(binary, repetitions, benchmark_filter):
+    """
+    runs the Google Benchmark binary and collects ns/pair of every repetition
+    """
+    output = subprocess.check_output(
+        [
+            binary,
+            f"--benchmark_filter={benchmark_filter}",
+            f"--benchmark_repetitions={repetitions}",
+            "--benchmark_format=json",
+        ],
+        text=True,
+    )
+    samples = {}
+    counters = {}
+    for bench in json.loads(output)["benchmarks"]:
+        if bench.get("run_type") != "iteration":
+            continue
+        # e.g. BM_CachedJaroWinkler/len:64/alphabet:2/similarity:0
+        parts = bench["run_name"].split("/")
+        length = int(next(p for p in parts if p.startswith("len:"))[4:])
+        name = "native/" + "/".join(p for p in parts if not p.startswith("len:"))
+        samples.setdefault((name, length), []).append(bench["ns/pair"] * 1e-9)
+        for event in EVENTS:
+            if f"{event}/pair" in bench:
+                counters.setdefault((name, length), {}).setdefault(event, []).append(bench[f"{event}/pair"])
+    return [
+        summarize(
+            name,
+            length,
+            values,
+            {event: statistics.mean(counts) for event, counts in counters.get((name, length), {}).items()},
+        )
+        for (name, length), values in sorted(samples.items())
+    ]
+
+
+def load_results(path):
+    """
+    results written by run, or the csv file of benchmark_jaro_winkler.py
+    """
+    if path.endswith(".csv"):
+        with open(path, newline="") as f:
+            rows = list(csv.DictReader(f))
+        results = [
+            summarize("python/jarowinkler_similarity", int(row["length"]), [float(row["jarowinkler"])]) for row in rows
+        ]
+        return {"context": {"source": os.path.basename(path)}, "results": results}
+
+    with open(path) as f:
+        return json.load(f)
+
+
+def bucket_of(length):
+    for low, high in BUCKETS:
+        if low <= length and (high is None or length <= high):
+            return low, high
+    return None
+
+
+def bucket_label(bucket):
+    low, high = bucket
+    return f"{low}-{high}" if high else f"{low}+"
+
+
+def compare(baseline, current, threshold):
+    """
+    compares the buckets of every scenario found in both results
+
+    Returns
+    -------
+    rows : list[dict]
+        one row per scenario and bucket with the keys name, bucket, ratio, noise and regressed, and
+        counters with the ratio of every performance counter measured in both results
+    """
+    base = {(r["name"], r["length"]): r for r in baseline["results"]}
+    groups = {}
+    for cur in current["results"]:
+        ref = base.get((cur["name"], cur["length"]))
+        bucket = bucket_of(cur["length"])
+        if ref is None or bucket is None or ref["median"] <= 0 or cur["median"] <= 0:
+            continue
+        groups.setdefault((cur["name"], bucket), []).append((ref, cur))
+
+    rows = []
+    for (name, bucket), pairs in sorted(groups.items()):
+        log_ratios = [math.log(cur["median"] / ref["median"]) for ref, cur in pairs]
+        ratio = math.exp(sum(log_ratios) / len(log_ratios))
+        # relative noise of a single length, the mean over the bucket has less noise
+        rel_noise = [
+            MAD_TO_SIGMA * math.hypot(ref["mad"] / ref["median"], cur["mad"] / cur["median"]) for ref, cur in pairs
+        ]
+        noise = statistics.median(rel_noise) / math.sqrt(len(pairs))
+        regressed = ratio - 1 > threshold and ratio - 1 > 3 * noise
+
+        counters = {}
+        for event in EVENTS:
+            values = [
+                (ref["counters"][event], cur["counters"][event])
+                for ref, cur in pairs
+                if ref.get("counters", {}).get(event, 0) > 0 and cur.get("counters", {}).get(event, 0) > 0
+            ]
+            if values:
+                counters[event] = math.exp(statistics.mean(math.log(c / r) for r, c in values))
+        row = {"name": name, "bucket": bucket, "ratio": ratio, "noise": noise, "regressed": regressed}
+        rows.append(dict(row, counters=counters))
+    return rows
+
+
+def print_report(rows, baseline, current, threshold):
+    for title, results in (("baseline", baseline), ("current", current)):
+        context = results.get("context", {})
+        details = ", ".join(f"{key}={value}" for key, value in context.items() if value is not None)
+        print(f"{title}: {details}")
+    if baseline.get("context", {}).get("cpu") != current.get("context", {}).get("cpu"):
+        print("warning: the results were measured on different CPUs")
+    print()
+
+    print(f"{'scenario':<60} {'bucket':>9} {'change':>8} {'noise':>7}  status")
+    for row in rows:
+        status = "REGRESSION" if row["regressed"] else "ok"
+        print(
+            f"{row['name']:<60} {bucket_label(row['bucket']):>9} {(row['ratio'] - 1) * 100:>+7.1f}% "
+            f"{row['noise'] * 100:>6.1f}%  {status}"
+        )
+
+    # shows whether a slowdown comes with more instructions, branch or cache misses
+    events = [event for event in EVENTS if any(event in row["counters"] for row in rows)]
+    if events:
+        print()
+        print("change of the performance counters per pair")
+        print(f"{'scenario':<60} {'bucket':>9} " + " ".join(f"{event:>13}" for event in events))
+        for row in rows:
+            changes = [
+                f"{(row['counters'][event] - 1) * 100:>+12.1f}%" if event in row["counters"] else f"{'-':>13}"
+                for event in events
+            ]
+            print(f"{row['name']:<60} {bucket_label(row['bucket']):>9} " + " ".join(changes))
+
+    regressions = [row for row in rows if row["regressed"]]
+    print()
+    if not rows:
+        print("no common scenarios found")
+    elif regressions:
+        print(f"{len(regressions)} of {len(rows)} buckets are more than {threshold:.0%} slower than the baseline")
+    else:
+        print(f"no bucket is more than {threshold:.0%} slower than the baseline")
+    return not regressions
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    run = commands.add_parser("run", help="measure and write the results")
+    run.add_argument("-o", "--output", required=True, help="json file the results are written to")
+    run.add_argument("--repetitions", type=int, default=11)
+    run.add_argument("--count", type=int, default=4000, help="strings compared per repetition")
+    run.add_argument("--lengths", type=int, nargs="+", default=LENGTHS, help="string lengths of the random suite")
+    run.add_argument(
+        "--suite",
+        nargs="+",
+        choices=["random", "realistic"],
+        default=["random", "realistic"],
+        help="random strings like benchmark_jaro_winkler.py and/or the data of corpus_generator.py",
+    )
+    run.add_argument("--native", help="Google Benchmark binary benchmark_jaro_winkler to run as well")
+    run.add_argument(
+        "--native-filter",
+        default="BM_CachedJaroWinkler/.*/alphabet:2/similarity:[01]$",
+        help="--benchmark_filter passed to the native binary",
+    )
+    run.add_argument("--no-perf", action="store_true", help="do not read the hardware performance counters")
+    run.add_argument("--baseline", help="compare the results to this baseline")
+    run.add_argument("--threshold", type=float, default=0.1, help="allowed slowdown, default 0.1 (10%%)")
+
+    cmp = commands.add_parser("compare", help="compare results to a baseline")
+    cmp.add_argument("baseline", help="json file written by run or results/jaro_winkler.csv")
+    cmp.add_argument("current", help="json file written by run")
+    cmp.add_argument("--threshold", type=float, default=0.1, help="allowed slowdown, default 0.1 (10%%)")
+
+    args = parser.parse_args(argv)
+    if args.command == "run":
+        scenarios = []
+        if "random" in args.suite:
+            scenarios = itertools.chain(scenarios, python_scenarios(args.lengths, args.count))
+        if "realistic" in args.suite:
+            scenarios = itertools.chain(scenarios, realistic_scenarios(args.count))
+        perf = PerfCounters({} if args.no_perf else EVENTS)
+        if not args.no_perf:
+            print(describe(perf), file=sys.stderr)
+        context = dict(run_context(), perf_counters=perf.available)
+        results = {"context": context, "results": run_scenarios(scenarios, args.repetitions, perf)}
+        perf.close()
+        if args.native:
+            results["results"] += run_native(args.native, args.repetitions, args.native_filter)
+        with open(args.output, "w") as f:
+            json.dump(results, f, indent=2)
+        if not args.baseline:
+            return 0
+        baseline, current = load_results(args.baseline), results
+    else:
+        baseline, current = load_results(args.baseline), load_results(args.current)
+
+    rows = compare(baseline, current, args.threshold)
+    return 0 if print_report(rows, baseline, current, args.threshold) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
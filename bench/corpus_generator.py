@@ -0,0 +1,263 @@
+"""
+Deterministic generator of synthetic benchmark data resembling real matching workloads:
+
+    names       person names in several formats with typos
+    addresses   postal addresses with abbreviations and typos
+    tokens      lists of tokens, e.g. product titles split into words
+    documents   long texts of several thousand characters
+
+Unlike uniformly random strings the records share prefixes and contain near-duplicates, so the
+prefix boost of Jaro-Winkler and the early exits for a score_cutoff behave like in production.
+The same seed always produces the same data, independent of the platform and without any
+downloads, so results of different runs can be compared.
+
+    python bench/corpus_generator.py names --count 10 --seed 1
+"""
+
+import argparse
+import random
+
+FIRST_NAMES = [
+    "James", "Mary", "Robert", "Patricia", "John", "Jennifer", "Michael", "Linda", "David", "Elizabeth",
+    "William", "Barbara", "Richard", "Susan", "Joseph", "Jessica", "Thomas", "Sarah", "Christopher", "Karen",
+    "Charles", "Lisa", "Daniel", "Nancy", "Matthew", "Margaret", "Anthony", "Sandra", "Mark", "Ashley",
+    "Jonathan", "Johnathan", "Jon", "Catherine", "Katherine", "Kathryn", "Stephen", "Steven", "Maximilian",
+    "Jürgen", "Zoë", "José", "François", "Søren", "Małgorzata", "Nguyễn", "Siobhán", "Mohammed", "Muhammad",
+]  # fmt: skip
+LAST_NAMES = [
+    "Smith", "Johnson", "Williams", "Brown", "Jones", "Garcia", "Miller", "Davis", "Rodriguez", "Martinez",
+    "Hernandez", "Lopez", "Gonzalez", "Wilson", "Anderson", "Thomas", "Taylor", "Moore", "Jackson", "Martin",
+    "Lee", "Perez", "Thompson", "White", "Harris", "Sanchez", "Clark", "Ramirez", "Lewis", "Robinson",
+    "Schmidt", "Schmitt", "Schmid", "Müller", "Mueller", "Meyer", "Meier", "Mayer", "O'Brien", "McDonald",
+    "MacDonald", "Van der Berg", "Vandenberg", "De la Cruz", "Kowalski", "Kowalsky", "Nakamura", "Øster",
+]  # fmt: skip
+STREETS = [
+    "Main", "Oak", "Pine", "Maple", "Cedar", "Elm", "Washington", "Lake", "Hill", "Park", "Sunset", "Railroad",
+    "Church", "Highland", "Mill", "Jefferson", "Lincoln", "Madison", "Ridge", "Meadow", "Forest", "River",
+]  # fmt: skip
+# full street suffix and its common abbreviations
+STREET_SUFFIXES = [
+    ("Street", ["St", "St.", "Str"]),
+    ("Avenue", ["Ave", "Ave.", "Av"]),
+    ("Road", ["Rd", "Rd."]),
+    ("Boulevard", ["Blvd", "Blvd."]),
+    ("Drive", ["Dr", "Dr."]),
+    ("Lane", ["Ln", "Ln."]),
+]
+CITIES = [
+    ("Springfield", "IL"), ("Riverside", "CA"), ("Franklin", "TN"), ("Greenville", "SC"), ("Bristol", "CT"),
+    ("Clinton", "IA"), ("Fairview", "OR"), ("Salem", "MA"), ("Madison", "WI"), ("Georgetown", "TX"),
+]  # fmt: skip
+WORDS = (
+    "the of and to in is was for on that with as by at from his it an were are which be this has also "
+    "or had first one their its new after but who not they have her she two been other when there all "
+    "during into school time may years more most only over city some world would where later up such "
+    "used many can state about national out known university united then made system company number "
+    "product quality price delivery customer service order account record address report value data "
+    "stainless steel wireless bluetooth charger cable adapter black white silver pack set large small"
+).split()
+# neighbouring keys on a qwerty keyboard, used for substitutions
+KEYBOARD = {
+    "a": "qwsz", "b": "vghn", "c": "xdfv", "d": "serfcx", "e": "wsdr", "f": "drtgvc", "g": "ftyhbv",
+    "h": "gyujnb", "i": "ujko", "j": "huikmn", "k": "jiolm", "l": "kop", "m": "njk", "n": "bhjm",
+    "o": "iklp", "p": "ol", "q": "wa", "r": "edft", "s": "awedxz", "t": "rfgy", "u": "yhji", "v": "cfgb",
+    "w": "qase", "x": "zsdc", "y": "tghu", "z": "asx",
+}  # fmt: skip
+
+
+def typo(rng, text):
+    """
+    applies a single substitution, deletion, insertion or transposition of characters
+    """
+    if len(text) < 2:
+        return text + rng.choice("aeiou")
+    pos = rng.randrange(len(text) - 1)
+    kind = rng.random()
+    if kind < 0.4:
+        ch = text[pos]
+        neighbours = KEYBOARD.get(ch.lower(), "aeiou")
+        return text[:pos] + rng.choice(neighbours) + text[pos + 1 :]
+    if kind < 0.6:
+        return text[:pos] + text[pos + 1 :]
+    if kind < 0.8:
+        return text[:pos] + text[pos] + text[pos:]
+    return text[:pos] + text[pos + 1] + text[pos] + text[pos + 2 :]
+
+
+def add_typos(rng, text, rate):
+    """
+    on average one typo per 1 / rate characters, but at least one
+    """
+    for _ in range(max(1, round(len(text) * rate * rng.uniform(0.5, 1.5)))):
+        text = typo(rng, text)
+    return text
+
+
+def name(rng):
+    first, last = rng.choice(FIRST_NAMES), rng.choice(LAST_NAMES)
+    return f"{first} {rng.choice('ABCDEFGHJKLMNPRSTW')}. {last}" if rng.random() < 0.2 else f"{first} {last}"
+
+
+def name_variant(rng, text, rate):
+    """
+    the same person as written in another record
+    """
+    parts = text.split(" ")
+    kind = rng.random()
+    if kind < 0.15:
+        text = f"{parts[-1]}, {' '.join(parts[:-1])}"
+    elif kind < 0.3:
+        text = text.upper()
+    elif kind < 0.4 and len(parts) > 1:
+        text = f"{parts[0][0]}. {' '.join(parts[1:])}"
+    return add_typos(rng, text, rate)
+
+
+def address(rng):
+    suffix, _ = rng.choice(STREET_SUFFIXES)
+    city, state = rng.choice(CITIES)
+    unit = f", Apt {rng.randint(1, 40)}" if rng.random() < 0.3 else ""
+    return (
+        f"{rng.randint(1, 9999)} {rng.choice(STREETS)} {suffix}{unit}, "
+        f"{city}, {state} {rng.randint(10000, 99999)}"
+    )
+
+
+def address_variant(rng, text, rate):
+    for suffix, abbreviations in STREET_SUFFIXES:
+        if f" {suffix}" in text and rng.random() < 0.6:
+            text = text.replace(f" {suffix}", f" {rng.choice(abbreviations)}", 1)
+    if rng.random() < 0.2:
+        text = text.replace(",", "")
+    return add_typos(rng, text, rate)
+
+
+def tokens(rng):
+    return [rng.choice(WORDS) for _ in range(rng.randint(3, 12))]
+
+
+def tokens_variant(rng, value, rate):
+    value = list(value)
+    for _ in range(max(1, round(len(value) * rate * 5))):
+        kind = rng.random()
+        pos = rng.randrange(len(value))
+        if kind < 0.4:
+            value[pos] = rng.choice(WORDS)
+        elif kind < 0.6 and len(value) > 1:
+            del value[pos]
+        elif kind < 0.8:
+            value.insert(pos, rng.choice(WORDS))
+        elif pos + 1 < len(value):
+            value[pos], value[pos + 1] = value[pos + 1], value[pos]
+    return value
+
+
+def document(rng):
+    sentences = []
+    length = rng.randint(2000, 4000)
+    while sum(len(s) for s in sentences) < length:
+        words = [rng.choice(WORDS) for _ in range(rng.randint(6, 20))]
+        sentences.append(" ".join(words).capitalize() + ". ")
+    return "".join(sentences)[:length]
+
+
+def document_variant(rng, text, rate):
+    """
+    a revision of the document with some sentences removed and typos added
+    """
+    sentences = text.split(". ")
+    for _ in range(max(1, len(sentences) // 20)):
+        del sentences[rng.randrange(len(sentences))]
+    return add_typos(rng, ". ".join(sentences), rate)
+
+
+KINDS = {
+    "names": (name, name_variant),
+    "addresses": (address, address_variant),
+    "tokens": (tokens, tokens_variant),
+    "documents": (document, document_variant),
+}
+
+
+def generate(kind, count, seed=0, duplicate_rate=0.3, typo_rate=0.05):
+    """
+    generates count records, of which about duplicate_rate are variants of an earlier record
+
+    Parameters
+    ----------
+    kind : str
+        one of names, addresses, tokens or documents
+    count : int
+        number of records
+    seed : int
+        seed of the random number generator
+    duplicate_rate : float
+        fraction of records, which are variants of an earlier record
+    typo_rate : float
+        typos per character in a variant
+
+    Returns
+    -------
+    records : list
+        strings, or lists of strings for tokens
+    """
+    make, variant = KINDS[kind]
+    rng = random.Random(f"{kind}-{seed}")
+    records = []
+    for _ in range(count):
+        if records and rng.random() < duplicate_rate:
+            records.append(variant(rng, rng.choice(records), typo_rate))
+        else:
+            records.append(make(rng))
+    return records
+
+
+def generate_pairs(kind, count, seed=0, match_rate=0.5, typo_rate=0.05):
+    """
+    generates count pairs to compare one to one. About match_rate of them are a record and a
+    variant of it, the others are two unrelated records
+
+    Returns
+    -------
+    pairs : list[tuple]
+        pairs of records
+    """
+    make, variant = KINDS[kind]
+    rng = random.Random(f"{kind}-pairs-{seed}")
+    pairs = []
+    for _ in range(count):
+        record = make(rng)
+        other = variant(rng, record, typo_rate) if rng.random() < match_rate else make(rng)
+        pairs.append((record, other))
+    return pairs
+
+
+def generate_queries(kind, records, count, seed=0, typo_rate=0.05):
+    """
+    generates count queries to look up in records. Every query is a variant of one of the records
+
+    Returns
+    -------
+    queries : list
+        strings, or lists of strings for tokens
+    """
+    _, variant = KINDS[kind]
+    rng = random.Random(f"{kind}-queries-{seed}")
+    return [variant(rng, rng.choice(records), typo_rate) for _ in range(count)]
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("kind", choices=sorted(KINDS))
+    parser.add_argument("--count", type=int, default=100)
+    parser.add_argument("--seed", type=int, default=0)
+    parser.add_argument("--duplicate-rate", type=float, default=0.3)
+    parser.add_argument("--typo-rate", type=float, default=0.05)
+    args = parser.parse_args(argv)
+
+    for record in generate(args.kind, args.count, args.seed, args.duplicate_rate, args.typo_rate):
+        print(" | ".join(record) if isinstance(record, list) else record)
+
+
+if __name__ == "__main__":
+    main()
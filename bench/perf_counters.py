@@ -0,0 +1,165 @@
+"""
+Hardware performance counters read through the Linux perf_event_open syscall.
+
+    counters = PerfCounters()
+    counters.start()
+    ...
+    values = counters.stop()  # e.g. {"cycles": 1234, "instructions": 5678, ...}
+
+Only the calling thread is counted and the kernel is excluded, which is permitted with the default
+perf_event_paranoid setting of 2. Counters, which can not be opened (other operating systems,
+virtual machines without a PMU, containers with seccomp filters) are left out of the values and
+the reason is stored in ``unavailable``, so callers can always use the class.
+"""
+
+import ctypes
+import os
+import platform
+import struct
+import sys
+
+# perf_event_open syscall numbers
+SYSCALLS = {
+    "x86_64": 298,
+    "AMD64": 298,
+    "i386": 336,
+    "i686": 336,
+    "aarch64": 241,
+    "arm64": 241,
+    "riscv64": 241,
+    "ppc64le": 319,
+    "ppc64": 319,
+    "s390x": 331,
+}
+
+PERF_TYPE_HARDWARE = 0
+PERF_TYPE_HW_CACHE = 3
+PERF_COUNT_HW_CPU_CYCLES = 0
+PERF_COUNT_HW_INSTRUCTIONS = 1
+PERF_COUNT_HW_BRANCH_MISSES = 5
+PERF_COUNT_HW_CACHE_L1D = 0
+PERF_COUNT_HW_CACHE_LL = 2
+PERF_COUNT_HW_CACHE_OP_READ = 0
+PERF_COUNT_HW_CACHE_RESULT_MISS = 1
+
+PERF_FORMAT_TOTAL_TIME_ENABLED = 1 << 0
+PERF_FORMAT_TOTAL_TIME_RUNNING = 1 << 1
+
+# bits of the flags field in perf_event_attr
+ATTR_DISABLED = 1 << 0
+ATTR_EXCLUDE_KERNEL = 1 << 5
+ATTR_EXCLUDE_HV = 1 << 6
+
+PERF_EVENT_IOC_ENABLE = 0x2400
+PERF_EVENT_IOC_DISABLE = 0x2401
+PERF_EVENT_IOC_RESET = 0x2403
+
+
+def cache_miss(cache):
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+
+
+EVENTS = {
+    "cycles": (PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES),
+    "instructions": (PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS),
+    "branch-misses": (PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES),
+    "L1d-misses": (PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_L1D)),
+    "LLC-misses": (PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_LL)),
+}
+
+
+def event_attr(event_type, config):
+    """
+    perf_event_attr in the layout of PERF_ATTR_SIZE_VER0 (64 bytes)
+    """
+    read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING
+    flags = ATTR_DISABLED | ATTR_EXCLUDE_KERNEL | ATTR_EXCLUDE_HV
+    return struct.pack("=IIQQQQQIIQ", event_type, 64, config, 0, 0, read_format, flags, 0, 0, 0)
+
+
+class PerfCounters:
+    def __init__(self, events=EVENTS):
+        self.fds = {}
+        self.unavailable = {}
+
+        if not sys.platform.startswith("linux"):
+            self.unavailable = {name: "perf_event_open requires Linux" for name in events}
+            return
+        syscall_nr = SYSCALLS.get(platform.machine())
+        if syscall_nr is None:
+            self.unavailable = {name: f"unknown architecture {platform.machine()}" for name in events}
+            return
+
+        libc = ctypes.CDLL(None, use_errno=True)
+        libc.syscall.restype = ctypes.c_long
+        for name, (event_type, config) in events.items():
+            attr = ctypes.create_string_buffer(event_attr(event_type, config))
+            # pid=0, cpu=-1: the calling thread on any CPU
+            fd = libc.syscall(ctypes.c_long(syscall_nr), attr, 0, -1, -1, ctypes.c_ulong(0))
+            if fd < 0:
+                self.unavailable[name] = os.strerror(ctypes.get_errno())
+            else:
+                self.fds[name] = fd
+
+    @property
+    def available(self):
+        return list(self.fds)
+
+    def close(self):
+        for fd in self.fds.values():
+            os.close(fd)
+        self.fds = {}
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+    def start(self):
+        # nothing is opened on other operating systems, which do not provide fcntl
+        if not self.fds:
+            return
+        import fcntl
+
+        for fd in self.fds.values():
+            fcntl.ioctl(fd, PERF_EVENT_IOC_RESET, 0)
+        for fd in self.fds.values():
+            fcntl.ioctl(fd, PERF_EVENT_IOC_ENABLE, 0)
+
+    def stop(self):
+        """
+        stops counting and returns the counts since start. When more events are opened than the
+        CPU has counters, the kernel multiplexes them and the counts are scaled to the full time
+        """
+        if not self.fds:
+            return {}
+        import fcntl
+
+        for fd in self.fds.values():
+            fcntl.ioctl(fd, PERF_EVENT_IOC_DISABLE, 0)
+
+        values = {}
+        for name, fd in self.fds.items():
+            value, enabled, running = struct.unpack("=QQQ", os.read(fd, 24))
+            if running:
+                values[name] = value * enabled / running
+        return values
+
+
+def describe(counters):
+    """
+    one line describing which counters are measured
+    """
+    reasons = {}
+    for name, reason in counters.unavailable.items():
+        reasons.setdefault(reason, []).append(name)
+    details = "; ".join(f"{', '.join(names)}: {reason}" for reason, names in reasons.items())
+    if not counters.available:
+        return f"perf counters unavailable ({details})"
+    if details:
+        return f"perf counters: {', '.join(counters.available)} (unavailable {details})"
+    return f"perf counters: {', '.join(counters.available)}"
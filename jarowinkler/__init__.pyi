@@ -1,4 +1,6 @@
-from typing import Callable, Hashable, Sequence, Optional, Union, TypeVar
+import os
+
+from typing import Any, Callable, Dict, Generic, Hashable, List, Sequence, Optional, Tuple, Union, TypeVar
 
 __author__: str
 __license__: str
@@ -18,3 +20,146 @@ def jarowinkler_similarity(
     prefix_weight: float = 0.1,
     processor: Optional[Callable[[Union[_S1, _S2]], _StringType]] = None,
     score_cutoff: Optional[float] = None) -> float: ...
+
+def jaro_similarity_many(
+    s1: _S1, choices: Sequence[Optional[_S2]], *,
+    processor: Optional[Callable[[Union[_S1, _S2]], _StringType]] = None,
+    score_cutoff: Optional[float] = None,
+    out: Any = None) -> Any: ...
+
+def jarowinkler_similarity_many(
+    s1: _S1, choices: Sequence[Optional[_S2]], *,
+    prefix_weight: float = 0.1,
+    processor: Optional[Callable[[Union[_S1, _S2]], _StringType]] = None,
+    score_cutoff: Optional[float] = None,
+    out: Any = None) -> Any: ...
+
+def cdist(
+    queries: Sequence[Optional[_S1]], choices: Sequence[Optional[_S2]], *,
+    scorer: Callable[..., float] = jarowinkler_similarity,
+    prefix_weight: float = 0.1,
+    processor: Optional[Callable[[Union[_S1, _S2]], _StringType]] = None,
+    score_cutoff: Optional[float] = None,
+    dtype: Any = None,
+    workers: Union[int, "ThreadPool"] = 1,
+    out: Any = None) -> Any: ...
+
+def self_join(
+    strings: Sequence[Optional[_S1]], score_cutoff: float, *,
+    scorer: Callable[..., float] = jarowinkler_similarity,
+    prefix_weight: float = 0.1,
+    processor: Optional[Callable[[_S1], _StringType]] = None,
+    dtype: Any = None,
+    workers: Union[int, "ThreadPool"] = 1) -> Tuple[memoryview, memoryview, memoryview]: ...
+
+def extract(
+    query: Optional[_S1], choices: Sequence[Optional[_S2]], *,
+    scorer: Callable[..., float] = jarowinkler_similarity,
+    prefix_weight: float = 0.1,
+    processor: Optional[Callable[[Union[_S1, _S2]], _StringType]] = None,
+    score_cutoff: Optional[float] = None,
+    limit: Optional[int] = 5) -> List[Tuple[_S2, float, int]]: ...
+
+class PreprocessedString(Sequence[Hashable]):
+    original: Any
+
+    def __len__(self) -> int: ...
+    def __getitem__(self, index: int) -> Any: ...  # type: ignore[override]
+
+class PreprocessedCorpus(Sequence[Optional[PreprocessedString]]):
+    strings: Tuple[Any, ...]
+    processor: Union[Callable[..., _StringType], "TokenVocabulary", None]
+
+    def __len__(self) -> int: ...
+    def __getitem__(self, index: int) -> Optional[PreprocessedString]: ...  # type: ignore[override]
+
+def preprocess(
+    strings: Sequence[Optional[_S1]],
+    processor: Optional[Callable[[_S1], _StringType]] = None) -> PreprocessedCorpus: ...
+
+def compile_corpus(
+    strings: Union[Sequence[Optional[str]], PreprocessedCorpus],
+    path: Union[str, bytes, "os.PathLike[str]", "os.PathLike[bytes]"],
+    processor: Optional[Callable[[str], _StringType]] = None) -> None: ...
+
+def load_corpus(
+    path: Union[str, bytes, "os.PathLike[str]", "os.PathLike[bytes]"],
+    mmap: bool = True) -> PreprocessedCorpus: ...
+
+class ThreadPool:
+    workers: int
+
+    def __init__(self, workers: int = -1) -> None: ...
+    def close(self) -> None: ...
+    def __enter__(self) -> "ThreadPool": ...
+    def __exit__(self, *args: Any) -> None: ...
+
+class TokenVocabulary:
+    tokens: Tuple[Hashable, ...]
+
+    def __init__(self, tokens: Sequence[Hashable] = ...) -> None: ...
+    def __len__(self) -> int: ...
+    def __contains__(self, token: object) -> bool: ...
+    def encode(
+        self, tokens: Union[str, Sequence[Hashable], None], *,
+        tokenizer: Optional[Callable[[Any], Sequence[Hashable]]] = None) -> Optional[PreprocessedString]: ...
+    def encode_corpus(
+        self, sequences: Sequence[Union[str, Sequence[Hashable], None]], *,
+        tokenizer: Optional[Callable[[Any], Sequence[Hashable]]] = None) -> PreprocessedCorpus: ...
+
+def histogram_filter_stats(*, reset: bool = False) -> Dict[str, int]: ...
+
+def enable_stats(enabled: bool = True) -> None: ...
+def get_stats() -> Dict[str, Any]: ...
+def reset_stats() -> None: ...
+
+class Processor:
+    def __init__(
+        self, *,
+        ascii_fold: bool = False,
+        lowercase: bool = False,
+        casefold: bool = False,
+        remove_punctuation: bool = False,
+        strip: bool = False) -> None: ...
+
+    def __call__(self, s: str) -> str: ...
+
+    def __or__(self, other: Processor) -> Processor: ...
+
+class JaroMatcher(Generic[_S1]):
+    pattern: _S1
+    processor: Optional[Callable[..., _StringType]]
+
+    def __init__(
+        self, pattern: _S1, *,
+        processor: Optional[Callable[..., _StringType]] = None) -> None: ...
+
+    def similarity(self, s2: Optional[_S2], *, score_cutoff: Optional[float] = None) -> float: ...
+
+class JaroWinklerMatcher(Generic[_S1]):
+    pattern: _S1
+    processor: Optional[Callable[..., _StringType]]
+    prefix_weight: float
+
+    def __init__(
+        self, pattern: _S1, *,
+        prefix_weight: float = 0.1,
+        processor: Optional[Callable[..., _StringType]] = None) -> None: ...
+
+    def similarity(self, s2: Optional[_S2], *, score_cutoff: Optional[float] = None) -> float: ...
+
+class JaroWinklerIndex(Generic[_S2]):
+    processor: Optional[Callable[..., _StringType]]
+    prefix_weight: float
+
+    def __init__(
+        self, choices: Sequence[Optional[_S2]], *,
+        prefix_weight: float = 0.1,
+        processor: Optional[Callable[..., _StringType]] = None) -> None: ...
+
+    def __len__(self) -> int: ...
+
+    def extract(
+        self, query: Optional[_S1], *,
+        score_cutoff: Optional[float] = None,
+        limit: Optional[int] = 5) -> List[Tuple[_S2, float, int]]: ...
@@ -0,0 +1,253 @@
+"""
+Record linkage between two CSV or JSONL files.
+
+Every record of the left file is compared with the records of the right file
+sharing the same block and all pairs with a Jaro-Winkler similarity of at least
+``--threshold`` are written to the output as soon as they are found::
+
+    python -m jarowinkler.link people.csv customers.jsonl \\
+        --left-field name --right-field full_name --block-prefix 1 \\
+        --threshold 0.9 --processes 4 -o matches.csv
+
+The inputs are memory-mapped. The right file is grouped into blocks, which are
+stored in a ``JaroWinklerIndex`` each, so only lengths which can reach the
+threshold are scored. The left file is streamed in chunks, which are split
+between ``--processes`` worker processes and ``--threads`` threads per process.
+"""
+
+from __future__ import annotations
+
+import argparse
+import csv
+import io
+import json
+import mmap
+import os
+import sys
+from concurrent.futures import ThreadPoolExecutor
+from itertools import islice
+from multiprocessing import get_context
+
+from jarowinkler import JaroWinklerIndex
+
+OUTPUT_FIELDS = ["left_id", "right_id", "left", "right", "score"]
+
+
+def _detect_format(path, fmt):
+    if fmt:
+        return fmt
+    return "jsonl" if path.endswith((".jsonl", ".ndjson", ".json")) else "csv"
+
+
+def _mapped_lines(path):
+    with open(path, "rb") as f:
+        if os.fstat(f.fileno()).st_size == 0:
+            return
+        with mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ) as mm:
+            for line in iter(mm.readline, b""):
+                yield line.decode("utf-8")
+
+
+def read_records(path, fmt=None):
+    """
+    Yields the records of a CSV (with header) or JSONL file as dicts
+    """
+    lines = _mapped_lines(path)
+    if _detect_format(path, fmt) == "csv":
+        yield from csv.DictReader(lines)
+        return
+
+    for line in lines:
+        if line.strip():
+            yield json.loads(line)
+
+
+def _block_key(record, value, config):
+    if config["block_field"]:
+        return record.get(config["block_field"])
+    if config["block_prefix"]:
+        return value[: config["block_prefix"]].lower()
+    return None
+
+
+def _keyed_records(path, fmt, field, id_field, config):
+    """
+    Yields (id, value, block) for every record with a value in field. Records
+    are identified by id_field, or by their position in the file
+    """
+    for pos, record in enumerate(read_records(path, fmt)):
+        value = record.get(field)
+        if value is None or value == "":
+            continue
+        value = str(value)
+        record_id = record.get(id_field) if id_field else pos
+        yield record_id, value, _block_key(record, value, config)
+
+
+# state of a worker, set up once per process by _init_worker
+_STATE = {}
+
+
+def _init_worker(config):
+    blocks = {}
+    for record_id, value, block in _keyed_records(
+        config["right"], config["right_format"], config["right_field"], config["right_id"], config
+    ):
+        ids, values = blocks.setdefault(block, ([], []))
+        ids.append(record_id)
+        values.append(value)
+
+    _STATE.clear()
+    _STATE["config"] = config
+    _STATE["blocks"] = {
+        block: (ids, JaroWinklerIndex(values, prefix_weight=config["prefix_weight"]))
+        for block, (ids, values) in blocks.items()
+    }
+    _STATE["pool"] = ThreadPoolExecutor(config["threads"]) if config["threads"] > 1 else None
+
+
+def _link_record(record):
+    left_id, value, block = record
+    entry = _STATE["blocks"].get(block)
+    if entry is None:
+        return []
+
+    ids, index = entry
+    matches = index.extract(value, score_cutoff=_STATE["config"]["threshold"], limit=None)
+    return [(left_id, ids[pos], value, choice, score) for choice, score, pos in matches]
+
+
+def _link_chunk(chunk):
+    pool = _STATE["pool"]
+    results = pool.map(_link_record, chunk) if pool else map(_link_record, chunk)
+    return [pair for pairs in results for pair in pairs]
+
+
+def _chunks(iterable, size):
+    it = iter(iterable)
+    while True:
+        chunk = list(islice(it, size))
+        if not chunk:
+            return
+        yield chunk
+
+
+class _Writer:
+    def __init__(self, out, fmt):
+        self.out = out
+        self.fmt = fmt
+        if fmt == "csv":
+            self.csv = csv.writer(out, lineterminator="\n")
+            self.csv.writerow(OUTPUT_FIELDS)
+
+    def write(self, pairs):
+        for pair in pairs:
+            if self.fmt == "csv":
+                self.csv.writerow(pair)
+            else:
+                self.out.write(json.dumps(dict(zip(OUTPUT_FIELDS, pair)), ensure_ascii=False) + "\n")
+        self.out.flush()
+
+
+def link(config, out):
+    """
+    Writes all matching pairs to out and returns their number
+    """
+    left = _keyed_records(config["left"], config["left_format"], config["left_field"], config["left_id"], config)
+    chunks = _chunks(left, config["chunk_size"])
+    writer = _Writer(out, config["output_format"])
+    count = 0
+
+    if config["processes"] <= 1:
+        _init_worker(config)
+        try:
+            for chunk in chunks:
+                pairs = _link_chunk(chunk)
+                writer.write(pairs)
+                count += len(pairs)
+        finally:
+            # unlike in the worker processes the state outlives the call, so the threads are stopped here
+            if _STATE["pool"] is not None:
+                _STATE["pool"].shutdown()
+            _STATE.clear()
+        return count
+
+    # the chunks are handed out on demand, so the left file is never fully loaded
+    ctx = get_context("spawn")
+    with ctx.Pool(config["processes"], initializer=_init_worker, initargs=(config,)) as pool:
+        for pairs in pool.imap_unordered(_link_chunk, chunks):
+            writer.write(pairs)
+            count += len(pairs)
+    return count
+
+
+def _parse_args(argv):
+    parser = argparse.ArgumentParser(
+        prog="python -m jarowinkler.link",
+        description="Writes all record pairs of two CSV/JSONL files whose Jaro-Winkler similarity "
+        "reaches the threshold.",
+    )
+    parser.add_argument("left", help="file whose records are searched for in the right file")
+    parser.add_argument("right", help="file with the records searched for")
+    parser.add_argument("--left-field", required=True, help="field of the left records which is compared")
+    parser.add_argument("--right-field", help="field of the right records which is compared (default: --left-field)")
+    parser.add_argument("--left-id", help="field identifying the left records (default: record number)")
+    parser.add_argument("--right-id", help="field identifying the right records (default: record number)")
+    parser.add_argument("--format", choices=["csv", "jsonl"], help="format of both inputs (default: by extension)")
+    block = parser.add_mutually_exclusive_group()
+    block.add_argument("--block-field", help="only compare records with the same value in this field")
+    block.add_argument(
+        "--block-prefix", type=int, default=0, help="only compare values with the same first N characters"
+    )
+    parser.add_argument("--threshold", type=float, default=0.9, help="minimum similarity of a pair (default: 0.9)")
+    parser.add_argument("--prefix-weight", type=float, default=0.1, help="prefix weight (default: 0.1)")
+    parser.add_argument("--processes", type=int, default=1, help="number of worker processes (default: 1)")
+    parser.add_argument("--threads", type=int, default=1, help="threads per worker process (default: 1)")
+    parser.add_argument("--chunk-size", type=int, default=1000, help="left records per task (default: 1000)")
+    parser.add_argument("-o", "--output", default="-", help="output file, - for stdout (default: -)")
+    parser.add_argument(
+        "--output-format", choices=["csv", "jsonl"], help="format of the output (default: by extension)"
+    )
+    args = parser.parse_args(argv)
+
+    if args.processes < 1 or args.threads < 1 or args.chunk_size < 1:
+        parser.error("--processes, --threads and --chunk-size have to be positive")
+    if not 0.0 <= args.prefix_weight <= 0.25:
+        parser.error("--prefix-weight has to be between 0.0 and 0.25")
+
+    output_format = args.output_format or ("csv" if args.output == "-" else _detect_format(args.output, None))
+    return {
+        "left": args.left,
+        "right": args.right,
+        "left_format": args.format,
+        "right_format": args.format,
+        "left_field": args.left_field,
+        "right_field": args.right_field or args.left_field,
+        "left_id": args.left_id,
+        "right_id": args.right_id,
+        "block_field": args.block_field,
+        "block_prefix": args.block_prefix,
+        "threshold": args.threshold,
+        "prefix_weight": args.prefix_weight,
+        "processes": args.processes,
+        "threads": args.threads,
+        "chunk_size": args.chunk_size,
+        "output": args.output,
+        "output_format": output_format,
+    }
+
+
+def main(argv=None):
+    config = _parse_args(argv)
+    if config["output"] == "-":
+        count = link(config, sys.stdout)
+    else:
+        with io.open(config["output"], "w", encoding="utf-8", newline="") as out:
+            count = link(config, out)
+
+    print(f"{count} matching pairs", file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
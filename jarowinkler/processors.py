@@ -0,0 +1,14 @@
+"""
+Native processors, which are applied in C++ while the strings are converted.
+They can be combined using ``|``, e.g. ``lowercase | strip``.
+"""
+
+from jarowinkler._initialize_cpp import Processor
+
+ascii_fold: Processor = Processor(ascii_fold=True)
+lowercase: Processor = Processor(lowercase=True)
+casefold: Processor = Processor(casefold=True)
+remove_punctuation: Processor = Processor(remove_punctuation=True)
+strip: Processor = Processor(strip=True)
+
+__all__ = ["Processor", "ascii_fold", "casefold", "lowercase", "remove_punctuation", "strip"]
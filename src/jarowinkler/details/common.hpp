@@ -0,0 +1,237 @@
+/* SPDX-License-Identifier: MIT */
+/* Copyright © 2022-present Max Bachmann */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+#include <jarowinkler/details/intrinsics.hpp>
+
+namespace jaro_winkler {
+namespace common {
+
+/**
+ * @brief converts a character into the unsigned key used for the bit masks.
+ * Signed character types are converted through their unsigned counterpart,
+ * so e.g. char(-1) is treated as 255 and not as 2^64-1
+ */
+template <typename CharT>
+static inline uint64_t to_key(CharT ch)
+{
+    static_assert(std::is_integral<CharT>::value, "only integral character types are supported");
+    return static_cast<uint64_t>(static_cast<typename std::make_unsigned<CharT>::type>(ch));
+}
+
+template <typename CharT1, typename CharT2>
+static inline bool mixed_sign_equal(CharT1 a, CharT2 b)
+{
+    return to_key(a) == to_key(b);
+}
+
+/**
+ * @brief open addressing hashmap mapping characters to bit masks. It is
+ * only used for characters >= 256 and holds at most 64 distinct keys,
+ * so 128 slots always leave free space for the probing to terminate.
+ * The probing sequence is the one used by CPython's dict.
+ */
+class BitvectorHashmap {
+public:
+    BitvectorHashmap() : m_map()
+    {}
+
+    uint64_t get(uint64_t key) const
+    {
+        return m_map[lookup(key)].value;
+    }
+
+    uint64_t& operator[](uint64_t key)
+    {
+        uint32_t i = lookup(key);
+        m_map[i].key = key;
+        return m_map[i].value;
+    }
+
+private:
+    uint32_t lookup(uint64_t key) const
+    {
+        uint32_t i = static_cast<uint32_t>(key % 128);
+
+        if (!m_map[i].value || m_map[i].key == key) return i;
+
+        uint64_t perturb = key;
+        while (true) {
+            i = (static_cast<uint32_t>(i) * 5 + static_cast<uint32_t>(perturb) + 1) % 128;
+            if (!m_map[i].value || m_map[i].key == key) return i;
+
+            perturb >>= 5;
+        }
+    }
+
+    struct MapElem {
+        uint64_t key = 0;
+        uint64_t value = 0;
+    };
+    std::array<MapElem, 128> m_map;
+};
+
+/**
+ * @brief replaces the hashmap of patterns which only consist of single byte
+ * characters. These patterns never contain a character >= 256
+ */
+struct EmptyBitvectorHashmap {
+    uint64_t get(uint64_t /*key*/) const
+    {
+        return 0;
+    }
+};
+
+/**
+ * @brief bit masks of the character positions for strings with up to 64 characters.
+ * Characters < 256 are looked up in a flat table. Patterns of single byte characters
+ * are created with ExtendedChars = false, which leaves out the hashmap for all other
+ * characters, so they are neither initialized nor probed
+ */
+template <bool ExtendedChars = true>
+class BasicPatternMatchVector {
+public:
+    BasicPatternMatchVector() : m_map(), m_extendedAscii()
+    {}
+
+    template <typename InputIt>
+    BasicPatternMatchVector(InputIt first, InputIt last) : m_map(), m_extendedAscii()
+    {
+        insert(first, last);
+    }
+
+    template <typename InputIt>
+    void insert(InputIt first, InputIt last)
+    {
+        uint64_t mask = 1;
+        for (; first != last; ++first) {
+            insert_mask(*first, mask);
+            mask <<= 1;
+        }
+    }
+
+    template <typename CharT>
+    void insert_mask(CharT ch, uint64_t mask)
+    {
+        static_assert(ExtendedChars || sizeof(CharT) == 1, "only single byte characters fit into the flat table");
+        uint64_t key = to_key(ch);
+        if (key < 256)
+            m_extendedAscii[key] |= mask;
+        else
+            insert_extended(std::integral_constant<bool, ExtendedChars>(), key, mask);
+    }
+
+    size_t size() const
+    {
+        return 1;
+    }
+
+    template <typename CharT>
+    uint64_t get(CharT ch) const
+    {
+        uint64_t key = to_key(ch);
+        if (key < 256)
+            return m_extendedAscii[key];
+        else
+            return m_map.get(key);
+    }
+
+    template <typename CharT>
+    uint64_t get(size_t /*block*/, CharT ch) const
+    {
+        return get(ch);
+    }
+
+private:
+    void insert_extended(std::true_type, uint64_t key, uint64_t mask)
+    {
+        m_map[key] |= mask;
+    }
+
+    void insert_extended(std::false_type, uint64_t /*key*/, uint64_t /*mask*/)
+    {}
+
+    typename std::conditional<ExtendedChars, BitvectorHashmap, EmptyBitvectorHashmap>::type m_map;
+    std::array<uint64_t, 256> m_extendedAscii;
+};
+
+using PatternMatchVector = BasicPatternMatchVector<true>;
+
+/**
+ * @brief the pattern match vector for patterns with the character type CharT
+ */
+template <typename CharT>
+using PatternMatchVectorFor = BasicPatternMatchVector<(sizeof(CharT) > 1)>;
+
+/**
+ * @brief bit masks of the character positions for strings of arbitrary length.
+ * Each block of 64 characters is stored in a separate word.
+ */
+class BlockPatternMatchVector {
+public:
+    BlockPatternMatchVector() : m_block_count(0)
+    {}
+
+    explicit BlockPatternMatchVector(size_t str_len)
+        : m_block_count(intrinsics::ceil_div(str_len, size_t(64))), m_extendedAscii(256 * m_block_count)
+    {}
+
+    template <typename InputIt>
+    BlockPatternMatchVector(InputIt first, InputIt last)
+        : BlockPatternMatchVector(static_cast<size_t>(std::distance(first, last)))
+    {
+        insert(first, last);
+    }
+
+    template <typename InputIt>
+    void insert(InputIt first, InputIt last)
+    {
+        size_t pos = 0;
+        for (; first != last; ++first, ++pos)
+            insert_mask(pos / 64, *first, UINT64_C(1) << (pos % 64));
+    }
+
+    template <typename CharT>
+    void insert_mask(size_t block, CharT ch, uint64_t mask)
+    {
+        uint64_t key = to_key(ch);
+        if (key < 256) {
+            m_extendedAscii[key * m_block_count + block] |= mask;
+        }
+        else {
+            /* the hashmaps are only allocated once a character >= 256 is inserted */
+            if (m_map.empty()) m_map.resize(m_block_count);
+            m_map[block][key] |= mask;
+        }
+    }
+
+    size_t size() const
+    {
+        return m_block_count;
+    }
+
+    template <typename CharT>
+    uint64_t get(size_t block, CharT ch) const
+    {
+        uint64_t key = to_key(ch);
+        if (key < 256) return m_extendedAscii[key * m_block_count + block];
+        if (m_map.empty()) return 0;
+        return m_map[block].get(key);
+    }
+
+private:
+    size_t m_block_count;
+    std::vector<BitvectorHashmap> m_map;
+    std::vector<uint64_t> m_extendedAscii;
+};
+
+} // namespace common
+} // namespace jaro_winkler
@@ -0,0 +1,83 @@
+/* SPDX-License-Identifier: MIT */
+/* Copyright © 2022-present Max Bachmann */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+
+#include <jarowinkler/details/common.hpp>
+#include <jarowinkler/details/jaro_impl.hpp>
+
+namespace jaro_winkler {
+namespace detail {
+
+/**
+ * @brief counts of the characters of a string, with every character mapped to one of 32 buckets.
+ * Characters sharing a bucket can only increase the bound calculated from two histograms, so
+ * the bound stays valid while the histogram fits into a single cache line.
+ */
+struct CharHistogram {
+    static const int64_t MAX_LEN = UINT16_MAX;
+
+    uint16_t counts[32];
+    /* strings longer than MAX_LEN could overflow the counts and are never filtered */
+    bool valid;
+
+    CharHistogram() : counts(), valid(false)
+    {}
+
+    template <typename InputIt>
+    CharHistogram(InputIt first, InputIt last) : counts(), valid(std::distance(first, last) <= MAX_LEN)
+    {
+        if (!valid) return;
+
+        for (; first != last; ++first) {
+            uint64_t key = common::to_key(*first);
+            ++counts[(key ^ (key >> 5) ^ (key >> 10)) % 32];
+        }
+    }
+};
+
+/**
+ * @brief upper bound of the amount of common characters of two strings. A character
+ * can only be matched as often as it occurs in both strings, independent of their position
+ */
+static inline int64_t common_chars_bound(const CharHistogram& a, const CharHistogram& b)
+{
+    int64_t CommonChars = 0;
+    for (int i = 0; i < 32; ++i)
+        CommonChars += std::min(a.counts[i], b.counts[i]);
+    return CommonChars;
+}
+
+/**
+ * @brief filter matches below the Jaro score_cutoff based on the character histograms
+ *
+ * @return false when the similarity is known to be below score_cutoff
+ */
+static inline bool jaro_histogram_filter(const CharHistogram& P_hist, int64_t P_len, const CharHistogram& T_hist,
+                                         int64_t T_len, double score_cutoff)
+{
+    if (score_cutoff <= 0.0 || !P_hist.valid || !T_hist.valid) return true;
+    /* two empty strings have a similarity of 1, while a single empty string is rejected below */
+    if (!P_len && !T_len) return true;
+
+    return jaro_common_char_filter(P_len, T_len, common_chars_bound(P_hist, T_hist), score_cutoff);
+}
+
+/**
+ * @brief counts a comparison rejected by the histogram filter, which never reaches jaro_similarity
+ */
+template <typename CharT1, typename InputIt2>
+static inline void stats_record_histogram_rejected(int64_t P_len, int64_t T_len)
+{
+    if (JaroStats* stats = thread_stats()) {
+        stats_record_call(*stats, P_len, T_len, uses_hashmap<const CharT1*, InputIt2>());
+        stats_add(stats->histogram_rejected);
+    }
+}
+
+} // namespace detail
+} // namespace jaro_winkler
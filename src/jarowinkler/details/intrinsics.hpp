@@ -0,0 +1,84 @@
+/* SPDX-License-Identifier: MIT */
+/* Copyright © 2022-present Max Bachmann */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#    include <intrin.h>
+#endif
+
+namespace jaro_winkler {
+namespace intrinsics {
+
+/**
+ * @brief mask with the lowest n bits set. Valid for 0 <= n <= 64
+ */
+static inline uint64_t bit_mask_lsb(int64_t n)
+{
+    return (n >= 64) ? ~UINT64_C(0) : (UINT64_C(1) << n) - 1;
+}
+
+/**
+ * @brief extract the lowest set bit
+ */
+static inline uint64_t blsi(uint64_t a)
+{
+    return a & (~a + 1);
+}
+
+/**
+ * @brief reset the lowest set bit
+ */
+static inline uint64_t blsr(uint64_t a)
+{
+    return a & (a - 1);
+}
+
+static inline int64_t popcount(uint64_t x)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    /* __popcnt64 requires hardware support, so use the portable bit trick */
+    x = x - ((x >> 1) & UINT64_C(0x5555555555555555));
+    x = (x & UINT64_C(0x3333333333333333)) + ((x >> 2) & UINT64_C(0x3333333333333333));
+    x = (x + (x >> 4)) & UINT64_C(0x0f0f0f0f0f0f0f0f);
+    return static_cast<int64_t>((x * UINT64_C(0x0101010101010101)) >> 56);
+#else
+    return static_cast<int64_t>(__builtin_popcountll(x));
+#endif
+}
+
+/**
+ * @brief index of the lowest set bit. x is not allowed to be 0
+ */
+static inline int countr_zero(uint64_t x)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long trailing_zero = 0;
+#    if defined(_WIN64)
+    _BitScanForward64(&trailing_zero, x);
+#    else
+    if (static_cast<uint32_t>(x)) {
+        _BitScanForward(&trailing_zero, static_cast<uint32_t>(x));
+    }
+    else {
+        _BitScanForward(&trailing_zero, static_cast<uint32_t>(x >> 32));
+        trailing_zero += 32;
+    }
+#    endif
+    return static_cast<int>(trailing_zero);
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+
+template <typename T>
+static inline T ceil_div(T a, T divisor)
+{
+    return a / divisor + static_cast<T>(a % divisor != 0);
+}
+
+} // namespace intrinsics
+} // namespace jaro_winkler
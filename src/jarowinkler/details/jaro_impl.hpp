@@ -0,0 +1,470 @@
+/* SPDX-License-Identifier: MIT */
+/* Copyright © 2022-present Max Bachmann */
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+#include <jarowinkler/details/common.hpp>
+#include <jarowinkler/details/intrinsics.hpp>
+#include <jarowinkler/details/stats.hpp>
+
+namespace jaro_winkler {
+namespace detail {
+
+struct FlaggedCharsWord {
+    uint64_t P_flag;
+    uint64_t T_flag;
+};
+
+struct FlaggedCharsMultiword {
+    std::vector<uint64_t> P_flag;
+    std::vector<uint64_t> T_flag;
+};
+
+static inline double jaro_calculate_similarity(int64_t P_len, int64_t T_len, int64_t CommonChars,
+                                               int64_t Transpositions)
+{
+    Transpositions /= 2;
+    double Sim = 0;
+    Sim += static_cast<double>(CommonChars) / static_cast<double>(P_len);
+    Sim += static_cast<double>(CommonChars) / static_cast<double>(T_len);
+    Sim += (static_cast<double>(CommonChars) - static_cast<double>(Transpositions)) /
+           static_cast<double>(CommonChars);
+    return Sim / 3.0;
+}
+
+/**
+ * @brief upper bound of the similarity based on the string lengths. This assumes
+ * every character of the shorter string matches without transpositions
+ */
+static inline double jaro_length_bound(int64_t P_len, int64_t T_len)
+{
+    if (!P_len || !T_len) return static_cast<double>(!P_len && !T_len);
+
+    double min_len = static_cast<double>(std::min(P_len, T_len));
+    double Sim = min_len / static_cast<double>(P_len) + min_len / static_cast<double>(T_len) + 1.0;
+    return Sim / 3.0;
+}
+
+/**
+ * @brief upper bound of the Jaro-Winkler similarity based on the string lengths.
+ * This assumes the Jaro bound is reached with the longest possible common prefix
+ */
+static inline double jarowinkler_length_bound(int64_t P_len, int64_t T_len, double prefix_weight)
+{
+    double Sim = jaro_length_bound(P_len, T_len);
+    int64_t max_prefix = std::min<int64_t>(std::min(P_len, T_len), 4);
+    if (Sim > 0.7) Sim += static_cast<double>(max_prefix) * prefix_weight * (1.0 - Sim);
+    return Sim;
+}
+
+/**
+ * @brief filter matches below score_cutoff based on the string lengths
+ */
+static inline bool jaro_length_filter(int64_t P_len, int64_t T_len, double score_cutoff)
+{
+    if (!T_len || !P_len) return false;
+
+    return jaro_length_bound(P_len, T_len) >= score_cutoff;
+}
+
+/**
+ * @brief filter matches below score_cutoff based on the amount of common characters
+ */
+static inline bool jaro_common_char_filter(int64_t P_len, int64_t T_len, int64_t CommonChars,
+                                           double score_cutoff)
+{
+    if (!CommonChars) return false;
+
+    double Sim = 0;
+    Sim += static_cast<double>(CommonChars) / static_cast<double>(P_len);
+    Sim += static_cast<double>(CommonChars) / static_cast<double>(T_len);
+    Sim += 1.0;
+    Sim /= 3.0;
+    return Sim >= score_cutoff;
+}
+
+/**
+ * @brief calculates the search range of the Jaro similarity and removes
+ * the parts of P/T which can never be inside the search range
+ */
+template <typename InputIt1, typename InputIt2>
+static inline int64_t jaro_bounds(InputIt1 P_first, InputIt1& P_last, InputIt2 T_first, InputIt2& T_last)
+{
+    int64_t P_len = std::distance(P_first, P_last);
+    int64_t T_len = std::distance(T_first, T_last);
+
+    int64_t Bound = std::max<int64_t>(std::max(P_len, T_len) / 2 - 1, 0);
+    if (T_len > P_len + Bound) T_last = T_first + P_len + Bound;
+    if (P_len > T_len + Bound) P_last = P_first + T_len + Bound;
+
+    return Bound;
+}
+
+/**
+ * @brief removes the common prefix of two strings. The common prefix is always
+ * matched without any transpositions
+ */
+template <typename InputIt1, typename InputIt2>
+static inline int64_t remove_common_prefix(InputIt1& P_first, InputIt1 P_last, InputIt2& T_first, InputIt2 T_last)
+{
+    int64_t prefix = 0;
+    while (P_first != P_last && T_first != T_last && common::mixed_sign_equal(*P_first, *T_first)) {
+        ++P_first;
+        ++T_first;
+        ++prefix;
+    }
+    return prefix;
+}
+
+template <typename PM_Vec, typename InputIt>
+static inline FlaggedCharsWord flag_similar_characters_word(const PM_Vec& PM, InputIt T_first, int64_t T_len,
+                                                            int64_t Bound)
+{
+    assert(T_len <= 64);
+
+    FlaggedCharsWord flagged = {0, 0};
+    uint64_t BoundMask = intrinsics::bit_mask_lsb(Bound + 1);
+
+    int64_t j = 0;
+    for (; j < std::min(Bound, T_len); ++j) {
+        uint64_t PM_j = PM.get(0, T_first[j]) & BoundMask & (~flagged.P_flag);
+
+        flagged.P_flag |= intrinsics::blsi(PM_j);
+        flagged.T_flag |= static_cast<uint64_t>(PM_j != 0) << j;
+
+        BoundMask = (BoundMask << 1) | 1;
+    }
+
+    for (; j < T_len; ++j) {
+        uint64_t PM_j = PM.get(0, T_first[j]) & BoundMask & (~flagged.P_flag);
+
+        flagged.P_flag |= intrinsics::blsi(PM_j);
+        flagged.T_flag |= static_cast<uint64_t>(PM_j != 0) << j;
+
+        BoundMask <<= 1;
+    }
+
+    return flagged;
+}
+
+template <typename PM_Vec, typename InputIt>
+static inline int64_t count_transpositions_word(const PM_Vec& PM, InputIt T_first, const FlaggedCharsWord& flagged)
+{
+    uint64_t P_flag = flagged.P_flag;
+    uint64_t T_flag = flagged.T_flag;
+
+    int64_t Transpositions = 0;
+    while (T_flag) {
+        uint64_t PatternFlagMask = intrinsics::blsi(P_flag);
+
+        Transpositions += !(PM.get(0, T_first[intrinsics::countr_zero(T_flag)]) & PatternFlagMask);
+
+        T_flag = intrinsics::blsr(T_flag);
+        P_flag ^= PatternFlagMask;
+    }
+
+    return Transpositions;
+}
+
+template <typename PM_Vec, typename InputIt>
+static inline FlaggedCharsMultiword flag_similar_characters_block(const PM_Vec& PM, int64_t P_len, InputIt T_first,
+                                                                  int64_t T_len, int64_t Bound)
+{
+    FlaggedCharsMultiword flagged;
+    flagged.P_flag.resize(static_cast<size_t>(intrinsics::ceil_div<int64_t>(P_len, 64)));
+    flagged.T_flag.resize(static_cast<size_t>(intrinsics::ceil_div<int64_t>(T_len, 64)));
+
+    for (int64_t j = 0; j < T_len; ++j) {
+        /* search range [low, high) inside P */
+        int64_t low = std::max<int64_t>(0, j - Bound);
+        int64_t high = std::min(P_len, j + Bound + 1);
+        if (low >= high) break;
+
+        int64_t first_word = low / 64;
+        int64_t last_word = (high - 1) / 64;
+        uint64_t first_mask = ~UINT64_C(0) << (low % 64);
+        uint64_t last_mask = intrinsics::bit_mask_lsb(high - last_word * 64);
+
+        for (int64_t word = first_word; word <= last_word; ++word) {
+            uint64_t PM_j = PM.get(static_cast<size_t>(word), T_first[j]) & (~flagged.P_flag[word]);
+            if (word == first_word) PM_j &= first_mask;
+            if (word == last_word) PM_j &= last_mask;
+
+            if (PM_j) {
+                flagged.P_flag[word] |= intrinsics::blsi(PM_j);
+                flagged.T_flag[j / 64] |= UINT64_C(1) << (j % 64);
+                break;
+            }
+        }
+    }
+
+    return flagged;
+}
+
+template <typename PM_Vec, typename InputIt>
+static inline int64_t count_transpositions_block(const PM_Vec& PM, InputIt T_first,
+                                                 const FlaggedCharsMultiword& flagged, int64_t FlaggedChars)
+{
+    size_t TextWord = 0;
+    size_t PatternWord = 0;
+    uint64_t T_flag = flagged.T_flag[TextWord];
+    uint64_t P_flag = flagged.P_flag[PatternWord];
+
+    int64_t Transpositions = 0;
+    while (FlaggedChars) {
+        while (!T_flag) {
+            TextWord++;
+            T_first += 64;
+            T_flag = flagged.T_flag[TextWord];
+        }
+
+        while (T_flag) {
+            while (!P_flag) {
+                PatternWord++;
+                P_flag = flagged.P_flag[PatternWord];
+            }
+
+            uint64_t PatternFlagMask = intrinsics::blsi(P_flag);
+
+            Transpositions += !(PM.get(PatternWord, T_first[intrinsics::countr_zero(T_flag)]) & PatternFlagMask);
+
+            T_flag = intrinsics::blsr(T_flag);
+            P_flag ^= PatternFlagMask;
+
+            FlaggedChars--;
+        }
+    }
+
+    return Transpositions;
+}
+
+static inline int64_t count_common_chars(const FlaggedCharsMultiword& flagged)
+{
+    int64_t CommonChars = 0;
+    for (uint64_t flag : flagged.P_flag)
+        CommonChars += intrinsics::popcount(flag);
+    return CommonChars;
+}
+
+/**
+ * @brief whether the elements are wider than 8 bit, so characters >= 256 are looked up in the
+ * hashmap of the pattern match vector
+ */
+template <typename InputIt1, typename InputIt2>
+static inline bool uses_hashmap()
+{
+    return sizeof(typename std::iterator_traits<InputIt1>::value_type) > 1 ||
+           sizeof(typename std::iterator_traits<InputIt2>::value_type) > 1;
+}
+
+/**
+ * @brief Jaro similarity of the (already trimmed) strings P and T using the
+ * precomputed pattern match vector of P
+ *
+ * @param P_len/T_len length of the original strings used to calculate the similarity
+ * @param CommonChars amount of characters already known to match (e.g. a removed common prefix)
+ * @param stats counters of the calling thread or nullptr
+ */
+template <typename PM_Vec, typename InputIt1, typename InputIt2>
+static inline double jaro_similarity_impl(const PM_Vec& PM, InputIt1 P_first, InputIt1 P_last, InputIt2 T_first,
+                                          InputIt2 T_last, int64_t P_len, int64_t T_len, int64_t Bound,
+                                          int64_t CommonChars, double score_cutoff, JaroStats* stats)
+{
+    int64_t P_view_len = std::distance(P_first, P_last);
+    int64_t T_view_len = std::distance(T_first, T_last);
+
+    if (!P_view_len || !T_view_len) {
+        stats_count(stats, &JaroStats::empty);
+        double Sim = CommonChars ? jaro_calculate_similarity(P_len, T_len, CommonChars, 0) : 0.0;
+        return (Sim >= score_cutoff) ? Sim : 0.0;
+    }
+
+    int64_t Transpositions = 0;
+
+    if (P_view_len <= 64 && T_view_len <= 64) {
+        stats_count(stats, &JaroStats::single_word);
+        FlaggedCharsWord flagged = flag_similar_characters_word(PM, T_first, T_view_len, Bound);
+        CommonChars += intrinsics::popcount(flagged.P_flag);
+
+        if (!jaro_common_char_filter(P_len, T_len, CommonChars, score_cutoff)) {
+            stats_count(stats, &JaroStats::early_exits);
+            return 0.0;
+        }
+
+        Transpositions = count_transpositions_word(PM, T_first, flagged);
+    }
+    else {
+        stats_count(stats, &JaroStats::multi_word);
+        FlaggedCharsMultiword flagged = flag_similar_characters_block(PM, P_view_len, T_first, T_view_len, Bound);
+        int64_t FlaggedChars = count_common_chars(flagged);
+        CommonChars += FlaggedChars;
+
+        if (!jaro_common_char_filter(P_len, T_len, CommonChars, score_cutoff)) {
+            stats_count(stats, &JaroStats::early_exits);
+            return 0.0;
+        }
+
+        Transpositions = count_transpositions_block(PM, T_first, flagged, FlaggedChars);
+    }
+
+    double Sim = jaro_calculate_similarity(P_len, T_len, CommonChars, Transpositions);
+    return (Sim >= score_cutoff) ? Sim : 0.0;
+}
+
+/**
+ * @brief Jaro similarity using a pattern match vector built for the whole string P.
+ * Used by the cached implementations
+ */
+template <typename PM_Vec, typename InputIt1, typename InputIt2>
+static inline double jaro_similarity(const PM_Vec& PM, InputIt1 P_first, InputIt1 P_last, InputIt2 T_first,
+                                     InputIt2 T_last, double score_cutoff)
+{
+    int64_t P_len = std::distance(P_first, P_last);
+    int64_t T_len = std::distance(T_first, T_last);
+
+    JaroStats* stats = thread_stats();
+    if (stats) stats_record_call(*stats, P_len, T_len, uses_hashmap<InputIt1, InputIt2>());
+
+    /* both strings empty */
+    if (!P_len && !T_len) {
+        stats_count(stats, &JaroStats::empty);
+        return (score_cutoff <= 1.0) ? 1.0 : 0.0;
+    }
+
+    /* filter out based on the length difference between the two strings */
+    if (!jaro_length_filter(P_len, T_len, score_cutoff)) {
+        stats_count(stats, (!P_len || !T_len) ? &JaroStats::empty : &JaroStats::length_rejected);
+        return 0.0;
+    }
+
+    if (P_len == 1 && T_len == 1) {
+        stats_count(stats, &JaroStats::single_word);
+        return static_cast<double>(common::mixed_sign_equal(P_first[0], T_first[0]));
+    }
+
+    int64_t Bound = jaro_bounds(P_first, P_last, T_first, T_last);
+    return jaro_similarity_impl(PM, P_first, P_last, T_first, T_last, P_len, T_len, Bound, 0, score_cutoff, stats);
+}
+
+template <typename InputIt1, typename InputIt2>
+static inline double jaro_similarity(InputIt1 P_first, InputIt1 P_last, InputIt2 T_first, InputIt2 T_last,
+                                     double score_cutoff)
+{
+    int64_t P_len = std::distance(P_first, P_last);
+    int64_t T_len = std::distance(T_first, T_last);
+
+    JaroStats* stats = thread_stats();
+    if (stats) stats_record_call(*stats, P_len, T_len, uses_hashmap<InputIt1, InputIt2>());
+
+    /* both strings empty */
+    if (!P_len && !T_len) {
+        stats_count(stats, &JaroStats::empty);
+        return (score_cutoff <= 1.0) ? 1.0 : 0.0;
+    }
+
+    /* filter out based on the length difference between the two strings */
+    if (!jaro_length_filter(P_len, T_len, score_cutoff)) {
+        stats_count(stats, (!P_len || !T_len) ? &JaroStats::empty : &JaroStats::length_rejected);
+        return 0.0;
+    }
+
+    if (P_len == 1 && T_len == 1) {
+        stats_count(stats, &JaroStats::single_word);
+        return static_cast<double>(common::mixed_sign_equal(P_first[0], T_first[0]));
+    }
+
+    int64_t Bound = jaro_bounds(P_first, P_last, T_first, T_last);
+
+    /* common prefix never includes Transpositions */
+    int64_t CommonChars = remove_common_prefix(P_first, P_last, T_first, T_last);
+
+    if (std::distance(P_first, P_last) <= 64 && std::distance(T_first, T_last) <= 64) {
+        common::PatternMatchVectorFor<typename std::iterator_traits<InputIt1>::value_type> PM(P_first, P_last);
+        return jaro_similarity_impl(PM, P_first, P_last, T_first, T_last, P_len, T_len, Bound, CommonChars,
+                                    score_cutoff, stats);
+    }
+    else {
+        common::BlockPatternMatchVector PM(P_first, P_last);
+        return jaro_similarity_impl(PM, P_first, P_last, T_first, T_last, P_len, T_len, Bound, CommonChars,
+                                    score_cutoff, stats);
+    }
+}
+
+/**
+ * @brief length of the common prefix considered by Jaro-Winkler (at most 4 characters)
+ */
+template <typename InputIt1, typename InputIt2>
+static inline int64_t winkler_prefix(InputIt1 P_first, InputIt1 P_last, InputIt2 T_first, InputIt2 T_last)
+{
+    int64_t min_len = std::min<int64_t>(std::distance(P_first, P_last), std::distance(T_first, T_last));
+    int64_t max_prefix = std::min<int64_t>(min_len, 4);
+
+    int64_t prefix = 0;
+    for (; prefix < max_prefix; ++prefix)
+        if (!common::mixed_sign_equal(T_first[prefix], P_first[prefix])) break;
+
+    return prefix;
+}
+
+/**
+ * @brief score_cutoff the Jaro similarity has to reach, so the Jaro-Winkler
+ * similarity can reach score_cutoff
+ */
+static inline double jaro_score_cutoff(int64_t prefix, double prefix_weight, double score_cutoff)
+{
+    double jaro_cutoff = score_cutoff;
+    if (jaro_cutoff > 0.7) {
+        double prefix_sim = static_cast<double>(prefix) * prefix_weight;
+
+        /* the result is checked against score_cutoff again after adding the prefix,
+         * so the derived cutoff is relaxed slightly to be robust against rounding */
+        if (prefix_sim >= 1.0)
+            jaro_cutoff = 0.7;
+        else
+            jaro_cutoff = std::max(0.7, (prefix_sim - jaro_cutoff) / (prefix_sim - 1.0) - 1e-12);
+    }
+    return jaro_cutoff;
+}
+
+static inline double winkler_adjust(double Sim, int64_t prefix, double prefix_weight, double score_cutoff)
+{
+    if (Sim > 0.7) Sim += static_cast<double>(prefix) * prefix_weight * (1.0 - Sim);
+
+    return (Sim >= score_cutoff) ? Sim : 0.0;
+}
+
+template <typename PM_Vec, typename InputIt1, typename InputIt2>
+static inline double jarowinkler_similarity(const PM_Vec& PM, InputIt1 P_first, InputIt1 P_last, InputIt2 T_first,
+                                            InputIt2 T_last, double prefix_weight, double score_cutoff)
+{
+    int64_t prefix = winkler_prefix(P_first, P_last, T_first, T_last);
+    double Sim = jaro_similarity(PM, P_first, P_last, T_first, T_last,
+                                 jaro_score_cutoff(prefix, prefix_weight, score_cutoff));
+    return winkler_adjust(Sim, prefix, prefix_weight, score_cutoff);
+}
+
+template <typename InputIt1, typename InputIt2>
+static inline double jarowinkler_similarity(InputIt1 P_first, InputIt1 P_last, InputIt2 T_first, InputIt2 T_last,
+                                            double prefix_weight, double score_cutoff)
+{
+    int64_t prefix = winkler_prefix(P_first, P_last, T_first, T_last);
+    double Sim =
+        jaro_similarity(P_first, P_last, T_first, T_last, jaro_score_cutoff(prefix, prefix_weight, score_cutoff));
+    return winkler_adjust(Sim, prefix, prefix_weight, score_cutoff);
+}
+
+static inline void validate_prefix_weight(double prefix_weight)
+{
+    if (prefix_weight < 0.0 || prefix_weight > 0.25)
+        throw std::invalid_argument("prefix_weight has to be between 0.0 and 0.25");
+}
+
+} // namespace detail
+} // namespace jaro_winkler
@@ -0,0 +1,453 @@
+/* SPDX-License-Identifier: MIT */
+/* Copyright © 2022-present Max Bachmann */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+#include <jarowinkler/details/common.hpp>
+#include <jarowinkler/details/intrinsics.hpp>
+#include <jarowinkler/details/jaro_impl.hpp>
+
+/*
+ * Multi pattern kernel of the Jaro similarity. Short strings only use a few bits of the
+ * 64 bit word processed by the bit-parallel algorithm. So instead multiple Latin-1 strings
+ * are packed into the lanes of a vector register (8 bit lanes for up to 8 characters and
+ * 16 bit lanes for up to 16 characters) and all of them are compared with the same text at once.
+ *
+ * The strings are stored transposed, so the vector at position i holds the i-th character of
+ * every string in the batch. The bit masks of a character of the text are then created by
+ * comparing it with these vectors, which avoids building a match table for every batch. The
+ * transposed strings only depend on the strings themselves and can be reused for multiple texts.
+ *
+ * The kernel is written using the vector extensions of GCC/Clang and compiled for SSE4.1,
+ * AVX2 and AVX-512BW. The instruction set is selected at runtime. On other compilers or
+ * architectures the scalar implementation is used.
+ */
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#    define JAROWINKLER_SIMD 1
+#else
+#    define JAROWINKLER_SIMD 0
+#endif
+
+namespace jaro_winkler {
+namespace detail {
+
+enum class SimdLevel {
+    None,
+    SSE41,
+    AVX2,
+    AVX512
+};
+
+static inline SimdLevel detect_simd_level()
+{
+#if JAROWINKLER_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw")) return SimdLevel::AVX512;
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse4.1")) return SimdLevel::SSE41;
+#endif
+    return SimdLevel::None;
+}
+
+/**
+ * @brief instruction set used by the multi pattern kernel on this CPU
+ */
+static inline SimdLevel simd_level()
+{
+    static const SimdLevel level = detect_simd_level();
+    return level;
+}
+
+static inline size_t simd_vector_bytes(SimdLevel level)
+{
+    switch (level) {
+    case SimdLevel::AVX512: return 64;
+    case SimdLevel::AVX2: return 32;
+    case SimdLevel::SSE41: return 16;
+    default: return 0;
+    }
+}
+
+struct JaroCounts {
+    int64_t CommonChars;
+    int64_t Transpositions;
+};
+
+/**
+ * @brief strings scored with the multi pattern kernel, grouped by the lane width they fit into.
+ * Every batch of a bucket is stored as one vector per character position followed by a vector
+ * masking the valid positions of each lane
+ */
+struct SimdBucket {
+    std::vector<size_t> indices;
+    std::vector<uint8_t> batches;
+};
+
+/* longest string fitting into the lanes of the buckets */
+static const int64_t SIMD_BUCKET_MAX_LEN[2] = {8, 16};
+
+/* strings prepared at once when scoring a single text, so the transposed strings stay in the cache */
+static const size_t SIMD_CHUNK_SIZE = 1024;
+
+/* characters of the text which can not occur in a Latin-1 string */
+static const uint16_t SIMD_NO_MATCH_KEY = 256;
+
+#if JAROWINKLER_SIMD
+
+template <typename LaneT, size_t VecBytes>
+__attribute__((always_inline)) static inline void jaro_simd_lanes(const uint16_t* T_keys, int64_t T_len,
+                                                                  const int64_t* P_len, const SimdBucket& bucket,
+                                                                  size_t first, size_t last, JaroCounts* counts)
+{
+    typedef LaneT VecT __attribute__((vector_size(VecBytes)));
+    const size_t lanes = VecBytes / sizeof(LaneT);
+    const int64_t lane_bits = sizeof(LaneT) * 8;
+    const size_t batch_bytes = (lane_bits + 1) * VecBytes;
+    const size_t count = bucket.indices.size();
+    /* batches only holding strings outside of [first, last) are skipped */
+    const size_t skipped = static_cast<size_t>(
+        std::lower_bound(bucket.indices.begin(), bucket.indices.end(), first) - bucket.indices.begin());
+    const size_t end = static_cast<size_t>(
+        std::lower_bound(bucket.indices.begin(), bucket.indices.end(), last) - bucket.indices.begin());
+
+    VecT PM[64];
+    for (size_t batch = skipped / lanes * lanes; batch < end; batch += lanes) {
+        size_t batch_size = std::min(lanes, count - batch);
+        const size_t* batch_indices = &bucket.indices[batch];
+        const uint8_t* block = &bucket.batches[batch / lanes * batch_bytes];
+
+        alignas(VecBytes) LaneT lane_bound[lanes] = {};
+        alignas(VecBytes) LaneT lane_bound_mask[lanes] = {};
+        int64_t T_last = 0;
+        for (size_t lane = 0; lane < batch_size; ++lane) {
+            int64_t len = P_len[batch_indices[lane]];
+            int64_t Bound = std::max<int64_t>(std::max(len, T_len) / 2 - 1, 0);
+            lane_bound[lane] = static_cast<LaneT>(Bound);
+            lane_bound_mask[lane] = static_cast<LaneT>(intrinsics::bit_mask_lsb(Bound + 1));
+            /* characters of the text behind len + Bound can not be inside the search range */
+            T_last = std::max(T_last, std::min(T_len, len + Bound));
+        }
+
+        VecT Bound;
+        VecT BoundMask;
+        VecT LenMask;
+        memcpy(&Bound, lane_bound, sizeof(VecT));
+        memcpy(&BoundMask, lane_bound_mask, sizeof(VecT));
+        memcpy(&LenMask, block + lane_bits * VecBytes, sizeof(VecT));
+
+        VecT P_flag = {};
+        VecT T_flag[64];
+        for (int64_t j = 0; j < T_last; ++j) {
+            VecT PM_j = {};
+            if (T_keys[j] != SIMD_NO_MATCH_KEY) {
+                VecT ch = VecT{} + static_cast<LaneT>(T_keys[j]);
+                for (int64_t i = 0; i < lane_bits; ++i) {
+                    VecT P_i;
+                    memcpy(&P_i, block + i * VecBytes, sizeof(VecT));
+                    PM_j |= (VecT)(P_i == ch) & static_cast<LaneT>(static_cast<LaneT>(1) << i);
+                }
+                PM_j &= LenMask;
+            }
+            PM[j] = PM_j;
+
+            PM_j &= BoundMask & ~P_flag;
+            P_flag |= PM_j & -PM_j;
+            T_flag[j] = (VecT)(PM_j != 0);
+
+            /* the search range grows until j reaches Bound and is moved afterwards */
+            BoundMask = (BoundMask + BoundMask) | ((VecT)(Bound > static_cast<LaneT>(j)) & 1);
+        }
+
+        VecT P_remaining = P_flag;
+        VecT Transpositions = {};
+        for (int64_t j = 0; j < T_last; ++j) {
+            VecT PatternFlagMask = P_remaining & -P_remaining;
+            /* subtracting the all ones mask increments the lanes with a transposition */
+            Transpositions -= (VecT)((PM[j] & PatternFlagMask) == 0) & T_flag[j];
+            P_remaining ^= PatternFlagMask & T_flag[j];
+        }
+
+        alignas(VecBytes) LaneT lane_flags[lanes];
+        alignas(VecBytes) LaneT lane_transpositions[lanes];
+        memcpy(lane_flags, &P_flag, sizeof(VecT));
+        memcpy(lane_transpositions, &Transpositions, sizeof(VecT));
+        for (size_t lane = 0; lane < batch_size; ++lane) {
+            JaroCounts& lane_counts = counts[batch_indices[lane]];
+            lane_counts.CommonChars = intrinsics::popcount(static_cast<uint64_t>(lane_flags[lane]));
+            lane_counts.Transpositions = static_cast<int64_t>(lane_transpositions[lane]);
+        }
+    }
+}
+
+template <size_t VecBytes>
+__attribute__((always_inline)) static inline void jaro_simd_buckets(const uint16_t* T_keys, int64_t T_len,
+                                                                    const int64_t* P_len,
+                                                                    const SimdBucket* buckets, size_t first,
+                                                                    size_t last, JaroCounts* counts)
+{
+    if (!buckets[0].indices.empty())
+        jaro_simd_lanes<uint8_t, VecBytes>(T_keys, T_len, P_len, buckets[0], first, last, counts);
+    if (!buckets[1].indices.empty())
+        jaro_simd_lanes<uint16_t, VecBytes>(T_keys, T_len, P_len, buckets[1], first, last, counts);
+}
+
+__attribute__((target("avx512bw"))) static inline void jaro_simd_avx512(const uint16_t* T_keys, int64_t T_len,
+                                                                       const int64_t* P_len,
+                                                                       const SimdBucket* buckets, size_t first,
+                                                                       size_t last, JaroCounts* counts)
+{
+    jaro_simd_buckets<64>(T_keys, T_len, P_len, buckets, first, last, counts);
+}
+
+__attribute__((target("avx2"))) static inline void jaro_simd_avx2(const uint16_t* T_keys, int64_t T_len,
+                                                                 const int64_t* P_len, const SimdBucket* buckets,
+                                                                 size_t first, size_t last, JaroCounts* counts)
+{
+    jaro_simd_buckets<32>(T_keys, T_len, P_len, buckets, first, last, counts);
+}
+
+__attribute__((target("sse4.1"))) static inline void jaro_simd_sse41(const uint16_t* T_keys, int64_t T_len,
+                                                                    const int64_t* P_len, const SimdBucket* buckets,
+                                                                    size_t first, size_t last, JaroCounts* counts)
+{
+    jaro_simd_buckets<16>(T_keys, T_len, P_len, buckets, first, last, counts);
+}
+
+#endif
+
+/**
+ * @brief Latin-1 strings prepared for the multi pattern kernel. Strings of up to 16 characters
+ * are stored in the lanes of vector registers, when the CPU supports it. The remaining strings
+ * are scored one at a time by the caller.
+ *
+ * The kernel uses the strings as patterns and the compared string as text, while the cached
+ * scorers use the compared string as pattern. This does not change the result, since the
+ * implementation is symmetric.
+ */
+class JaroSimdPatterns {
+public:
+    /**
+     * @param P pointers to the characters of every string. They are only accessed in the constructor
+     * @param P_len length of every string
+     * @param count number of strings
+     */
+    JaroSimdPatterns(const uint8_t* const* P, const int64_t* P_len, size_t count, SimdLevel level = simd_level())
+        : m_level(level), m_lengths(P_len, P_len + count)
+    {
+        size_t vec_bytes = simd_vector_bytes(level);
+        for (size_t i = 0; i < count; ++i) {
+            if (vec_bytes && P_len[i] > 0 && P_len[i] <= SIMD_BUCKET_MAX_LEN[0])
+                m_buckets[0].indices.push_back(i);
+            else if (vec_bytes && P_len[i] > 0 && P_len[i] <= SIMD_BUCKET_MAX_LEN[1])
+                m_buckets[1].indices.push_back(i);
+            else
+                m_scalar.push_back(i);
+        }
+
+#if JAROWINKLER_SIMD
+        if (vec_bytes) {
+            transpose_u8(P, vec_bytes);
+            transpose_u16(P, vec_bytes);
+        }
+#else
+        (void)P;
+#endif
+    }
+
+    size_t size() const
+    {
+        return m_lengths.size();
+    }
+
+    /**
+     * @brief Jaro similarity of T with every string. The strings not supported by the kernel
+     * are passed to scalar(i), which has to return the similarity of the i-th string
+     *
+     * @param score_cutoffs score_cutoff of every string
+     * @param scores array receiving the similarity of every string
+     * @param first, last only the strings in [first, last) are scored, the scores of the others
+     *   are left unchanged
+     */
+    template <typename InputIt1, typename ScalarFunc>
+    void similarity(InputIt1 T_first, InputIt1 T_last, const double* score_cutoffs, double* scores,
+                    ScalarFunc&& scalar, size_t first = 0, size_t last = SIZE_MAX) const
+    {
+        int64_t T_len = std::distance(T_first, T_last);
+        last = std::min(last, size());
+#if JAROWINKLER_SIMD
+        bool use_kernel = !m_buckets[0].indices.empty() || !m_buckets[1].indices.empty();
+        if (use_kernel && T_len > 0 && T_len <= 64) {
+            for (size_t i : m_scalar)
+                if (i >= first && i < last) scores[i] = scalar(i);
+
+            uint16_t T_keys[64];
+            for (int64_t j = 0; j < T_len; ++j) {
+                uint64_t key = common::to_key(T_first[j]);
+                T_keys[j] = static_cast<uint16_t>((key < 256) ? key : SIMD_NO_MATCH_KEY);
+            }
+
+            std::vector<JaroCounts> counts(size());
+            switch (m_level) {
+            case SimdLevel::AVX512:
+                jaro_simd_avx512(T_keys, T_len, m_lengths.data(), m_buckets, first, last, counts.data());
+                break;
+            case SimdLevel::AVX2:
+                jaro_simd_avx2(T_keys, T_len, m_lengths.data(), m_buckets, first, last, counts.data());
+                break;
+            default: jaro_simd_sse41(T_keys, T_len, m_lengths.data(), m_buckets, first, last, counts.data()); break;
+            }
+
+            JaroStats* stats = thread_stats();
+            for (const auto& bucket : m_buckets) {
+                for (size_t i : bucket.indices) {
+                    if (i < first || i >= last) continue;
+                    if (stats) {
+                        stats_record_call(*stats, m_lengths[i], T_len, false);
+                        stats_add(stats->simd);
+                    }
+                    int64_t CommonChars = counts[i].CommonChars;
+                    double Sim = CommonChars ? jaro_calculate_similarity(m_lengths[i], T_len, CommonChars,
+                                                                         counts[i].Transpositions)
+                                             : 0.0;
+                    scores[i] = (Sim >= score_cutoffs[i]) ? Sim : 0.0;
+                }
+            }
+            return;
+        }
+#else
+        (void)T_first;
+        (void)score_cutoffs;
+#endif
+
+        (void)T_len;
+        for (size_t i = first; i < last; ++i)
+            scores[i] = scalar(i);
+    }
+
+private:
+#if JAROWINKLER_SIMD
+    /**
+     * @brief packs the len (1 - 8) characters starting at p into a word, with the first character
+     * in the lowest byte. The kernel is only used on x86, so the byte order is little endian
+     */
+    static uint64_t load_word(const uint8_t* p, int64_t len)
+    {
+        if (len >= 4) {
+            uint32_t low;
+            uint32_t high;
+            memcpy(&low, p, sizeof(low));
+            memcpy(&high, p + len - 4, sizeof(high));
+            return low | (static_cast<uint64_t>(high) << (8 * (len - 4)));
+        }
+
+        return p[0] | (static_cast<uint64_t>(p[len / 2]) << (8 * (len / 2))) |
+               (static_cast<uint64_t>(p[len - 1]) << (8 * (len - 1)));
+    }
+
+    static void swap_bits(uint64_t& a, uint64_t& b, int shift, uint64_t mask)
+    {
+        uint64_t diff = ((a >> shift) ^ b) & mask;
+        b ^= diff;
+        a ^= diff << shift;
+    }
+
+    /**
+     * @brief transposes the 8x8 byte matrix stored in w, so byte i of w[j] becomes byte j of w[i]
+     */
+    static void transpose_8x8(uint64_t* w)
+    {
+        for (int i = 0; i < 8; i += 2)
+            swap_bits(w[i], w[i + 1], 8, UINT64_C(0x00FF00FF00FF00FF));
+        for (int i = 0; i < 8; i += (i % 4 == 1) ? 3 : 1)
+            swap_bits(w[i], w[i + 2], 16, UINT64_C(0x0000FFFF0000FFFF));
+        for (int i = 0; i < 4; ++i)
+            swap_bits(w[i], w[i + 4], 32, UINT64_C(0x00000000FFFFFFFF));
+    }
+
+    /**
+     * @brief zero extends the 4 bytes of x to 16 bit
+     */
+    static uint64_t widen_u8(uint64_t x)
+    {
+        x &= 0xFFFFFFFF;
+        x = (x | (x << 16)) & UINT64_C(0x0000FFFF0000FFFF);
+        return (x | (x << 8)) & UINT64_C(0x00FF00FF00FF00FF);
+    }
+
+    /* The strings are transposed 8 at a time in general purpose registers, which requires far less
+     * stores than writing every character into its lane separately. */
+
+    void transpose_u8(const uint8_t* const* P, size_t vec_bytes)
+    {
+        SimdBucket& bucket = m_buckets[0];
+        const size_t lanes = vec_bytes;
+        const size_t batch_bytes = 9 * vec_bytes;
+        const size_t count = bucket.indices.size();
+        bucket.batches.assign((count + lanes - 1) / lanes * batch_bytes, 0);
+
+        for (size_t n = 0; n < count; n += 8) {
+            uint64_t w[8] = {};
+            uint64_t len_mask = 0;
+            for (size_t i = 0; i < std::min<size_t>(8, count - n); ++i) {
+                size_t index = bucket.indices[n + i];
+                w[i] = load_word(P[index], m_lengths[index]);
+                len_mask |= intrinsics::bit_mask_lsb(m_lengths[index]) << (8 * i);
+            }
+            transpose_8x8(w);
+
+            uint8_t* block = &bucket.batches[n / lanes * batch_bytes + n % lanes];
+            for (size_t i = 0; i < 8; ++i)
+                memcpy(block + i * vec_bytes, &w[i], sizeof(uint64_t));
+            memcpy(block + 8 * vec_bytes, &len_mask, sizeof(uint64_t));
+        }
+    }
+
+    void transpose_u16(const uint8_t* const* P, size_t vec_bytes)
+    {
+        SimdBucket& bucket = m_buckets[1];
+        const size_t lanes = vec_bytes / 2;
+        const size_t batch_bytes = 17 * vec_bytes;
+        const size_t count = bucket.indices.size();
+        bucket.batches.assign((count + lanes - 1) / lanes * batch_bytes, 0);
+
+        for (size_t n = 0; n < count; n += 8) {
+            uint64_t low[8] = {};
+            uint64_t high[8] = {};
+            uint64_t len_mask[2] = {};
+            for (size_t i = 0; i < std::min<size_t>(8, count - n); ++i) {
+                size_t index = bucket.indices[n + i];
+                memcpy(&low[i], P[index], sizeof(uint64_t));
+                high[i] = load_word(P[index] + 8, m_lengths[index] - 8);
+                len_mask[i / 4] |= intrinsics::bit_mask_lsb(m_lengths[index]) << (16 * (i % 4));
+            }
+            transpose_8x8(low);
+            transpose_8x8(high);
+
+            uint8_t* block = &bucket.batches[n / lanes * batch_bytes + n % lanes * 2];
+            for (size_t i = 0; i < 16; ++i) {
+                uint64_t chars = (i < 8) ? low[i] : high[i - 8];
+                uint64_t lanes_low = widen_u8(chars);
+                uint64_t lanes_high = widen_u8(chars >> 32);
+                memcpy(block + i * vec_bytes, &lanes_low, sizeof(uint64_t));
+                memcpy(block + i * vec_bytes + 8, &lanes_high, sizeof(uint64_t));
+            }
+            memcpy(block + 16 * vec_bytes, len_mask, sizeof(len_mask));
+        }
+    }
+#endif
+
+    SimdLevel m_level;
+    std::vector<int64_t> m_lengths;
+    SimdBucket m_buckets[2];
+    std::vector<size_t> m_scalar;
+};
+
+} // namespace detail
+} // namespace jaro_winkler
@@ -0,0 +1,113 @@
+/* SPDX-License-Identifier: MIT */
+/* Copyright © 2022-present Max Bachmann */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace jaro_winkler {
+
+/**
+ * @brief counters of the paths taken by the similarity calculations of one thread. They are only
+ * collected while the thread has installed them with set_thread_stats.
+ *
+ * Every comparison is counted in calls and exactly one of empty, length_rejected,
+ * histogram_rejected, single_word, multi_word and simd. The counters are only written by the
+ * owning thread, but are atomic so other threads can read them at any time.
+ */
+struct JaroStats {
+    /* buckets of length_histogram: 0, 1, 2, 3-4, 5-8, ..., 513-1024, > 1024 */
+    static const size_t LENGTH_BUCKETS = 13;
+
+    std::atomic<int64_t> calls{0};
+    /* a string is empty, or nothing remains after removing the common prefix */
+    std::atomic<int64_t> empty{0};
+    /* the length difference alone does not allow reaching score_cutoff */
+    std::atomic<int64_t> length_rejected{0};
+    /* the characters in common do not allow reaching score_cutoff (histogram filter) */
+    std::atomic<int64_t> histogram_rejected{0};
+    /* both strings fit into a single 64 bit word */
+    std::atomic<int64_t> single_word{0};
+    /* blocks of 64 characters */
+    std::atomic<int64_t> multi_word{0};
+    /* SIMD kernel of similarity_many */
+    std::atomic<int64_t> simd{0};
+    /* elements wider than 8 bit, which are looked up in a hashmap. Counted in addition to the kernel */
+    std::atomic<int64_t> hashed{0};
+    /* the kernel stopped after flagging the common characters, since score_cutoff can not be reached */
+    std::atomic<int64_t> early_exits{0};
+    /* calls by the length of the longer string */
+    std::atomic<int64_t> length_histogram[LENGTH_BUCKETS] = {};
+};
+
+namespace detail {
+
+static inline JaroStats*& thread_stats_slot()
+{
+    static thread_local JaroStats* stats = nullptr;
+    return stats;
+}
+
+/**
+ * @brief counters of the calling thread or nullptr. Only a thread local load, so the
+ * calculations can check it on every call
+ */
+static inline JaroStats* thread_stats()
+{
+    return thread_stats_slot();
+}
+
+/* only the owning thread writes, so no read-modify-write instruction is required */
+static inline void stats_add(std::atomic<int64_t>& counter, int64_t value = 1)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+static inline size_t stats_length_bucket(int64_t len)
+{
+    if (len <= 2) return static_cast<size_t>(len);
+    if (len > 1024) return JaroStats::LENGTH_BUCKETS - 1;
+
+    /* 3-4 -> 3, 5-8 -> 4, ... */
+    size_t bucket = 3;
+    for (int64_t limit = 4; len > limit; limit *= 2)
+        ++bucket;
+    return bucket;
+}
+
+/**
+ * @brief increments counter, when the calling thread collects stats
+ */
+static inline void stats_count(JaroStats* stats, std::atomic<int64_t> JaroStats::*counter)
+{
+    if (stats) stats_add(stats->*counter);
+}
+
+/**
+ * @brief counts a comparison of strings with the lengths P_len and T_len
+ */
+static inline void stats_record_call(JaroStats& stats, int64_t P_len, int64_t T_len, bool hashed)
+{
+    stats_add(stats.calls);
+    stats_add(stats.length_histogram[stats_length_bucket(P_len > T_len ? P_len : T_len)]);
+    if (hashed) stats_add(stats.hashed);
+}
+
+} // namespace detail
+
+/**
+ * @brief installs the counters collecting the paths taken by the calculations of the
+ * calling thread. nullptr stops collecting them.
+ *
+ * @return the previously installed counters
+ */
+static inline JaroStats* set_thread_stats(JaroStats* stats)
+{
+    JaroStats* previous = detail::thread_stats_slot();
+    detail::thread_stats_slot() = stats;
+    return previous;
+}
+
+} // namespace jaro_winkler
@@ -0,0 +1,387 @@
+/* SPDX-License-Identifier: MIT */
+/* Copyright © 2022-present Max Bachmann */
+
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+#include <jarowinkler/details/common.hpp>
+#include <jarowinkler/details/histogram.hpp>
+#include <jarowinkler/details/jaro_impl.hpp>
+#include <jarowinkler/details/jaro_simd.hpp>
+#include <jarowinkler/details/stats.hpp>
+
+namespace jaro_winkler {
+
+/**
+ * @defgroup jaro_winkler jaro_winkler
+ * Bit-parallel implementation of the Jaro and Jaro-Winkler similarity
+ * @{
+ */
+
+/**
+ * @brief Calculates the jaro similarity between two sequences
+ *
+ * @tparam InputIt1 random access iterator
+ * @tparam InputIt2 random access iterator
+ *
+ * @param first1 iterator to the first element of the first sequence
+ * @param last1 iterator past the last element of the first sequence
+ * @param first2 iterator to the first element of the second sequence
+ * @param last2 iterator past the last element of the second sequence
+ * @param score_cutoff Optional argument for a score threshold between 0 and 1.0.
+ *   For similarity < score_cutoff 0 is returned instead. Default is 0,
+ *   which deactivates this behaviour.
+ *
+ * @return jaro similarity between the two sequences as a double between 0 and 1.0
+ */
+template <typename InputIt1, typename InputIt2>
+double jaro_similarity(InputIt1 first1, InputIt1 last1, InputIt2 first2, InputIt2 last2,
+                       double score_cutoff = 0.0)
+{
+    return detail::jaro_similarity(first1, last1, first2, last2, score_cutoff);
+}
+
+/**
+ * @brief Calculates the jaro winkler similarity between two sequences
+ *
+ * @tparam InputIt1 random access iterator
+ * @tparam InputIt2 random access iterator
+ *
+ * @param first1 iterator to the first element of the first sequence
+ * @param last1 iterator past the last element of the first sequence
+ * @param first2 iterator to the first element of the second sequence
+ * @param last2 iterator past the last element of the second sequence
+ * @param prefix_weight Weight used for the common prefix of the two strings.
+ *   Has to be between 0 and 0.25. Default is 0.1.
+ * @param score_cutoff Optional argument for a score threshold between 0 and 1.0.
+ *   For similarity < score_cutoff 0 is returned instead. Default is 0,
+ *   which deactivates this behaviour.
+ *
+ * @return jaro winkler similarity between the two sequences as a double between 0 and 1.0
+ *
+ * @throws std::invalid_argument if prefix_weight is not between 0 and 0.25
+ */
+template <typename InputIt1, typename InputIt2>
+double jarowinkler_similarity(InputIt1 first1, InputIt1 last1, InputIt2 first2, InputIt2 last2,
+                              double prefix_weight = 0.1, double score_cutoff = 0.0)
+{
+    detail::validate_prefix_weight(prefix_weight);
+    return detail::jarowinkler_similarity(first1, last1, first2, last2, prefix_weight, score_cutoff);
+}
+
+/**
+ * @brief counters of the histogram filter used by filtered_similarity
+ */
+struct FilterStats {
+    /* strings checked by the filter */
+    int64_t candidates = 0;
+    /* strings rejected without calculating the similarity */
+    int64_t rejected = 0;
+};
+
+/**
+ * @brief Jaro similarity with a fixed first sequence. The bit masks of the
+ * first sequence are only calculated once and reused for every comparison.
+ */
+template <typename CharT1>
+struct CachedJaroSimilarity {
+    template <typename InputIt1>
+    CachedJaroSimilarity(InputIt1 first1, InputIt1 last1) : s1(first1, last1), P_hist(first1, last1)
+    {
+        if (s1.size() <= 64)
+            PM_word.insert(s1.begin(), s1.end());
+        else
+            PM_block = common::BlockPatternMatchVector(s1.begin(), s1.end());
+    }
+
+    template <typename InputIt2>
+    double similarity(InputIt2 first2, InputIt2 last2, double score_cutoff = 0.0) const
+    {
+        if (s1.size() <= 64)
+            return detail::jaro_similarity(PM_word, s1.begin(), s1.end(), first2, last2, score_cutoff);
+        return detail::jaro_similarity(PM_block, s1.begin(), s1.end(), first2, last2, score_cutoff);
+    }
+
+    /**
+     * @brief checks whether the second sequence can reach score_cutoff based on the characters
+     * both sequences have in common. This is a lot cheaper than calculating the similarity
+     *
+     * @param hist2 histogram of the second sequence
+     * @return false when the similarity is known to be below score_cutoff
+     */
+    template <typename InputIt2>
+    bool histogram_filter(const detail::CharHistogram& hist2, InputIt2 first2, InputIt2 last2,
+                          double score_cutoff) const
+    {
+        return detail::jaro_histogram_filter(P_hist, static_cast<int64_t>(s1.size()), hist2,
+                                             std::distance(first2, last2), score_cutoff);
+    }
+
+    /**
+     * @brief similarity, which skips the calculation when the histogram filter rejects the
+     * second sequence. Only used with a score_cutoff. Pairs, which can not reach score_cutoff
+     * because of their lengths, are left to similarity, which rejects them without a histogram
+     *
+     * @param stats optional counters of the filter
+     */
+    template <typename InputIt2>
+    double filtered_similarity(InputIt2 first2, InputIt2 last2, double score_cutoff,
+                               FilterStats* stats = nullptr) const
+    {
+        if (score_cutoff > 0.0 &&
+            detail::jaro_length_filter(static_cast<int64_t>(s1.size()), std::distance(first2, last2), score_cutoff))
+            return filtered_similarity(detail::CharHistogram(first2, last2), first2, last2, score_cutoff, stats);
+        return similarity(first2, last2, score_cutoff);
+    }
+
+    /**
+     * @brief filtered_similarity with the histogram of the second sequence, e.g. when it is stored
+     * in an index
+     */
+    template <typename InputIt2>
+    double filtered_similarity(const detail::CharHistogram& hist2, InputIt2 first2, InputIt2 last2,
+                               double score_cutoff, FilterStats* stats = nullptr) const
+    {
+        int64_t P_len = static_cast<int64_t>(s1.size());
+        int64_t T_len = std::distance(first2, last2);
+        if (score_cutoff > 0.0 && detail::jaro_length_filter(P_len, T_len, score_cutoff)) {
+            if (stats) ++stats->candidates;
+            if (!detail::jaro_histogram_filter(P_hist, P_len, hist2, T_len, score_cutoff)) {
+                if (stats) ++stats->rejected;
+                detail::stats_record_histogram_rejected<CharT1, InputIt2>(P_len, T_len);
+                return 0.0;
+            }
+        }
+        return similarity(first2, last2, score_cutoff);
+    }
+
+    /**
+     * @brief similarity with multiple Latin-1 strings. Short strings are scored
+     * several at a time using SIMD when it is supported by the CPU
+     *
+     * @param strings pointers to the characters of every string
+     * @param lengths length of every string
+     * @param count number of strings
+     * @param scores array receiving the similarity of every string
+     * @param stats optional counters of the histogram filter, which is used for the strings
+     *   not scored by the SIMD kernel
+     */
+    void similarity_many(const uint8_t* const* strings, const int64_t* lengths, size_t count, double* scores,
+                         double score_cutoff = 0.0, FilterStats* stats = nullptr) const
+    {
+        for (size_t first = 0; first < count; first += detail::SIMD_CHUNK_SIZE) {
+            size_t chunk = std::min(detail::SIMD_CHUNK_SIZE, count - first);
+            similarity_many(detail::JaroSimdPatterns(strings + first, lengths + first, chunk), strings + first,
+                            lengths + first, scores + first, score_cutoff, stats);
+        }
+    }
+
+    /**
+     * @brief similarity_many using strings which are already prepared for the SIMD kernel,
+     * so they can be shared between multiple scorers
+     *
+     * @param first, last only the strings in [first, last) are scored, the scores of the others
+     *   are left unchanged
+     */
+    void similarity_many(const detail::JaroSimdPatterns& patterns, const uint8_t* const* strings,
+                         const int64_t* lengths, double* scores, double score_cutoff = 0.0,
+                         FilterStats* stats = nullptr, size_t first = 0, size_t last = SIZE_MAX) const
+    {
+        std::vector<double> score_cutoffs(patterns.size(), score_cutoff);
+        auto scalar = [&](size_t i) {
+            return filtered_similarity(strings[i], strings[i] + lengths[i], score_cutoff, stats);
+        };
+        patterns.similarity(s1.begin(), s1.end(), score_cutoffs.data(), scores, scalar, first, last);
+    }
+
+private:
+    std::vector<CharT1> s1;
+    detail::CharHistogram P_hist;
+    /* only one of them is filled: patterns fitting into a single word use the flat table */
+    common::PatternMatchVectorFor<CharT1> PM_word;
+    common::BlockPatternMatchVector PM_block;
+};
+
+/**
+ * @brief Jaro-Winkler similarity with a fixed first sequence. The bit masks
+ * of the first sequence are only calculated once and reused for every comparison.
+ *
+ * @throws std::invalid_argument if prefix_weight is not between 0 and 0.25
+ */
+template <typename CharT1>
+struct CachedJaroWinklerSimilarity {
+    template <typename InputIt1>
+    CachedJaroWinklerSimilarity(InputIt1 first1, InputIt1 last1, double prefix_weight_ = 0.1)
+        : prefix_weight(prefix_weight_), s1(first1, last1), P_hist(first1, last1)
+    {
+        detail::validate_prefix_weight(prefix_weight);
+        if (s1.size() <= 64)
+            PM_word.insert(s1.begin(), s1.end());
+        else
+            PM_block = common::BlockPatternMatchVector(s1.begin(), s1.end());
+    }
+
+    template <typename InputIt2>
+    double similarity(InputIt2 first2, InputIt2 last2, double score_cutoff = 0.0) const
+    {
+        if (s1.size() <= 64)
+            return detail::jarowinkler_similarity(PM_word, s1.begin(), s1.end(), first2, last2, prefix_weight,
+                                                  score_cutoff);
+        return detail::jarowinkler_similarity(PM_block, s1.begin(), s1.end(), first2, last2, prefix_weight,
+                                              score_cutoff);
+    }
+
+    /**
+     * @brief checks whether the second sequence can reach score_cutoff based on the characters
+     * both sequences have in common. This is a lot cheaper than calculating the similarity
+     *
+     * @param hist2 histogram of the second sequence
+     * @return false when the similarity is known to be below score_cutoff
+     */
+    template <typename InputIt2>
+    bool histogram_filter(const detail::CharHistogram& hist2, InputIt2 first2, InputIt2 last2,
+                          double score_cutoff) const
+    {
+        if (score_cutoff <= 0.0) return true;
+
+        return detail::jaro_histogram_filter(P_hist, static_cast<int64_t>(s1.size()), hist2,
+                                             std::distance(first2, last2),
+                                             jaro_score_cutoff(first2, last2, score_cutoff));
+    }
+
+    /**
+     * @brief similarity, which skips the calculation when the histogram filter rejects the
+     * second sequence. Only used with a score_cutoff. Pairs, which can not reach score_cutoff
+     * because of their lengths, are left to similarity, which rejects them without a histogram
+     *
+     * @param stats optional counters of the filter
+     */
+    template <typename InputIt2>
+    double filtered_similarity(InputIt2 first2, InputIt2 last2, double score_cutoff,
+                               FilterStats* stats = nullptr) const
+    {
+        if (score_cutoff > 0.0 && detail::jaro_length_filter(static_cast<int64_t>(s1.size()),
+                                                             std::distance(first2, last2),
+                                                             jaro_score_cutoff(first2, last2, score_cutoff)))
+            return filtered_similarity(detail::CharHistogram(first2, last2), first2, last2, score_cutoff, stats);
+        return similarity(first2, last2, score_cutoff);
+    }
+
+    /**
+     * @brief filtered_similarity with the histogram of the second sequence, e.g. when it is stored
+     * in an index
+     */
+    template <typename InputIt2>
+    double filtered_similarity(const detail::CharHistogram& hist2, InputIt2 first2, InputIt2 last2,
+                               double score_cutoff, FilterStats* stats = nullptr) const
+    {
+        int64_t P_len = static_cast<int64_t>(s1.size());
+        int64_t T_len = std::distance(first2, last2);
+        if (score_cutoff > 0.0) {
+            double jaro_cutoff = jaro_score_cutoff(first2, last2, score_cutoff);
+            if (detail::jaro_length_filter(P_len, T_len, jaro_cutoff)) {
+                if (stats) ++stats->candidates;
+                if (!detail::jaro_histogram_filter(P_hist, P_len, hist2, T_len, jaro_cutoff)) {
+                    if (stats) ++stats->rejected;
+                    detail::stats_record_histogram_rejected<CharT1, InputIt2>(P_len, T_len);
+                    return 0.0;
+                }
+            }
+        }
+        return similarity(first2, last2, score_cutoff);
+    }
+
+    /**
+     * @brief similarity with multiple Latin-1 strings. Short strings are scored
+     * several at a time using SIMD when it is supported by the CPU
+     *
+     * @param strings pointers to the characters of every string
+     * @param lengths length of every string
+     * @param count number of strings
+     * @param scores array receiving the similarity of every string
+     * @param stats optional counters of the histogram filter, which is used for the strings
+     *   not scored by the SIMD kernel
+     */
+    void similarity_many(const uint8_t* const* strings, const int64_t* lengths, size_t count, double* scores,
+                         double score_cutoff = 0.0, FilterStats* stats = nullptr) const
+    {
+        for (size_t first = 0; first < count; first += detail::SIMD_CHUNK_SIZE) {
+            size_t chunk = std::min(detail::SIMD_CHUNK_SIZE, count - first);
+            similarity_many(detail::JaroSimdPatterns(strings + first, lengths + first, chunk), strings + first,
+                            lengths + first, scores + first, score_cutoff, stats);
+        }
+    }
+
+    /**
+     * @brief similarity_many using strings which are already prepared for the SIMD kernel,
+     * so they can be shared between multiple scorers
+     *
+     * @param first, last only the strings in [first, last) are scored, the scores of the others
+     *   are left unchanged
+     */
+    void similarity_many(const detail::JaroSimdPatterns& patterns, const uint8_t* const* strings,
+                         const int64_t* lengths, double* scores, double score_cutoff = 0.0,
+                         FilterStats* stats = nullptr, size_t first = 0, size_t last = SIZE_MAX) const
+    {
+        size_t count = patterns.size();
+        last = std::min(last, count);
+        std::vector<int64_t> prefixes(count);
+        std::vector<double> jaro_cutoffs(count);
+        for (size_t i = first; i < last; ++i) {
+            prefixes[i] = detail::winkler_prefix(s1.begin(), s1.end(), strings[i], strings[i] + lengths[i]);
+            jaro_cutoffs[i] = detail::jaro_score_cutoff(prefixes[i], prefix_weight, score_cutoff);
+        }
+
+        auto scalar = [&](size_t i) {
+            /* pairs rejected by their lengths are counted as such by jaro_similarity */
+            if (score_cutoff > 0.0 &&
+                detail::jaro_length_filter(static_cast<int64_t>(s1.size()), lengths[i], jaro_cutoffs[i])) {
+                if (stats) ++stats->candidates;
+                detail::CharHistogram hist2(strings[i], strings[i] + lengths[i]);
+                if (!detail::jaro_histogram_filter(P_hist, static_cast<int64_t>(s1.size()), hist2, lengths[i],
+                                                   jaro_cutoffs[i])) {
+                    if (stats) ++stats->rejected;
+                    detail::stats_record_histogram_rejected<CharT1, const uint8_t*>(
+                        static_cast<int64_t>(s1.size()), lengths[i]);
+                    return 0.0;
+                }
+            }
+            return jaro_similarity(strings[i], strings[i] + lengths[i], jaro_cutoffs[i]);
+        };
+        patterns.similarity(s1.begin(), s1.end(), jaro_cutoffs.data(), scores, scalar, first, last);
+
+        for (size_t i = first; i < last; ++i)
+            scores[i] = detail::winkler_adjust(scores[i], prefixes[i], prefix_weight, score_cutoff);
+    }
+
+private:
+    /* score_cutoff the Jaro similarity has to reach, after taking the common prefix into account */
+    template <typename InputIt2>
+    double jaro_score_cutoff(InputIt2 first2, InputIt2 last2, double score_cutoff) const
+    {
+        int64_t prefix = detail::winkler_prefix(s1.begin(), s1.end(), first2, last2);
+        return detail::jaro_score_cutoff(prefix, prefix_weight, score_cutoff);
+    }
+
+    template <typename InputIt2>
+    double jaro_similarity(InputIt2 first2, InputIt2 last2, double score_cutoff) const
+    {
+        if (s1.size() <= 64)
+            return detail::jaro_similarity(PM_word, s1.begin(), s1.end(), first2, last2, score_cutoff);
+        return detail::jaro_similarity(PM_block, s1.begin(), s1.end(), first2, last2, score_cutoff);
+    }
+
+    double prefix_weight;
+    std::vector<CharT1> s1;
+    detail::CharHistogram P_hist;
+    /* only one of them is filled: patterns fitting into a single word use the flat table */
+    common::PatternMatchVectorFor<CharT1> PM_word;
+    common::BlockPatternMatchVector PM_block;
+};
+
+/**@}*/
+
+} // namespace jaro_winkler
@@ -0,0 +1,1518 @@
+/* SPDX-License-Identifier: MIT */
+/* Copyright © 2022-present Max Bachmann */
+
+#include "corpus.hpp"
+#include "corpus_file.hpp"
+#include "cpp_common.hpp"
+#include "extract.hpp"
+#include "filter_stats.hpp"
+#include "index.hpp"
+#include "matcher.hpp"
+#include "parallel.hpp"
+#include "processor.hpp"
+#include "runtime_stats.hpp"
+#include "score_buffer.hpp"
+#include "scorer_function.hpp"
+#include "string_array.hpp"
+#include "thread_pool.hpp"
+#include "vocabulary.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+#include <jarowinkler/jarowinkler.hpp>
+
+/* RapidFuzz C-API */
+
+static void KwargsDeinit(RF_Kwargs* self)
+{
+    delete static_cast<double*>(self->context);
+}
+
+static bool NoKwargsInit(RF_Kwargs* self, PyObject* /*kwargs*/)
+{
+    self->context = nullptr;
+    self->dtor = nullptr;
+    return true;
+}
+
+static bool JaroWinklerKwargsInit(RF_Kwargs* self, PyObject* kwargs)
+{
+    try {
+        double prefix_weight = 0.1;
+        PyObject* py_prefix_weight = kwargs ? PyDict_GetItemString(kwargs, "prefix_weight") : nullptr;
+        if (py_prefix_weight) {
+            prefix_weight = PyFloat_AsDouble(py_prefix_weight);
+            if (prefix_weight == -1.0 && PyErr_Occurred()) throw PythonError();
+        }
+
+        jaro_winkler::detail::validate_prefix_weight(prefix_weight);
+        self->context = new double(prefix_weight);
+        self->dtor = KwargsDeinit;
+    }
+    catch (...) {
+        CppExn2PyErr();
+        return false;
+    }
+    return true;
+}
+
+static bool GetScorerFlagsSimilarity(const RF_Kwargs* /*kwargs*/, RF_ScorerFlags* scorer_flags)
+{
+    scorer_flags->flags = RF_SCORER_FLAG_RESULT_F64 | RF_SCORER_FLAG_SYMMETRIC;
+    scorer_flags->optimal_score.f64 = 1.0;
+    scorer_flags->worst_score.f64 = 0.0;
+    return true;
+}
+
+/**
+ * @brief sets the Python exception for the currently handled C++ exception.
+ * RapidFuzz calls the scorers without holding the GIL, so it is acquired first
+ */
+static void CppExn2PyErrNoGIL()
+{
+    PyGILState_STATE gilstate_save = PyGILState_Ensure();
+    CppExn2PyErr();
+    PyGILState_Release(gilstate_save);
+}
+
+template <typename CachedScorer>
+static void scorer_deinit(RF_ScorerFunc* self)
+{
+    delete static_cast<CachedScorer*>(self->context);
+}
+
+template <typename CachedScorer>
+static bool similarity_func_wrapper(const RF_ScorerFunc* self, const RF_String* str, int64_t str_count,
+                                    double score_cutoff, double /*score_hint*/, double* result)
+{
+    try {
+        if (str_count != 1) throw std::logic_error("Only str_count == 1 supported");
+
+        StatsScope stats_scope;
+        const CachedScorer& scorer = *static_cast<const CachedScorer*>(self->context);
+        *result = visit(*str, [&](auto first, auto last) {
+            return scorer.similarity(first, last, score_cutoff);
+        });
+    }
+    catch (...) {
+        CppExn2PyErrNoGIL();
+        return false;
+    }
+    return true;
+}
+
+template <template <typename> class CachedScorer, typename... Args>
+static bool scorer_func_init(RF_ScorerFunc* self, int64_t str_count, const RF_String* str, Args... args)
+{
+    try {
+        if (str_count != 1) throw std::logic_error("Only str_count == 1 supported");
+
+        visit(*str, [&](auto first, auto last) {
+            using CharT = typename std::iterator_traits<decltype(first)>::value_type;
+            using Scorer = CachedScorer<CharT>;
+
+            self->context = new Scorer(first, last, args...);
+            self->call.f64 = similarity_func_wrapper<Scorer>;
+            self->dtor = scorer_deinit<Scorer>;
+        });
+    }
+    catch (...) {
+        CppExn2PyErrNoGIL();
+        return false;
+    }
+    return true;
+}
+
+static bool JaroScorerInit(RF_ScorerFunc* self, const RF_Kwargs* /*kwargs*/, int64_t str_count,
+                           const RF_String* str)
+{
+    return scorer_func_init<jaro_winkler::CachedJaroSimilarity>(self, str_count, str);
+}
+
+static bool JaroWinklerScorerInit(RF_ScorerFunc* self, const RF_Kwargs* kwargs, int64_t str_count,
+                                  const RF_String* str)
+{
+    double prefix_weight = *static_cast<const double*>(kwargs->context);
+    return scorer_func_init<jaro_winkler::CachedJaroWinklerSimilarity>(self, str_count, str, prefix_weight);
+}
+
+static RF_Scorer JaroScorer = {SCORER_STRUCT_VERSION, NoKwargsInit, GetScorerFlagsSimilarity, JaroScorerInit};
+
+static RF_Scorer JaroWinklerScorer = {SCORER_STRUCT_VERSION, JaroWinklerKwargsInit, GetScorerFlagsSimilarity,
+                                      JaroWinklerScorerInit};
+
+/* Python API */
+
+static double conv_prefix_weight(PyObject* py_prefix_weight)
+{
+    double prefix_weight = PyFloat_AsDouble(py_prefix_weight);
+    if (prefix_weight == -1.0 && PyErr_Occurred()) throw PythonError();
+
+    jaro_winkler::detail::validate_prefix_weight(prefix_weight);
+    return prefix_weight;
+}
+
+PyDoc_STRVAR(jaro_similarity_doc, R"(Calculates the jaro similarity
+
+Parameters
+----------
+s1 : Sequence[Hashable]
+    First string to compare.
+s2 : Sequence[Hashable]
+    Second string to compare.
+processor: callable, optional
+    Optional callable that is used to preprocess the strings before
+    comparing them. Default is None, which deactivates this behaviour.
+score_cutoff : float, optional
+    Optional argument for a score threshold as a float between 0 and 1.0.
+    For ratio < score_cutoff 0 is returned instead. Default is 0,
+    which deactivates this behaviour.
+
+Returns
+-------
+similarity : float
+    similarity between s1 and s2 as a float between 0 and 1.0
+)");
+
+static PyObject* jaro_similarity(PyObject* const* args, Py_ssize_t nargs, PyObject* kwnames)
+{
+    static const char* const names[] = {"s1", "s2", "processor", "score_cutoff"};
+    static const ArgParser parser = {"jaro_similarity", names, 4, 2, 2};
+    PyObject* argv[4];
+    if (parse_args(parser, args, nargs, kwnames, argv) < 0) return nullptr;
+
+    PyObject* s1 = argv[0];
+    PyObject* s2 = argv[1];
+    PyObject* processor = argv[2] ? argv[2] : Py_None;
+    PyObject* py_score_cutoff = argv[3] ? argv[3] : Py_None;
+
+    try {
+        double score_cutoff = conv_score_cutoff(py_score_cutoff);
+        if (s1 == Py_None || s2 == Py_None) return PyFloat_FromDouble(0.0);
+
+        RF_StringWrapper str1 = conv_processed(processor, s1);
+        RF_StringWrapper str2 = conv_processed(processor, s2);
+
+        double sim = visitor(str1.string, str2.string, [&](auto first1, auto last1, auto first2, auto last2) {
+            return jaro_winkler::jaro_similarity(first1, last1, first2, last2, score_cutoff);
+        });
+        return PyFloat_FromDouble(sim);
+    }
+    catch (...) {
+        CppExn2PyErr();
+        return nullptr;
+    }
+}
+
+PyDoc_STRVAR(jarowinkler_similarity_doc, R"(Calculates the jaro winkler similarity
+
+Parameters
+----------
+s1 : Sequence[Hashable]
+    First string to compare.
+s2 : Sequence[Hashable]
+    Second string to compare.
+prefix_weight : float, optional
+    Weight used for the common prefix of the two strings.
+    Has to be between 0 and 0.25. Default is 0.1.
+processor: callable, optional
+    Optional callable that is used to preprocess the strings before
+    comparing them. Default is None, which deactivates this behaviour.
+score_cutoff : float, optional
+    Optional argument for a score threshold as a float between 0 and 1.0.
+    For ratio < score_cutoff 0 is returned instead. Default is 0,
+    which deactivates this behaviour.
+
+Returns
+-------
+similarity : float
+    similarity between s1 and s2 as a float between 0 and 1.0
+
+Raises
+------
+ValueError
+    If prefix_weight is invalid
+)");
+
+static PyObject* jarowinkler_similarity(PyObject* const* args, Py_ssize_t nargs, PyObject* kwnames)
+{
+    static const char* const names[] = {"s1", "s2", "prefix_weight", "processor", "score_cutoff"};
+    static const ArgParser parser = {"jarowinkler_similarity", names, 5, 2, 2};
+    PyObject* argv[5];
+    if (parse_args(parser, args, nargs, kwnames, argv) < 0) return nullptr;
+
+    PyObject* s1 = argv[0];
+    PyObject* s2 = argv[1];
+    PyObject* py_prefix_weight = argv[2];
+    PyObject* processor = argv[3] ? argv[3] : Py_None;
+    PyObject* py_score_cutoff = argv[4] ? argv[4] : Py_None;
+
+    try {
+        double prefix_weight = py_prefix_weight ? conv_prefix_weight(py_prefix_weight) : 0.1;
+        double score_cutoff = conv_score_cutoff(py_score_cutoff);
+        if (s1 == Py_None || s2 == Py_None) return PyFloat_FromDouble(0.0);
+
+        RF_StringWrapper str1 = conv_processed(processor, s1);
+        RF_StringWrapper str2 = conv_processed(processor, s2);
+
+        double sim = visitor(str1.string, str2.string, [&](auto first1, auto last1, auto first2, auto last2) {
+            return jaro_winkler::jarowinkler_similarity(first1, last1, first2, last2, prefix_weight,
+                                                        score_cutoff);
+        });
+        return PyFloat_FromDouble(sim);
+    }
+    catch (...) {
+        CppExn2PyErr();
+        return nullptr;
+    }
+}
+
+/**
+ * @brief choices which are Latin-1 strings. They are scored several at a time by the
+ * SIMD kernel of the cached scorers, while all other choices are scored one at a time
+ */
+struct Latin1Choices {
+    std::vector<size_t> indices;
+    std::vector<const uint8_t*> data;
+    std::vector<int64_t> lengths;
+
+    Latin1Choices(const std::vector<RF_StringWrapper>& choices, size_t first, size_t last)
+    {
+        for (size_t i = first; i < last; ++i) {
+            const RF_StringWrapper& choice = choices[i];
+            if (choice.is_none() || choice.string.kind != RF_UINT8) continue;
+
+            indices.push_back(i);
+            data.push_back(static_cast<const uint8_t*>(choice.string.data));
+            lengths.push_back(choice.string.length);
+        }
+    }
+
+    size_t size() const
+    {
+        return indices.size();
+    }
+};
+
+/**
+ * @brief scores s1 against every element of choices. The bit masks of s1 are
+ * only calculated once and reused for all choices
+ */
+template <template <typename> class CachedScorer, typename... Args>
+static PyObject* similarity_many(PyObject* s1, PyObject* choices, PyObject* processor, PyObject* out,
+                                 double score_cutoff, Args... args)
+{
+    if (s1 == Py_None) {
+        Py_ssize_t len = PyObject_Length(choices);
+        if (len < 0) throw PythonError();
+        return ScoreVector(static_cast<size_t>(len), out).to_python();
+    }
+
+    StringArrayOwner owner;
+    std::vector<RF_StringWrapper> strings = conv_choices(choices, processor, "choices has to be a sequence", owner);
+    ScoreVector scores(strings.size(), out);
+
+    RF_StringWrapper str1 = conv_processed(processor, s1);
+    Latin1Choices latin1(strings, 0, strings.size());
+    jaro_winkler::FilterStats stats;
+    StatsScope stats_scope;
+
+    visit(str1.string, [&](auto first1, auto last1) {
+        using CharT1 = typename std::iterator_traits<decltype(first1)>::value_type;
+        CachedScorer<CharT1> scorer(first1, last1, args...);
+
+        std::vector<double> latin1_scores(latin1.size());
+        scorer.similarity_many(latin1.data.data(), latin1.lengths.data(), latin1.size(), latin1_scores.data(),
+                               score_cutoff, &stats);
+        for (size_t i = 0; i < latin1.size(); ++i)
+            scores.set(latin1.indices[i], latin1_scores[i]);
+
+        for (size_t i = 0; i < strings.size(); ++i) {
+            if (strings[i].is_none() || strings[i].string.kind == RF_UINT8) continue;
+
+            scores.set(i, visit(strings[i].string, [&](auto first2, auto last2) {
+                return scorer.filtered_similarity(first2, last2, score_cutoff, &stats);
+            }));
+        }
+    });
+    record_filter_stats(stats);
+    return scores.to_python();
+}
+
+PyDoc_STRVAR(jaro_similarity_many_doc, R"(jaro_similarity_many(s1, choices, *, processor=None, score_cutoff=None, out=None)
+--
+
+Calculates the jaro similarity of s1 to each element of choices
+
+Parameters
+----------
+s1 : Sequence[Hashable]
+    String to compare with every choice.
+choices : Sequence[Sequence[Hashable]]
+    Strings s1 is compared to. Elements which are None receive a score of 0.
+    Arrow string/binary arrays and NumPy arrays with the dtype S or U are
+    read in place without creating Python strings, unless a processor is used.
+processor: callable, optional
+    Optional callable that is used to preprocess the strings before
+    comparing them. Default is None, which deactivates this behaviour.
+score_cutoff : float, optional
+    Optional argument for a score threshold as a float between 0 and 1.0.
+    For ratio < score_cutoff 0 is returned instead. Default is 0,
+    which deactivates this behaviour.
+out : buffer, optional
+    Writable, contiguous buffer of float32 or float64 values with one element
+    per choice (e.g. array.array("d") or a numpy array) the similarities are
+    written to. Default is None, which returns the similarities as list.
+
+Returns
+-------
+similarities : list[float] | out
+    similarity between s1 and each choice as a float between 0 and 1.0
+)");
+
+static PyObject* jaro_similarity_many(PyObject* /*self*/, PyObject* const* args, Py_ssize_t nargs,
+                                      PyObject* kwnames)
+{
+    static const char* const names[] = {"s1", "choices", "processor", "score_cutoff", "out"};
+    static const ArgParser parser = {"jaro_similarity_many", names, 5, 2, 2};
+    PyObject* argv[5];
+    if (parse_args(parser, args, nargs, kwnames, argv) < 0) return nullptr;
+
+    PyObject* processor = argv[2] ? argv[2] : Py_None;
+    PyObject* py_score_cutoff = argv[3] ? argv[3] : Py_None;
+
+    try {
+        double score_cutoff = conv_score_cutoff(py_score_cutoff);
+        return similarity_many<jaro_winkler::CachedJaroSimilarity>(argv[0], argv[1], processor, argv[4],
+                                                                   score_cutoff);
+    }
+    catch (...) {
+        CppExn2PyErr();
+        return nullptr;
+    }
+}
+
+PyDoc_STRVAR(jarowinkler_similarity_many_doc, R"(jarowinkler_similarity_many(s1, choices, *, prefix_weight=0.1, processor=None, score_cutoff=None, out=None)
+--
+
+Calculates the jaro winkler similarity of s1 to each element of choices
+
+Parameters
+----------
+s1 : Sequence[Hashable]
+    String to compare with every choice.
+choices : Sequence[Sequence[Hashable]]
+    Strings s1 is compared to. Elements which are None receive a score of 0.
+    Arrow string/binary arrays and NumPy arrays with the dtype S or U are
+    read in place without creating Python strings, unless a processor is used.
+prefix_weight : float, optional
+    Weight used for the common prefix of the two strings.
+    Has to be between 0 and 0.25. Default is 0.1.
+processor: callable, optional
+    Optional callable that is used to preprocess the strings before
+    comparing them. Default is None, which deactivates this behaviour.
+score_cutoff : float, optional
+    Optional argument for a score threshold as a float between 0 and 1.0.
+    For ratio < score_cutoff 0 is returned instead. Default is 0,
+    which deactivates this behaviour.
+out : buffer, optional
+    Writable, contiguous buffer of float32 or float64 values with one element
+    per choice (e.g. array.array("d") or a numpy array) the similarities are
+    written to. Default is None, which returns the similarities as list.
+
+Returns
+-------
+similarities : list[float] | out
+    similarity between s1 and each choice as a float between 0 and 1.0
+
+Raises
+------
+ValueError
+    If prefix_weight is invalid or out has the wrong type or size
+)");
+
+static PyObject* jarowinkler_similarity_many(PyObject* /*self*/, PyObject* const* args, Py_ssize_t nargs,
+                                             PyObject* kwnames)
+{
+    static const char* const names[] = {"s1", "choices", "prefix_weight", "processor", "score_cutoff", "out"};
+    static const ArgParser parser = {"jarowinkler_similarity_many", names, 6, 2, 2};
+    PyObject* argv[6];
+    if (parse_args(parser, args, nargs, kwnames, argv) < 0) return nullptr;
+
+    PyObject* py_prefix_weight = argv[2];
+    PyObject* processor = argv[3] ? argv[3] : Py_None;
+    PyObject* py_score_cutoff = argv[4] ? argv[4] : Py_None;
+
+    try {
+        double prefix_weight = py_prefix_weight ? conv_prefix_weight(py_prefix_weight) : 0.1;
+        double score_cutoff = conv_score_cutoff(py_score_cutoff);
+        return similarity_many<jaro_winkler::CachedJaroWinklerSimilarity>(argv[0], argv[1], processor, argv[5],
+                                                                          score_cutoff, prefix_weight);
+    }
+    catch (...) {
+        CppExn2PyErr();
+        return nullptr;
+    }
+}
+
+PyDoc_STRVAR(JaroMatcher_doc, R"(JaroMatcher(pattern, *, processor=None)
+--
+
+Jaro similarity with a fixed pattern. The bit masks of the pattern are
+calculated once in the constructor and reused by every call to similarity,
+which makes it faster to compare one pattern with a lot of strings.
+
+Parameters
+----------
+pattern : Sequence[Hashable]
+    String all other strings are compared to.
+processor: callable, optional
+    Optional callable that is used to preprocess the pattern and the strings
+    passed to similarity. Default is None, which deactivates this behaviour.
+)");
+
+static PyObject* JaroMatcher_new(PyTypeObject* type, PyObject* args, PyObject* kwargs)
+{
+    static const char* kwlist[] = {"pattern", "processor", nullptr};
+    PyObject* pattern;
+    PyObject* processor = Py_None;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|$O:JaroMatcher", const_cast<char**>(kwlist), &pattern,
+                                     &processor))
+        return nullptr;
+
+    return Matcher_create(type, &JaroScorer, pattern, processor);
+}
+
+PyDoc_STRVAR(JaroWinklerMatcher_doc, R"(JaroWinklerMatcher(pattern, *, prefix_weight=0.1, processor=None)
+--
+
+Jaro-Winkler similarity with a fixed pattern. The bit masks of the pattern are
+calculated once in the constructor and reused by every call to similarity,
+which makes it faster to compare one pattern with a lot of strings.
+
+Parameters
+----------
+pattern : Sequence[Hashable]
+    String all other strings are compared to.
+prefix_weight : float, optional
+    Weight used for the common prefix of the two strings.
+    Has to be between 0 and 0.25. Default is 0.1.
+processor: callable, optional
+    Optional callable that is used to preprocess the pattern and the strings
+    passed to similarity. Default is None, which deactivates this behaviour.
+
+Raises
+------
+ValueError
+    If prefix_weight is invalid
+)");
+
+static PyObject* JaroWinklerMatcher_new(PyTypeObject* type, PyObject* args, PyObject* kwargs)
+{
+    static const char* kwlist[] = {"pattern", "prefix_weight", "processor", nullptr};
+    PyObject* pattern;
+    double prefix_weight = 0.1;
+    PyObject* processor = Py_None;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|$dO:JaroWinklerMatcher", const_cast<char**>(kwlist),
+                                     &pattern, &prefix_weight, &processor))
+        return nullptr;
+
+    try {
+        jaro_winkler::detail::validate_prefix_weight(prefix_weight);
+    }
+    catch (...) {
+        CppExn2PyErr();
+        return nullptr;
+    }
+
+    return Matcher_create(type, &JaroWinklerScorer, pattern, processor, prefix_weight);
+}
+
+enum class ScorerKind {
+    Jaro,
+    JaroWinkler
+};
+
+static ScorerKind conv_scorer(PyObject* scorer)
+{
+    if (!scorer) return ScorerKind::JaroWinkler;
+
+    if (Py_TYPE(scorer) == &ScorerFunctionType) {
+        ScorerImpl impl = reinterpret_cast<ScorerFunction*>(scorer)->impl;
+        if (impl == jaro_similarity) return ScorerKind::Jaro;
+        if (impl == jarowinkler_similarity) return ScorerKind::JaroWinkler;
+    }
+
+    throw std::invalid_argument("scorer has to be jaro_similarity or jarowinkler_similarity");
+}
+
+/**
+ * @brief converts the dtype argument. Accepts the strings "float32"/"float64" and objects
+ * with a matching name like numpy.float32 or numpy.dtype("float32")
+ *
+ * @return true for float32
+ */
+static bool conv_dtype(PyObject* dtype)
+{
+    if (!dtype || dtype == Py_None) return true;
+
+    PyObjectRef name;
+    if (PyUnicode_Check(dtype))
+        name = PyObjectRef::borrow(dtype);
+    else if (PyObject_HasAttrString(dtype, "name"))
+        name = PyObjectRef(PyObject_GetAttrString(dtype, "name"));
+    else
+        name = PyObjectRef(PyObject_GetAttrString(dtype, "__name__"));
+    if (!name) throw PythonError();
+
+    const char* str = PyUnicode_Check(name.get()) ? PyUnicode_AsUTF8(name.get()) : nullptr;
+    if (!str && PyErr_Occurred()) throw PythonError();
+
+    if (str && (!strcmp(str, "float32") || !strcmp(str, "f"))) return true;
+    if (str && (!strcmp(str, "float64") || !strcmp(str, "d") || !strcmp(str, "float"))) return false;
+    throw std::invalid_argument("dtype has to be float32 or float64");
+}
+
+static long long conv_workers(PyObject* py_workers)
+{
+    if (!py_workers) return 1;
+    if (ThreadPool* pool = get_thread_pool(py_workers)) return static_cast<long long>(pool->workers());
+
+    long long workers = PyLong_AsLongLong(py_workers);
+    if (workers == -1 && PyErr_Occurred()) throw PythonError();
+    return workers;
+}
+
+/* rows of the score matrix processed by a single task. Queries with more than 64 characters count
+ * as one row per block of 64 characters, since their comparisons take correspondingly longer */
+static const size_t CDIST_TILE_ROWS = 16;
+/* amount of choice characters in bytes per task, so they stay in the L2 cache for all rows of a tile */
+static const size_t CDIST_TILE_BYTES = 256 * 1024;
+
+static size_t string_bytes(const RF_String& str)
+{
+    switch (str.kind) {
+    case RF_UINT8: return static_cast<size_t>(str.length);
+    case RF_UINT16: return static_cast<size_t>(str.length) * 2;
+    case RF_UINT32: return static_cast<size_t>(str.length) * 4;
+    default: return static_cast<size_t>(str.length) * 8;
+    }
+}
+
+/**
+ * @brief splits the choices into column tiles of roughly CDIST_TILE_BYTES
+ * @return boundaries of the tiles
+ */
+static std::vector<size_t> cdist_column_tiles(const std::vector<RF_StringWrapper>& choices)
+{
+    std::vector<size_t> bounds = {0};
+    size_t bytes = 0;
+    for (size_t col = 0; col < choices.size(); ++col) {
+        bytes += string_bytes(choices[col].string) + 64;
+        if (bytes >= CDIST_TILE_BYTES) {
+            bounds.push_back(col + 1);
+            bytes = 0;
+        }
+    }
+    if (bounds.back() != choices.size()) bounds.push_back(choices.size());
+    return bounds;
+}
+
+/**
+ * @brief splits the queries into row tiles of roughly CDIST_TILE_ROWS rows of 64 characters
+ * @return boundaries of the tiles
+ */
+static std::vector<size_t> cdist_row_tiles(const std::vector<RF_StringWrapper>& queries)
+{
+    std::vector<size_t> bounds = {0};
+    size_t rows = 0;
+    for (size_t row = 0; row < queries.size(); ++row) {
+        rows += 1 + static_cast<size_t>(queries[row].string.length) / 64;
+        if (rows >= CDIST_TILE_ROWS) {
+            bounds.push_back(row + 1);
+            rows = 0;
+        }
+    }
+    if (bounds.back() != queries.size()) bounds.push_back(queries.size());
+    return bounds;
+}
+
+/**
+ * @brief fills the score matrix. The matrix is split into tiles, which are processed in parallel
+ * without holding the GIL. Inside a tile the cached scorer of each query is reused for all columns.
+ * When queries and choices are the same list, only the upper triangle is calculated and mirrored.
+ */
+template <template <typename> class CachedScorer, typename... Args>
+static void cdist_impl(const std::vector<RF_StringWrapper>& queries, const std::vector<RF_StringWrapper>& choices,
+                       bool symmetric, double score_cutoff, ThreadPool* pool, size_t workers, ScoreMatrix& matrix,
+                       Args... args)
+{
+    std::vector<size_t> col_bounds = cdist_column_tiles(choices);
+    std::vector<size_t> row_bounds = cdist_row_tiles(queries);
+    size_t col_tiles = col_bounds.size() - 1;
+    size_t row_tiles = row_bounds.size() - 1;
+
+    GilRelease gil;
+    run_parallel(pool, workers, row_tiles * col_tiles, [&](size_t task) {
+        size_t row_first = row_bounds[task / col_tiles];
+        size_t row_last = row_bounds[task / col_tiles + 1];
+        size_t col_first = col_bounds[task % col_tiles];
+        size_t col_last = col_bounds[task % col_tiles + 1];
+
+        /* the tile is part of the lower triangle */
+        if (symmetric && col_last <= row_first) return;
+
+        /* the Latin-1 choices of the tile are prepared once for the SIMD kernel and shared by all rows */
+        Latin1Choices latin1(choices, col_first, col_last);
+        jaro_winkler::detail::JaroSimdPatterns patterns(latin1.data.data(), latin1.lengths.data(), latin1.size());
+        std::vector<double> latin1_scores(latin1.size());
+        jaro_winkler::FilterStats stats;
+
+        for (size_t row = row_first; row < row_last; ++row) {
+            size_t col_start = symmetric ? std::max(col_first, row) : col_first;
+            auto store = [&](size_t col, double score) {
+                matrix.set(row, col, score);
+                if (symmetric) matrix.set(col, row, score);
+            };
+
+            if (queries[row].is_none()) {
+                for (size_t col = col_start; col < col_last; ++col)
+                    store(col, 0.0);
+                continue;
+            }
+
+            visit(queries[row].string, [&](auto first1, auto last1) {
+                using CharT1 = typename std::iterator_traits<decltype(first1)>::value_type;
+                CachedScorer<CharT1> scorer(first1, last1, args...);
+
+                /* on the diagonal the choices left of col_start are part of the lower triangle */
+                size_t latin1_first = static_cast<size_t>(
+                    std::lower_bound(latin1.indices.begin(), latin1.indices.end(), col_start) -
+                    latin1.indices.begin());
+                scorer.similarity_many(patterns, latin1.data.data(), latin1.lengths.data(), latin1_scores.data(),
+                                       score_cutoff, &stats, latin1_first);
+                for (size_t i = latin1_first; i < latin1.size(); ++i)
+                    store(latin1.indices[i], latin1_scores[i]);
+
+                for (size_t col = col_start; col < col_last; ++col) {
+                    if (choices[col].is_none()) {
+                        store(col, 0.0);
+                        continue;
+                    }
+                    if (choices[col].string.kind == RF_UINT8) continue;
+
+                    store(col, visit(choices[col].string, [&](auto first2, auto last2) {
+                        return scorer.filtered_similarity(first2, last2, score_cutoff, &stats);
+                    }));
+                }
+            });
+        }
+        record_filter_stats(stats);
+    });
+}
+
+PyDoc_STRVAR(cdist_doc, R"(cdist(queries, choices, *, scorer=jarowinkler_similarity, prefix_weight=0.1, processor=None, score_cutoff=None, dtype=None, workers=1, out=None)
+--
+
+Calculates the similarity of every query to every choice
+
+Parameters
+----------
+queries : Sequence[Sequence[Hashable]]
+    list of all strings the choices are compared to. Elements which are
+    None receive a score of 0.
+choices : Sequence[Sequence[Hashable]]
+    list of all strings the queries are compared to. When this is the same
+    object as queries, only half of the matrix is calculated.
+    Arrow string/binary arrays and NumPy arrays with the dtype S or U are
+    read in place for both queries and choices, unless a processor is used.
+scorer : jaro_similarity | jarowinkler_similarity, optional
+    Scorer used to compare the strings. Default is jarowinkler_similarity.
+prefix_weight : float, optional
+    Weight used for the common prefix of the two strings.
+    Has to be between 0 and 0.25. Default is 0.1.
+    Only supported by jarowinkler_similarity.
+processor: callable, optional
+    Optional callable that is used to preprocess the strings before
+    comparing them. Default is None, which deactivates this behaviour.
+score_cutoff : float, optional
+    Optional argument for a score threshold as a float between 0 and 1.0.
+    For ratio < score_cutoff 0 is returned instead. Default is 0,
+    which deactivates this behaviour.
+dtype : str | numpy.dtype, optional
+    float32 or float64. Default is float32. Ignored when out is passed.
+workers : int | ThreadPool, optional
+    Number of threads used to calculate the matrix. The GIL is released
+    during the calculation. -1 uses all available cores. A ``ThreadPool``
+    shares its threads with other calls instead of starting new ones.
+    Default is 1.
+out : buffer, optional
+    Writable, C-contiguous buffer of float32 or float64 values with the shape
+    (len(queries), len(choices)) the similarities are written to.
+
+Returns
+-------
+matrix : memoryview | out
+    2D memoryview with the shape (len(queries), len(choices)) holding the
+    similarities. It can be converted without copying using numpy.asarray.
+
+Raises
+------
+ValueError
+    If prefix_weight, dtype, workers or out are invalid
+)");
+
+static PyObject* cdist(PyObject* /*self*/, PyObject* const* args, Py_ssize_t nargs, PyObject* kwnames)
+{
+    static const char* const names[] = {"queries",      "choices", "scorer",  "prefix_weight", "processor",
+                                        "score_cutoff", "dtype",   "workers", "out"};
+    static const ArgParser parser = {"cdist", names, 9, 2, 2};
+    PyObject* argv[9];
+    if (parse_args(parser, args, nargs, kwnames, argv) < 0) return nullptr;
+
+    PyObject* py_queries = argv[0];
+    PyObject* py_choices = argv[1];
+    PyObject* py_prefix_weight = argv[3];
+    PyObject* processor = argv[4] ? argv[4] : Py_None;
+
+    try {
+        ScorerKind scorer = conv_scorer(argv[2]);
+        if (scorer == ScorerKind::Jaro && py_prefix_weight)
+            throw std::invalid_argument("prefix_weight is only supported by jarowinkler_similarity");
+
+        double prefix_weight = py_prefix_weight ? conv_prefix_weight(py_prefix_weight) : 0.1;
+        double score_cutoff = conv_score_cutoff(argv[5] ? argv[5] : Py_None);
+        bool f32 = conv_dtype(argv[6]);
+        ThreadPool* pool = get_thread_pool(argv[7]);
+        size_t workers = resolve_workers(conv_workers(argv[7]));
+
+        bool symmetric = py_queries == py_choices;
+        StringArrayOwner queries_owner;
+        StringArrayOwner choices_owner;
+        std::vector<RF_StringWrapper> queries =
+            conv_choices(py_queries, processor, "queries has to be a sequence", queries_owner);
+        std::vector<RF_StringWrapper> choices;
+        if (!symmetric) choices = conv_choices(py_choices, processor, "choices has to be a sequence", choices_owner);
+        const std::vector<RF_StringWrapper>& cols = symmetric ? queries : choices;
+
+        ScoreMatrix matrix(queries.size(), cols.size(), argv[8], f32);
+        if (scorer == ScorerKind::Jaro)
+            cdist_impl<jaro_winkler::CachedJaroSimilarity>(queries, cols, symmetric, score_cutoff, pool, workers,
+                                                           matrix);
+        else
+            cdist_impl<jaro_winkler::CachedJaroWinklerSimilarity>(queries, cols, symmetric, score_cutoff, pool,
+                                                                  workers, matrix, prefix_weight);
+
+        return matrix.to_python();
+    }
+    catch (...) {
+        CppExn2PyErr();
+        return nullptr;
+    }
+}
+
+struct JoinMatch {
+    size_t row;
+    size_t col;
+    double score;
+};
+
+/* rectangle of the strings sorted by length, which is scored by a single task of self_join */
+struct JoinTile {
+    size_t row_first;
+    size_t row_last;
+    size_t col_first;
+    size_t col_last;
+};
+
+/**
+ * @brief finds all pairs of strings with a similarity of at least score_cutoff. The strings are
+ * sorted by length, so the strings each string can reach according to the length bound follow
+ * it directly. Only this window above the diagonal is split into tiles like in cdist, and the
+ * remaining pairs are rejected by the histogram filter of the scorers before they are scored.
+ *
+ * @return matches with row < col ordered by row and col
+ */
+template <template <typename> class CachedScorer, typename... Args>
+static std::vector<JoinMatch> self_join_impl(const std::vector<RF_StringWrapper>& strings, double score_cutoff,
+                                             double prefix_weight, ThreadPool* pool, size_t workers, Args... args)
+{
+    std::vector<size_t> order;
+    for (size_t i = 0; i < strings.size(); ++i)
+        if (!strings[i].is_none()) order.push_back(i);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return strings[a].string.length < strings[b].string.length;
+    });
+    auto length = [&](size_t pos) {
+        return strings[order[pos]].string.length;
+    };
+
+    /* the bound decreases with the length of the longer string and increases with the length of
+     * the shorter one, so the end of the window only moves forward */
+    std::vector<size_t> window_end(order.size());
+    size_t end = 0;
+    for (size_t pos = 0; pos < order.size(); ++pos) {
+        end = std::max(end, pos + 1);
+        while (end < order.size() &&
+               jaro_winkler::detail::jarowinkler_length_bound(length(pos), length(end), prefix_weight) >= score_cutoff)
+            ++end;
+        window_end[pos] = end;
+    }
+
+    std::vector<JoinTile> tiles;
+    size_t row_first = 0;
+    size_t rows = 0;
+    for (size_t pos = 0; pos < order.size(); ++pos) {
+        rows += 1 + static_cast<size_t>(length(pos)) / 64;
+        if (rows < CDIST_TILE_ROWS && pos + 1 != order.size()) continue;
+
+        size_t col_first = row_first + 1;
+        size_t bytes = 0;
+        for (size_t col = col_first; col < window_end[pos]; ++col) {
+            bytes += string_bytes(strings[order[col]].string) + 64;
+            if (bytes >= CDIST_TILE_BYTES || col + 1 == window_end[pos]) {
+                tiles.push_back({row_first, pos + 1, col_first, col + 1});
+                col_first = col + 1;
+                bytes = 0;
+            }
+        }
+        row_first = pos + 1;
+        rows = 0;
+    }
+
+    std::vector<std::vector<JoinMatch>> tile_matches(tiles.size());
+    {
+        GilRelease gil;
+        run_parallel(pool, workers, tiles.size(), [&](size_t task) {
+            const JoinTile& tile = tiles[task];
+            std::vector<JoinMatch>& matches = tile_matches[task];
+            auto add = [&](size_t pos1, size_t pos2, double score) {
+                if (pos2 <= pos1 || score < score_cutoff) return;
+                size_t a = order[pos1];
+                size_t b = order[pos2];
+                matches.push_back({std::min(a, b), std::max(a, b), score});
+            };
+
+            std::vector<size_t> latin1_pos;
+            std::vector<const uint8_t*> latin1_data;
+            std::vector<int64_t> latin1_lengths;
+            for (size_t col = tile.col_first; col < tile.col_last; ++col) {
+                const RF_String& str = strings[order[col]].string;
+                if (str.kind != RF_UINT8) continue;
+                latin1_pos.push_back(col);
+                latin1_data.push_back(static_cast<const uint8_t*>(str.data));
+                latin1_lengths.push_back(str.length);
+            }
+            jaro_winkler::detail::JaroSimdPatterns patterns(latin1_data.data(), latin1_lengths.data(),
+                                                            latin1_data.size());
+            std::vector<double> latin1_scores(latin1_data.size());
+            jaro_winkler::FilterStats stats;
+
+            for (size_t row = tile.row_first; row < tile.row_last; ++row) {
+                if (window_end[row] <= tile.col_first) continue;
+
+                visit(strings[order[row]].string, [&](auto first1, auto last1) {
+                    using CharT1 = typename std::iterator_traits<decltype(first1)>::value_type;
+                    CachedScorer<CharT1> scorer(first1, last1, args...);
+
+                    /* only the columns after row, which are inside of its window */
+                    size_t latin1_first = static_cast<size_t>(
+                        std::upper_bound(latin1_pos.begin(), latin1_pos.end(), row) - latin1_pos.begin());
+                    size_t latin1_last = static_cast<size_t>(
+                        std::lower_bound(latin1_pos.begin(), latin1_pos.end(), window_end[row]) - latin1_pos.begin());
+                    scorer.similarity_many(patterns, latin1_data.data(), latin1_lengths.data(),
+                                           latin1_scores.data(), score_cutoff, &stats, latin1_first, latin1_last);
+                    for (size_t i = latin1_first; i < latin1_last; ++i)
+                        add(row, latin1_pos[i], latin1_scores[i]);
+
+                    size_t col_last = std::min(tile.col_last, window_end[row]);
+                    for (size_t col = std::max(tile.col_first, row + 1); col < col_last; ++col) {
+                        const RF_String& str = strings[order[col]].string;
+                        if (str.kind == RF_UINT8) continue;
+                        add(row, col, visit(str, [&](auto first2, auto last2) {
+                            return scorer.filtered_similarity(first2, last2, score_cutoff, &stats);
+                        }));
+                    }
+                });
+            }
+            record_filter_stats(stats);
+        });
+    }
+
+    std::vector<JoinMatch> matches;
+    for (const std::vector<JoinMatch>& part : tile_matches)
+        matches.insert(matches.end(), part.begin(), part.end());
+    std::sort(matches.begin(), matches.end(), [](const JoinMatch& a, const JoinMatch& b) {
+        return a.row != b.row ? a.row < b.row : a.col < b.col;
+    });
+    return matches;
+}
+
+PyDoc_STRVAR(self_join_doc, R"(self_join(strings, score_cutoff, *, scorer=jarowinkler_similarity, prefix_weight=0.1, processor=None, dtype=None, workers=1)
+--
+
+Finds all pairs ``(i, j)`` with ``i < j`` of strings in a single list with a
+similarity of at least score_cutoff, e.g. to find duplicates. Only the pairs
+whose lengths allow a similarity of at least score_cutoff are compared, and the
+remaining pairs are mostly rejected by a histogram of their characters.
+
+The result is returned in coordinate format instead of a matrix, so its size
+only depends on the amount of pairs found. It can be converted into a sparse
+matrix using ``scipy.sparse.coo_matrix((scores, (rows, cols)), shape=(n, n))``.
+
+Parameters
+----------
+strings : Sequence[Sequence[Hashable]]
+    list of all strings. Elements which are None are not part of any pair.
+    Arrow string/binary arrays and NumPy arrays with the dtype S or U are
+    read in place, unless a processor is used.
+score_cutoff : float
+    Similarity between 0 (exclusive) and 1.0 a pair needs to reach.
+scorer : jaro_similarity | jarowinkler_similarity, optional
+    Scorer used to compare the strings. Default is jarowinkler_similarity.
+prefix_weight : float, optional
+    Weight used for the common prefix of the two strings.
+    Has to be between 0 and 0.25. Default is 0.1.
+    Only supported by jarowinkler_similarity.
+processor: callable, optional
+    Optional callable that is used to preprocess the strings before
+    comparing them. Default is None, which deactivates this behaviour.
+dtype : str | numpy.dtype, optional
+    float32 or float64 for the scores. Default is float32.
+workers : int | ThreadPool, optional
+    Number of threads used to compare the strings. The GIL is released
+    during the calculation. -1 uses all available cores. Default is 1.
+
+Returns
+-------
+rows : memoryview
+    int64 index of the first string of every pair
+cols : memoryview
+    int64 index of the second string of every pair, which is larger than the first one
+scores : memoryview
+    similarity of every pair
+
+The pairs are ordered by rows and then cols.
+
+Raises
+------
+ValueError
+    If score_cutoff, prefix_weight, dtype or workers are invalid
+)");
+
+static PyObject* self_join(PyObject* /*self*/, PyObject* const* args, Py_ssize_t nargs, PyObject* kwnames)
+{
+    static const char* const names[] = {"strings",   "score_cutoff", "scorer", "prefix_weight",
+                                        "processor", "dtype",        "workers"};
+    static const ArgParser parser = {"self_join", names, 7, 2, 2};
+    PyObject* argv[7];
+    if (parse_args(parser, args, nargs, kwnames, argv) < 0) return nullptr;
+
+    PyObject* py_prefix_weight = argv[3];
+    PyObject* processor = argv[4] ? argv[4] : Py_None;
+
+    try {
+        ScorerKind scorer = conv_scorer(argv[2]);
+        if (scorer == ScorerKind::Jaro && py_prefix_weight)
+            throw std::invalid_argument("prefix_weight is only supported by jarowinkler_similarity");
+
+        double prefix_weight = py_prefix_weight ? conv_prefix_weight(py_prefix_weight) : 0.1;
+        double score_cutoff = conv_score_cutoff(argv[1]);
+        if (!(score_cutoff > 0.0 && score_cutoff <= 1.0))
+            throw std::invalid_argument("score_cutoff has to be greater than 0 and at most 1.0");
+        bool f32 = conv_dtype(argv[5]);
+        ThreadPool* pool = get_thread_pool(argv[6]);
+        size_t workers = resolve_workers(conv_workers(argv[6]));
+
+        StringArrayOwner strings_owner;
+        std::vector<RF_StringWrapper> strings =
+            conv_choices(argv[0], processor, "strings has to be a sequence", strings_owner);
+
+        std::vector<JoinMatch> matches;
+        if (scorer == ScorerKind::Jaro)
+            matches = self_join_impl<jaro_winkler::CachedJaroSimilarity>(strings, score_cutoff, 0.0, pool, workers);
+        else
+            matches = self_join_impl<jaro_winkler::CachedJaroWinklerSimilarity>(strings, score_cutoff, prefix_weight,
+                                                                                pool, workers, prefix_weight);
+
+        Py_ssize_t count = static_cast<Py_ssize_t>(matches.size());
+        PyObjectRef rows = ResultBuffer_create({count}, 'q');
+        PyObjectRef cols = ResultBuffer_create({count}, 'q');
+        PyObjectRef scores = ResultBuffer_create({count}, f32 ? 'f' : 'd');
+        int64_t* row_data = reinterpret_cast<int64_t*>(reinterpret_cast<ResultBuffer*>(rows.get())->data);
+        int64_t* col_data = reinterpret_cast<int64_t*>(reinterpret_cast<ResultBuffer*>(cols.get())->data);
+        char* score_data = reinterpret_cast<ResultBuffer*>(scores.get())->data;
+        for (size_t i = 0; i < matches.size(); ++i) {
+            row_data[i] = static_cast<int64_t>(matches[i].row);
+            col_data[i] = static_cast<int64_t>(matches[i].col);
+            if (f32)
+                reinterpret_cast<float*>(score_data)[i] = static_cast<float>(matches[i].score);
+            else
+                reinterpret_cast<double*>(score_data)[i] = matches[i].score;
+        }
+
+        return Py_BuildValue("(NNN)", PyMemoryView_FromObject(rows.get()), PyMemoryView_FromObject(cols.get()),
+                             PyMemoryView_FromObject(scores.get()));
+    }
+    catch (...) {
+        CppExn2PyErr();
+        return nullptr;
+    }
+}
+
+/**
+ * @brief finds the limit best choices
+ *
+ * @return matches ordered from best to worst
+ */
+template <template <typename> class CachedScorer, typename... Args>
+static std::vector<ExtractMatch> extract_impl(const RF_StringWrapper& query,
+                                              const std::vector<RF_StringWrapper>& choices, size_t limit,
+                                              double score_cutoff, Args... args)
+{
+    TopMatches matches(limit, score_cutoff);
+    if (!limit || query.is_none()) return matches.take();
+    jaro_winkler::FilterStats stats;
+    StatsScope stats_scope;
+
+    visit(query.string, [&](auto first1, auto last1) {
+        using CharT1 = typename std::iterator_traits<decltype(first1)>::value_type;
+        CachedScorer<CharT1> scorer(first1, last1, args...);
+
+        for (size_t i = 0; i < choices.size(); ++i) {
+            if (choices[i].is_none()) continue;
+
+            double cutoff = matches.score_cutoff();
+            matches.add(visit(choices[i].string, [&](auto first2, auto last2) {
+                return scorer.filtered_similarity(first2, last2, cutoff, &stats);
+            }), i);
+        }
+    });
+
+    record_filter_stats(stats);
+    return matches.take();
+}
+
+PyDoc_STRVAR(extract_doc, R"(extract(query, choices, *, scorer=jarowinkler_similarity, prefix_weight=0.1, processor=None, score_cutoff=None, limit=5)
+--
+
+Finds the best matches of query in a list of choices
+
+Parameters
+----------
+query : Sequence[Hashable]
+    String to compare with every choice.
+choices : Sequence[Sequence[Hashable]]
+    list of all strings the query is compared to. Elements which are
+    None are skipped.
+scorer : jaro_similarity | jarowinkler_similarity, optional
+    Scorer used to compare the strings. Default is jarowinkler_similarity.
+prefix_weight : float, optional
+    Weight used for the common prefix of the two strings.
+    Has to be between 0 and 0.25. Default is 0.1.
+    Only supported by jarowinkler_similarity.
+processor: callable, optional
+    Optional callable that is used to preprocess the strings before
+    comparing them. Default is None, which deactivates this behaviour.
+score_cutoff : float, optional
+    Optional argument for a score threshold as a float between 0 and 1.0.
+    Choices with a similarity below score_cutoff are not returned.
+    Default is 0, which deactivates this behaviour.
+limit : int | None, optional
+    Maximum number of matches returned. None returns all matches. Default is 5.
+    Once limit matches are found, the score of the worst of them is used as
+    score_cutoff for the remaining choices, which allows skipping most of them.
+
+Returns
+-------
+matches : list[tuple[Sequence[Hashable], float, int]]
+    list of (choice, similarity, index) tuples sorted by descending similarity.
+    Choices with the same similarity keep their order in choices.
+
+Raises
+------
+ValueError
+    If prefix_weight or limit are invalid
+)");
+
+static PyObject* extract(PyObject* /*self*/, PyObject* const* args, Py_ssize_t nargs, PyObject* kwnames)
+{
+    static const char* const names[] = {"query",     "choices",      "scorer", "prefix_weight",
+                                        "processor", "score_cutoff", "limit"};
+    static const ArgParser parser = {"extract", names, 7, 2, 2};
+    PyObject* argv[7];
+    if (parse_args(parser, args, nargs, kwnames, argv) < 0) return nullptr;
+
+    PyObject* py_query = argv[0];
+    PyObject* py_prefix_weight = argv[3];
+    PyObject* processor = argv[4] ? argv[4] : Py_None;
+
+    try {
+        ScorerKind scorer = conv_scorer(argv[2]);
+        if (scorer == ScorerKind::Jaro && py_prefix_weight)
+            throw std::invalid_argument("prefix_weight is only supported by jarowinkler_similarity");
+
+        double prefix_weight = py_prefix_weight ? conv_prefix_weight(py_prefix_weight) : 0.1;
+        double score_cutoff = conv_score_cutoff(argv[5] ? argv[5] : Py_None);
+
+        /* the processor could modify choices, so the returned choices are taken from a copy */
+        PyObjectRef py_choices = choices_tuple(argv[1]);
+        size_t limit = conv_limit(argv[6], choices_size(py_choices.get()));
+
+        RF_StringWrapper query;
+        if (py_query != Py_None) query = conv_processed(processor, py_query);
+        std::vector<RF_StringWrapper> choices = conv_sequences(get_corpus(argv[1]) ? argv[1] : py_choices.get(),
+                                                               processor, "choices has to be a sequence");
+
+        std::vector<ExtractMatch> matches;
+        if (scorer == ScorerKind::Jaro)
+            matches = extract_impl<jaro_winkler::CachedJaroSimilarity>(query, choices, limit, score_cutoff);
+        else
+            matches = extract_impl<jaro_winkler::CachedJaroWinklerSimilarity>(query, choices, limit, score_cutoff,
+                                                                              prefix_weight);
+
+        return matches_to_python(py_choices.get(), matches);
+    }
+    catch (...) {
+        CppExn2PyErr();
+        return nullptr;
+    }
+}
+
+PyDoc_STRVAR(preprocess_doc, R"(preprocess(strings, processor=None)
+--
+
+Runs the processor once for every string and stores the results in a
+contiguous native buffer. The returned corpus and its elements can be passed
+to all functions of this module, which use the processed strings in place
+instead of running the processor again.
+
+Parameters
+----------
+strings : Sequence[Sequence[Hashable] | None]
+    Strings to preprocess. Elements which are None stay None.
+processor: callable, optional
+    Optional callable that is used to preprocess the strings. Default is None,
+    which only converts the strings.
+
+Returns
+-------
+corpus : PreprocessedCorpus
+    sequence of the preprocessed strings. The original strings are
+    available as ``corpus.strings``
+)");
+
+static PyObject* preprocess_strings(PyObject* /*self*/, PyObject* const* args, Py_ssize_t nargs, PyObject* kwnames)
+{
+    static const char* const names[] = {"strings", "processor"};
+    static const ArgParser parser = {"preprocess", names, 2, 2, 1};
+    PyObject* argv[2];
+    if (parse_args(parser, args, nargs, kwnames, argv) < 0) return nullptr;
+
+    PyObject* processor = argv[1] ? argv[1] : Py_None;
+    try {
+        /* the processor could modify strings, so the original strings are taken from a copy */
+        PreprocessedCorpus* corpus = get_corpus(argv[0]);
+        PyObjectRef strings = corpus ? PyObjectRef(PreprocessedCorpus_strings(corpus)) : choices_tuple(argv[0]);
+        if (!strings) throw PythonError();
+        PyObject* seq = corpus ? argv[0] : strings.get();
+
+        std::unique_ptr<StringArena> arena(new StringArena());
+        for (const RF_StringWrapper& str : conv_sequences(seq, processor, "strings has to be a sequence")) {
+            if (str.is_none())
+                arena->add_none();
+            else
+                arena->add(str.string);
+        }
+        return PreprocessedCorpus_create(strings.get(), processor, std::move(arena));
+    }
+    catch (...) {
+        CppExn2PyErr();
+        return nullptr;
+    }
+}
+
+PyDoc_STRVAR(histogram_filter_stats_doc, R"(histogram_filter_stats(*, reset=False)
+--
+
+Returns the counters of the histogram filter. When a score_cutoff is passed to
+a function comparing one string with many, the characters both strings share are
+counted first. Choices which can not reach score_cutoff with this amount of
+common characters are rejected without calculating the similarity.
+
+Parameters
+----------
+reset : bool, optional
+    Set the counters back to 0 after reading them. Default is False.
+
+Returns
+-------
+stats : dict[str, int]
+    "candidates": strings checked by the filter and "rejected": strings
+    rejected by it.
+)");
+
+static PyObject* histogram_filter_stats(PyObject* /*self*/, PyObject* const* args, Py_ssize_t nargs,
+                                        PyObject* kwnames)
+{
+    static const char* const names[] = {"reset"};
+    static const ArgParser parser = {"histogram_filter_stats", names, 1, 0, 0};
+    PyObject* argv[1];
+    if (parse_args(parser, args, nargs, kwnames, argv) < 0) return nullptr;
+
+    int reset = argv[0] ? PyObject_IsTrue(argv[0]) : 0;
+    if (reset < 0) return nullptr;
+
+    int64_t candidates = reset ? g_filter_candidates.exchange(0) : g_filter_candidates.load();
+    int64_t rejected = reset ? g_filter_rejected.exchange(0) : g_filter_rejected.load();
+    return Py_BuildValue("{s:L,s:L}", "candidates", static_cast<long long>(candidates), "rejected",
+                         static_cast<long long>(rejected));
+}
+
+PyDoc_STRVAR(enable_stats_doc, R"(enable_stats(enabled=True)
+--
+
+Starts or stops collecting runtime statistics about the paths taken by the scorers.
+They are disabled by default. While they are enabled every thread counts into its own
+counters, which are only merged by get_stats, so the overhead stays low.
+
+Parameters
+----------
+enabled : bool, optional
+    Whether statistics are collected. Default is True.
+)");
+
+static PyObject* enable_stats(PyObject* /*self*/, PyObject* const* args, Py_ssize_t nargs, PyObject* kwnames)
+{
+    static const char* const names[] = {"enabled"};
+    static const ArgParser parser = {"enable_stats", names, 1, 1, 0};
+    PyObject* argv[1];
+    if (parse_args(parser, args, nargs, kwnames, argv) < 0) return nullptr;
+
+    int enabled = argv[0] ? PyObject_IsTrue(argv[0]) : 1;
+    if (enabled < 0) return nullptr;
+
+    g_stats_enabled.store(enabled != 0, std::memory_order_relaxed);
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(get_stats_doc, R"(get_stats()
+--
+
+Returns the runtime statistics collected since the last call to reset_stats, while
+they were enabled with enable_stats. They help to choose a score_cutoff and to detect
+inputs which end up on slow paths.
+
+Returns
+-------
+stats : dict
+    "enabled": whether statistics are collected, "calls": compared pairs of strings,
+    "paths": the calls split by the path answering them ("empty" string shortcut,
+    "length_rejected" by the length bound of score_cutoff, "histogram_rejected" by the
+    characters in common, "single_word" kernel for up to 64 characters, "multi_word"
+    block kernel and "simd" kernel), "hashed": calls with characters looked up in a
+    hashmap (characters >= 256 or sequences of hashables), "early_exits": calls stopped
+    after counting the common characters, since score_cutoff can not be reached, and
+    "length_histogram": calls by the length of the longer string.
+    JaroWinklerIndex skips the lengths, which can not reach score_cutoff, without
+    comparing their choices, so they are not counted.
+
+Examples
+--------
+>>> enable_stats()
+>>> score = jarowinkler_similarity("this is an example", "this is another example")
+>>> get_stats()["paths"]["single_word"]
+1
+)");
+
+static PyObject* get_stats(PyObject* /*self*/, PyObject* /*args*/)
+{
+    StatsTotals stats = read_stats(false);
+
+    PyObjectRef histogram(PyDict_New());
+    if (!histogram) return nullptr;
+    for (size_t i = 0; i < jaro_winkler::JaroStats::LENGTH_BUCKETS; ++i) {
+        char label[32];
+        if (i < 3)
+            std::snprintf(label, sizeof(label), "%d", static_cast<int>(i));
+        else if (i + 1 == jaro_winkler::JaroStats::LENGTH_BUCKETS)
+            std::snprintf(label, sizeof(label), ">%d", 1 << (i - 2));
+        else
+            std::snprintf(label, sizeof(label), "%d-%d", (1 << (i - 2)) + 1, 1 << (i - 1));
+
+        PyObjectRef count(PyLong_FromLongLong(stats.length_histogram[i]));
+        if (!count || PyDict_SetItemString(histogram.get(), label, count.get()) < 0) return nullptr;
+    }
+
+    return Py_BuildValue("{s:O,s:L,s:{s:L,s:L,s:L,s:L,s:L,s:L},s:L,s:L,s:O}", "enabled",
+                         g_stats_enabled.load(std::memory_order_relaxed) ? Py_True : Py_False, "calls",
+                         static_cast<long long>(stats.calls), "paths", "empty", static_cast<long long>(stats.empty),
+                         "length_rejected", static_cast<long long>(stats.length_rejected), "histogram_rejected",
+                         static_cast<long long>(stats.histogram_rejected), "single_word",
+                         static_cast<long long>(stats.single_word), "multi_word",
+                         static_cast<long long>(stats.multi_word), "simd", static_cast<long long>(stats.simd),
+                         "hashed", static_cast<long long>(stats.hashed), "early_exits",
+                         static_cast<long long>(stats.early_exits), "length_histogram", histogram.get());
+}
+
+PyDoc_STRVAR(reset_stats_doc, R"(reset_stats()
+--
+
+Sets the runtime statistics reported by get_stats back to 0.
+)");
+
+static PyObject* reset_stats(PyObject* /*self*/, PyObject* /*args*/)
+{
+    read_stats(true);
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef initialize_cpp_methods[] = {
+    {"jaro_similarity_many",
+     reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(jaro_similarity_many)),
+     METH_FASTCALL | METH_KEYWORDS, jaro_similarity_many_doc},
+    {"jarowinkler_similarity_many",
+     reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(jarowinkler_similarity_many)),
+     METH_FASTCALL | METH_KEYWORDS, jarowinkler_similarity_many_doc},
+    {"cdist", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(cdist)), METH_FASTCALL | METH_KEYWORDS,
+     cdist_doc},
+    {"self_join", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(self_join)),
+     METH_FASTCALL | METH_KEYWORDS, self_join_doc},
+    {"extract", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(extract)),
+     METH_FASTCALL | METH_KEYWORDS, extract_doc},
+    {"preprocess", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(preprocess_strings)),
+     METH_FASTCALL | METH_KEYWORDS, preprocess_doc},
+    {"compile_corpus", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(compile_corpus)),
+     METH_FASTCALL | METH_KEYWORDS, compile_corpus_doc},
+    {"load_corpus", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(load_corpus)),
+     METH_FASTCALL | METH_KEYWORDS, load_corpus_doc},
+    {"histogram_filter_stats",
+     reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(histogram_filter_stats)),
+     METH_FASTCALL | METH_KEYWORDS, histogram_filter_stats_doc},
+    {"enable_stats", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(enable_stats)),
+     METH_FASTCALL | METH_KEYWORDS, enable_stats_doc},
+    {"get_stats", get_stats, METH_NOARGS, get_stats_doc},
+    {"reset_stats", reset_stats, METH_NOARGS, reset_stats_doc},
+    {nullptr, nullptr, 0, nullptr}};
+
+/**
+ * @brief adds a scorer function to the module and attaches the RapidFuzz C-API to it
+ */
+static int add_scorer(PyObject* module, const char* name, const char* doc, ScorerImpl impl, RF_Scorer* scorer)
+{
+    PyObject* func = add_scorer_function(module, name, doc, impl);
+    if (!func) return -1;
+
+    PyObjectRef capsule(PyCapsule_New(scorer, nullptr, nullptr));
+    if (!capsule) return -1;
+
+    if (PyObject_SetAttrString(func, "_RF_Scorer", capsule.get()) < 0) return -1;
+    return PyObject_SetAttrString(func, "_RF_OriginalScorer", func);
+}
+
+/* compiler the extension was built with, stored in the context of benchmark results */
+#define JW_STRINGIFY_IMPL(x) #x
+#define JW_STRINGIFY(x) JW_STRINGIFY_IMPL(x)
+#if defined(__clang__)
+#    define JW_COMPILER "clang " __clang_version__
+#elif defined(__GNUC__)
+#    define JW_COMPILER "gcc " __VERSION__
+#elif defined(_MSC_VER)
+#    define JW_COMPILER "msvc " JW_STRINGIFY(_MSC_FULL_VER)
+#else
+#    define JW_COMPILER "unknown"
+#endif
+
+static int initialize_cpp_exec(PyObject* module)
+{
+    if (ScorerFunctionType_ready() < 0) return -1;
+    if (ResultBufferType_ready() < 0) return -1;
+    if (MatcherType_ready(&JaroMatcherType, "jarowinkler.JaroMatcher", JaroMatcher_doc, JaroMatcher_new,
+                          JaroMatcher_getset) < 0)
+        return -1;
+    if (MatcherType_ready(&JaroWinklerMatcherType, "jarowinkler.JaroWinklerMatcher", JaroWinklerMatcher_doc,
+                          JaroWinklerMatcher_new, JaroWinklerMatcher_getset) < 0)
+        return -1;
+
+    if (JaroWinklerIndexType_ready() < 0) return -1;
+    if (ProcessorType_ready() < 0) return -1;
+    if (CorpusTypes_ready() < 0) return -1;
+    if (TokenVocabularyType_ready() < 0) return -1;
+    if (ThreadPoolType_ready() < 0) return -1;
+
+    if (add_scorer(module, "jaro_similarity", jaro_similarity_doc, jaro_similarity, &JaroScorer) < 0) return -1;
+    if (add_scorer(module, "jarowinkler_similarity", jarowinkler_similarity_doc, jarowinkler_similarity,
+                   &JaroWinklerScorer) < 0)
+        return -1;
+
+    Py_INCREF(&JaroMatcherType);
+    if (PyModule_AddObject(module, "JaroMatcher", reinterpret_cast<PyObject*>(&JaroMatcherType)) < 0) {
+        Py_DECREF(&JaroMatcherType);
+        return -1;
+    }
+    Py_INCREF(&JaroWinklerMatcherType);
+    if (PyModule_AddObject(module, "JaroWinklerMatcher", reinterpret_cast<PyObject*>(&JaroWinklerMatcherType)) < 0) {
+        Py_DECREF(&JaroWinklerMatcherType);
+        return -1;
+    }
+    Py_INCREF(&JaroWinklerIndexType);
+    if (PyModule_AddObject(module, "JaroWinklerIndex", reinterpret_cast<PyObject*>(&JaroWinklerIndexType)) < 0) {
+        Py_DECREF(&JaroWinklerIndexType);
+        return -1;
+    }
+    Py_INCREF(&ProcessorType);
+    if (PyModule_AddObject(module, "Processor", reinterpret_cast<PyObject*>(&ProcessorType)) < 0) {
+        Py_DECREF(&ProcessorType);
+        return -1;
+    }
+    Py_INCREF(&PreprocessedCorpusType);
+    if (PyModule_AddObject(module, "PreprocessedCorpus", reinterpret_cast<PyObject*>(&PreprocessedCorpusType)) < 0) {
+        Py_DECREF(&PreprocessedCorpusType);
+        return -1;
+    }
+    Py_INCREF(&PreprocessedStringType);
+    if (PyModule_AddObject(module, "PreprocessedString", reinterpret_cast<PyObject*>(&PreprocessedStringType)) < 0) {
+        Py_DECREF(&PreprocessedStringType);
+        return -1;
+    }
+    Py_INCREF(&TokenVocabularyType);
+    if (PyModule_AddObject(module, "TokenVocabulary", reinterpret_cast<PyObject*>(&TokenVocabularyType)) < 0) {
+        Py_DECREF(&TokenVocabularyType);
+        return -1;
+    }
+    Py_INCREF(&ThreadPoolType);
+    if (PyModule_AddObject(module, "ThreadPool", reinterpret_cast<PyObject*>(&ThreadPoolType)) < 0) {
+        Py_DECREF(&ThreadPoolType);
+        return -1;
+    }
+    return PyModule_AddStringConstant(module, "_compiler", JW_COMPILER);
+}
+
+static PyModuleDef_Slot initialize_cpp_slots[] = {
+    {Py_mod_exec, reinterpret_cast<void*>(initialize_cpp_exec)},
+#if PY_VERSION_HEX >= 0x030D0000
+    /* all shared state is immutable after creation, atomic or locked by a CriticalSection */
+    {Py_mod_gil, Py_MOD_GIL_NOT_USED},
+#endif
+    {0, nullptr}};
+
+static struct PyModuleDef initialize_cpp_module = {
+    PyModuleDef_HEAD_INIT,
+    "_initialize_cpp",
+    "C++ implementation of the Jaro and Jaro-Winkler similarity",
+    0,
+    initialize_cpp_methods,
+    initialize_cpp_slots,
+    nullptr,
+    nullptr,
+    nullptr};
+
+PyMODINIT_FUNC PyInit__initialize_cpp(void)
+{
+    return PyModuleDef_Init(&initialize_cpp_module);
+}
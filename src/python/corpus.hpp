@@ -0,0 +1,625 @@
+/* SPDX-License-Identifier: MIT */
+/* Copyright © 2022-present Max Bachmann */
+
+#pragma once
+
+#include "cpp_common.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*
+ * Python classes holding strings, which are preprocessed once. The processed strings of a
+ * corpus are stored in one contiguous arena per character width. The conversion functions
+ * use them in place, so they can be compared repeatedly without running the processor,
+ * converting or allocating them again.
+ */
+
+/* the layout is fixed, so the entries of a corpus file are used in place (see corpus_file.hpp) */
+struct ArenaEntry {
+    uint64_t offset;
+    int64_t length;
+    /* RF_StringType */
+    uint32_t kind;
+    uint32_t none;
+};
+
+/* marks an original string which is None in StringArenaSpans::original_offsets */
+static const uint64_t ORIGINAL_NONE = uint64_t(1) << 63;
+
+/**
+ * @brief memory of an arena, which is used in place instead of being owned by the arena
+ */
+struct StringArenaSpans {
+    const ArenaEntry* entries;
+    size_t size;
+    const uint8_t* chars8;
+    const uint16_t* chars16;
+    const uint32_t* chars32;
+    const uint64_t* chars64;
+    /* size + 1 offsets into originals, which holds the original strings encoded as UTF-8.
+     * Both are nullptr when the original strings are stored in a tuple */
+    const uint64_t* original_offsets;
+    const char* originals;
+};
+
+class StringArena {
+public:
+    StringArena() = default;
+
+    /**
+     * @brief arena using the memory of spans in place. It is kept alive by owner,
+     * e.g. a mapped corpus file
+     */
+    StringArena(std::shared_ptr<const void> owner, const StringArenaSpans& spans)
+        : m_owner(std::move(owner)), m_spans(spans)
+    {}
+
+    void add_none()
+    {
+        m_entries.push_back({0, 0, RF_UINT8, true});
+    }
+
+    void add(const RF_String& str)
+    {
+        ArenaEntry entry = {0, str.length, static_cast<uint32_t>(str.kind), false};
+        entry.offset = visit(str, [&](auto first, auto last) {
+            auto& chars = storage(first);
+            size_t offset = chars.size();
+            chars.insert(chars.end(), first, last);
+            return offset;
+        });
+        m_entries.push_back(entry);
+    }
+
+    /* releases the memory reserved while the arena was growing */
+    void shrink_to_fit()
+    {
+        m_entries.shrink_to_fit();
+        m_chars8.shrink_to_fit();
+        m_chars16.shrink_to_fit();
+        m_chars32.shrink_to_fit();
+        m_chars64.shrink_to_fit();
+    }
+
+    /**
+     * @brief the memory of the arena, which is stored in a corpus file by compile_corpus
+     */
+    StringArenaSpans spans() const
+    {
+        if (m_owner) return m_spans;
+        return {m_entries.data(), m_entries.size(), m_chars8.data(), m_chars16.data(),
+                m_chars32.data(), m_chars64.data(), nullptr, nullptr};
+    }
+
+    size_t size() const
+    {
+        return m_owner ? m_spans.size : m_entries.size();
+    }
+
+    const ArenaEntry& entry(size_t i) const
+    {
+        return m_owner ? m_spans.entries[i] : m_entries[i];
+    }
+
+    const void* data(const ArenaEntry& entry) const
+    {
+        /* a string without data marks None, so empty strings point to a placeholder */
+        static const uint64_t empty = 0;
+        if (!entry.length) return &empty;
+
+        switch (entry.kind) {
+        case RF_UINT8: return (m_owner ? m_spans.chars8 : m_chars8.data()) + entry.offset;
+        case RF_UINT16: return (m_owner ? m_spans.chars16 : m_chars16.data()) + entry.offset;
+        case RF_UINT32: return (m_owner ? m_spans.chars32 : m_chars32.data()) + entry.offset;
+        default: return (m_owner ? m_spans.chars64 : m_chars64.data()) + entry.offset;
+        }
+    }
+
+    /**
+     * @brief string pointing into the arena. It holds a reference to owner, which has to own the arena
+     */
+    RF_StringWrapper view(size_t i, PyObject* owner) const
+    {
+        const ArenaEntry& str = entry(i);
+        if (str.none) return RF_StringWrapper();
+
+        /* the strings are never modified, RF_String just does not use a const pointer */
+        RF_String string = {nullptr, static_cast<RF_StringType>(str.kind), const_cast<void*>(data(str)),
+                            str.length, nullptr};
+        return RF_StringWrapper(string, PyObjectRef::borrow(owner));
+    }
+
+    /* whether the original strings are stored in the arena instead of a tuple */
+    bool has_originals() const
+    {
+        return m_owner && m_spans.originals;
+    }
+
+    /**
+     * @brief decodes the original string i. Returns a new reference or nullptr with a Python exception set
+     */
+    PyObject* original(size_t i) const
+    {
+        uint64_t start = m_spans.original_offsets[i];
+        if (start & ORIGINAL_NONE) Py_RETURN_NONE;
+
+        uint64_t end = m_spans.original_offsets[i + 1] & ~ORIGINAL_NONE;
+        return PyUnicode_DecodeUTF8(m_spans.originals + start, static_cast<Py_ssize_t>(end - start),
+                                    "surrogatepass");
+    }
+
+private:
+    std::vector<uint8_t>& storage(const uint8_t*)
+    {
+        return m_chars8;
+    }
+    std::vector<uint16_t>& storage(const uint16_t*)
+    {
+        return m_chars16;
+    }
+    std::vector<uint32_t>& storage(const uint32_t*)
+    {
+        return m_chars32;
+    }
+    std::vector<uint64_t>& storage(const uint64_t*)
+    {
+        return m_chars64;
+    }
+
+    std::vector<ArenaEntry> m_entries;
+    std::vector<uint8_t> m_chars8;
+    std::vector<uint16_t> m_chars16;
+    std::vector<uint32_t> m_chars32;
+    std::vector<uint64_t> m_chars64;
+
+    std::shared_ptr<const void> m_owner;
+    StringArenaSpans m_spans = {};
+};
+
+struct PreprocessedCorpus {
+    PyObject_HEAD
+    StringArena* arena;
+    /* tuple of the strings before preprocessing. It is created on first use when
+     * they are stored in the arena of a corpus loaded by load_corpus */
+    PyObject* strings;
+    PyObject* processor;
+};
+
+struct PreprocessedString {
+    PyObject_HEAD
+    PyObject* corpus;
+    Py_ssize_t index;
+};
+
+/* element of a processed sequence of hashables, which is only known by its hash. hash() returns
+ * the stored hash, so conv_sequence and rapidfuzz, which both hash such elements, see the same
+ * value as for the original element */
+struct HashedElement {
+    PyObject_HEAD
+    Py_hash_t hash;
+};
+
+/* corpora encoded by a TokenVocabulary (see vocabulary.hpp) store token ids and use the
+ * vocabulary as processor, so their elements are returned as the tokens */
+struct TokenVocabulary {
+    PyObject_HEAD
+    /* dict mapping the tokens to their id */
+    PyObject* ids;
+    /* list of the tokens indexed by their id */
+    PyObject* tokens;
+};
+
+/* the slots are filled in CorpusTypes_ready, since the layout of
+ * PyTypeObject differs between Python versions */
+#if defined(__GNUC__)
+#    pragma GCC diagnostic push
+#    pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+#endif
+static PyTypeObject PreprocessedCorpusType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+static PyTypeObject PreprocessedStringType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+static PyTypeObject TokenVocabularyType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+static PyTypeObject HashedElementType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+static PySequenceMethods PreprocessedCorpus_as_sequence = {};
+static PySequenceMethods PreprocessedString_as_sequence = {};
+#if defined(__GNUC__)
+#    pragma GCC diagnostic pop
+#endif
+
+static inline PreprocessedCorpus* get_corpus(PyObject* obj)
+{
+    if (!PyObject_TypeCheck(obj, &PreprocessedCorpusType)) return nullptr;
+    return reinterpret_cast<PreprocessedCorpus*>(obj);
+}
+
+/**
+ * @brief converts an element of a PreprocessedCorpus without copying it
+ *
+ * @return false when obj is no such element
+ */
+static inline bool conv_preprocessed_string(PyObject* obj, RF_StringWrapper& str)
+{
+    if (!PyObject_TypeCheck(obj, &PreprocessedStringType)) return false;
+
+    PreprocessedString* self = reinterpret_cast<PreprocessedString*>(obj);
+    PreprocessedCorpus* corpus = reinterpret_cast<PreprocessedCorpus*>(self->corpus);
+    str = corpus->arena->view(static_cast<size_t>(self->index), self->corpus);
+    return true;
+}
+
+/**
+ * @brief converts all strings of a PreprocessedCorpus without copying them
+ *
+ * @return false when obj is no PreprocessedCorpus
+ */
+static inline bool conv_preprocessed_corpus(PyObject* obj, std::vector<RF_StringWrapper>& strings)
+{
+    PreprocessedCorpus* corpus = get_corpus(obj);
+    if (!corpus) return false;
+
+    strings.reserve(corpus->arena->size());
+    for (size_t i = 0; i < corpus->arena->size(); ++i)
+        strings.push_back(corpus->arena->view(i, obj));
+    return true;
+}
+
+/**
+ * @brief the tuple of the original strings of a PreprocessedCorpus. Returns a new reference or
+ * nullptr with a Python exception set
+ */
+static PyObject* PreprocessedCorpus_strings(PreprocessedCorpus* corpus)
+{
+    CriticalSection section(reinterpret_cast<PyObject*>(corpus));
+    if (!corpus->strings) {
+        Py_ssize_t size = static_cast<Py_ssize_t>(corpus->arena->size());
+        PyObjectRef strings(PyTuple_New(size));
+        if (!strings) return nullptr;
+
+        for (Py_ssize_t i = 0; i < size; ++i) {
+            PyObject* original = corpus->arena->original(static_cast<size_t>(i));
+            if (!original) return nullptr;
+            PyTuple_SET_ITEM(strings.get(), i, original);
+        }
+        /* decoding can run other threads, which might have created the tuple in between */
+        if (!corpus->strings) corpus->strings = strings.release();
+    }
+    Py_INCREF(corpus->strings);
+    return corpus->strings;
+}
+
+/**
+ * @brief the original strings of a PreprocessedCorpus or a tuple copy of any other sequence.
+ * A corpus storing the original strings in its arena is returned itself, so only the
+ * strings which are returned are decoded. Use choices_size and choice_item to access them.
+ */
+static inline PyObjectRef choices_tuple(PyObject* obj)
+{
+    if (PreprocessedCorpus* corpus = get_corpus(obj)) {
+        if (corpus->arena->has_originals()) return PyObjectRef::borrow(obj);
+
+        PyObjectRef strings(PreprocessedCorpus_strings(corpus));
+        if (!strings) throw PythonError();
+        return strings;
+    }
+
+    PyObjectRef tuple(PySequence_Tuple(obj));
+    if (!tuple) throw PythonError();
+    return tuple;
+}
+
+static inline size_t choices_size(PyObject* choices)
+{
+    if (PreprocessedCorpus* corpus = get_corpus(choices)) return corpus->arena->size();
+    return static_cast<size_t>(PyTuple_GET_SIZE(choices));
+}
+
+/**
+ * @brief original string i of a result of choices_tuple
+ */
+static inline PyObjectRef choice_item(PyObject* choices, size_t i)
+{
+    if (PreprocessedCorpus* corpus = get_corpus(choices)) {
+        PyObjectRef original(corpus->arena->original(i));
+        if (!original) throw PythonError();
+        return original;
+    }
+    return PyObjectRef::borrow(PyTuple_GET_ITEM(choices, static_cast<Py_ssize_t>(i)));
+}
+
+/**
+ * @brief creates a PreprocessedCorpus taking ownership of arena. strings can be nullptr when
+ * the original strings are stored in the arena. Returns a new reference or nullptr with a
+ * Python exception set
+ */
+static PyObject* PreprocessedCorpus_create(PyObject* strings, PyObject* processor,
+                                           std::unique_ptr<StringArena> arena)
+{
+    PyObject* obj = PreprocessedCorpusType.tp_alloc(&PreprocessedCorpusType, 0);
+    if (!obj) return nullptr;
+
+    PreprocessedCorpus* self = reinterpret_cast<PreprocessedCorpus*>(obj);
+    arena->shrink_to_fit();
+    self->arena = arena.release();
+    Py_XINCREF(strings);
+    self->strings = strings;
+    Py_INCREF(processor);
+    self->processor = processor;
+    return obj;
+}
+
+static Py_ssize_t PreprocessedCorpus_length(PyObject* self)
+{
+    return static_cast<Py_ssize_t>(reinterpret_cast<PreprocessedCorpus*>(self)->arena->size());
+}
+
+static PyObject* PreprocessedCorpus_item(PyObject* self, Py_ssize_t i)
+{
+    if (i < 0 || i >= PreprocessedCorpus_length(self)) {
+        PyErr_SetString(PyExc_IndexError, "PreprocessedCorpus index out of range");
+        return nullptr;
+    }
+    if (reinterpret_cast<PreprocessedCorpus*>(self)->arena->entry(static_cast<size_t>(i)).none) Py_RETURN_NONE;
+
+    PyObject* obj = PreprocessedStringType.tp_alloc(&PreprocessedStringType, 0);
+    if (!obj) return nullptr;
+
+    PreprocessedString* str = reinterpret_cast<PreprocessedString*>(obj);
+    Py_INCREF(self);
+    str->corpus = self;
+    str->index = i;
+    return obj;
+}
+
+static int PreprocessedCorpus_traverse(PyObject* self, visitproc visit, void* arg)
+{
+    Py_VISIT(reinterpret_cast<PreprocessedCorpus*>(self)->strings);
+    Py_VISIT(reinterpret_cast<PreprocessedCorpus*>(self)->processor);
+    return 0;
+}
+
+static int PreprocessedCorpus_clear(PyObject* self)
+{
+    Py_CLEAR(reinterpret_cast<PreprocessedCorpus*>(self)->strings);
+    Py_CLEAR(reinterpret_cast<PreprocessedCorpus*>(self)->processor);
+    return 0;
+}
+
+static void PreprocessedCorpus_dealloc(PyObject* self)
+{
+    PyObject_GC_UnTrack(self);
+    delete reinterpret_cast<PreprocessedCorpus*>(self)->arena;
+    PreprocessedCorpus_clear(self);
+    Py_TYPE(self)->tp_free(self);
+}
+
+static PyObject* PreprocessedCorpus_repr(PyObject* self)
+{
+    return PyUnicode_FromFormat("<PreprocessedCorpus of %zd strings>", PreprocessedCorpus_length(self));
+}
+
+static PyObject* PreprocessedCorpus_get_strings(PyObject* self, void*)
+{
+    return PreprocessedCorpus_strings(reinterpret_cast<PreprocessedCorpus*>(self));
+}
+
+static PyObject* PreprocessedCorpus_get_processor(PyObject* self, void*)
+{
+    PyObject* processor = reinterpret_cast<PreprocessedCorpus*>(self)->processor;
+    Py_INCREF(processor);
+    return processor;
+}
+
+static PyGetSetDef PreprocessedCorpus_getset[] = {
+    {"strings", PreprocessedCorpus_get_strings, nullptr, "tuple of the strings before preprocessing", nullptr},
+    {"processor", PreprocessedCorpus_get_processor, nullptr, "processor applied to the strings", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}};
+
+static const StringArena& PreprocessedString_arena(PyObject* self)
+{
+    return *reinterpret_cast<PreprocessedCorpus*>(reinterpret_cast<PreprocessedString*>(self)->corpus)->arena;
+}
+
+static TokenVocabulary* PreprocessedString_vocabulary(PyObject* self)
+{
+    PyObject* processor =
+        reinterpret_cast<PreprocessedCorpus*>(reinterpret_cast<PreprocessedString*>(self)->corpus)->processor;
+    if (!PyObject_TypeCheck(processor, &TokenVocabularyType)) return nullptr;
+    return reinterpret_cast<TokenVocabulary*>(processor);
+}
+
+static const ArenaEntry& PreprocessedString_entry(PyObject* self)
+{
+    Py_ssize_t index = reinterpret_cast<PreprocessedString*>(self)->index;
+    return PreprocessedString_arena(self).entry(static_cast<size_t>(index));
+}
+
+static Py_ssize_t PreprocessedString_length(PyObject* self)
+{
+    return static_cast<Py_ssize_t>(PreprocessedString_entry(self).length);
+}
+
+static Py_hash_t HashedElement_hash(PyObject* self)
+{
+    return reinterpret_cast<HashedElement*>(self)->hash;
+}
+
+static PyObject* HashedElement_richcompare(PyObject* self, PyObject* other, int op)
+{
+    if (!PyObject_TypeCheck(other, &HashedElementType) || (op != Py_EQ && op != Py_NE)) Py_RETURN_NOTIMPLEMENTED;
+
+    bool equal = reinterpret_cast<HashedElement*>(self)->hash == reinterpret_cast<HashedElement*>(other)->hash;
+    return PyBool_FromLong((op == Py_EQ) == equal);
+}
+
+static PyObject* HashedElement_repr(PyObject* self)
+{
+    /* the same as the int of the hash, so str() of a PreprocessedString is not affected */
+    return PyUnicode_FromFormat("%zd", reinterpret_cast<HashedElement*>(self)->hash);
+}
+
+/**
+ * @brief element of a sequence of hashables stored as value by conv_element. Integers, which are
+ * their own hash, are returned as int. Other values are the hash of the original element, which is
+ * kept by a HashedElement, since an int of that value would be hashed to a different value
+ */
+static PyObject* element_from_hash(uint64_t value)
+{
+    int64_t signed_value = static_cast<int64_t>(value);
+    /* modulus of the hash of int */
+    const int64_t modulus = (sizeof(Py_hash_t) >= 8) ? (INT64_C(1) << 61) - 1 : (INT64_C(1) << 31) - 1;
+    Py_hash_t hash = static_cast<Py_hash_t>(signed_value);
+    if ((signed_value > -modulus && signed_value < modulus) || hash != signed_value)
+        return PyLong_FromLongLong(signed_value);
+
+    HashedElement* element = PyObject_New(HashedElement, &HashedElementType);
+    if (!element) return nullptr;
+    element->hash = hash;
+    return reinterpret_cast<PyObject*>(element);
+}
+
+/* characters are returned as str of length 1, token ids as their token and elements of
+ * other sequences as returned by element_from_hash */
+static PyObject* PreprocessedString_item(PyObject* self, Py_ssize_t i)
+{
+    const ArenaEntry& entry = PreprocessedString_entry(self);
+    if (i < 0 || i >= entry.length) {
+        PyErr_SetString(PyExc_IndexError, "PreprocessedString index out of range");
+        return nullptr;
+    }
+
+    const void* data = PreprocessedString_arena(self).data(entry);
+    uint64_t value;
+    switch (entry.kind) {
+    case RF_UINT8: value = static_cast<const uint8_t*>(data)[i]; break;
+    case RF_UINT16: value = static_cast<const uint16_t*>(data)[i]; break;
+    case RF_UINT32: value = static_cast<const uint32_t*>(data)[i]; break;
+    default: value = static_cast<const uint64_t*>(data)[i]; break;
+    }
+
+    TokenVocabulary* vocabulary = PreprocessedString_vocabulary(self);
+    if (vocabulary && vocabulary->tokens) {
+        CriticalSection section(reinterpret_cast<PyObject*>(vocabulary));
+        PyObject* token = PyList_GET_ITEM(vocabulary->tokens, static_cast<Py_ssize_t>(value));
+        Py_INCREF(token);
+        return token;
+    }
+    if (entry.kind == RF_UINT64) return element_from_hash(value);
+    return PyUnicode_FromOrdinal(static_cast<int>(value));
+}
+
+static int PreprocessedString_traverse(PyObject* self, visitproc visit, void* arg)
+{
+    Py_VISIT(reinterpret_cast<PreprocessedString*>(self)->corpus);
+    return 0;
+}
+
+static int PreprocessedString_clear(PyObject* self)
+{
+    Py_CLEAR(reinterpret_cast<PreprocessedString*>(self)->corpus);
+    return 0;
+}
+
+static void PreprocessedString_dealloc(PyObject* self)
+{
+    PyObject_GC_UnTrack(self);
+    PreprocessedString_clear(self);
+    Py_TYPE(self)->tp_free(self);
+}
+
+/* the processed string, or the list of its elements when it was no str */
+static PyObject* PreprocessedString_str(PyObject* self)
+{
+    const ArenaEntry& entry = PreprocessedString_entry(self);
+    if (entry.kind == RF_UINT64 || PreprocessedString_vocabulary(self)) {
+        PyObjectRef elements(PySequence_List(self));
+        return elements ? PyObject_Str(elements.get()) : nullptr;
+    }
+
+    int kind = (entry.kind == RF_UINT8) ? PyUnicode_1BYTE_KIND
+               : (entry.kind == RF_UINT16) ? PyUnicode_2BYTE_KIND
+                                           : PyUnicode_4BYTE_KIND;
+    return PyUnicode_FromKindAndData(kind, PreprocessedString_arena(self).data(entry),
+                                     static_cast<Py_ssize_t>(entry.length));
+}
+
+static PyObject* PreprocessedString_repr(PyObject* self)
+{
+    PyObjectRef str(PreprocessedString_str(self));
+    if (!str) return nullptr;
+    return PyUnicode_FromFormat("PreprocessedString(%R)", str.get());
+}
+
+static PyObject* PreprocessedString_get_original(PyObject* self, void*)
+{
+    PreprocessedString* str = reinterpret_cast<PreprocessedString*>(self);
+    PreprocessedCorpus* corpus = reinterpret_cast<PreprocessedCorpus*>(str->corpus);
+    if (corpus->arena->has_originals()) return corpus->arena->original(static_cast<size_t>(str->index));
+
+    PyObject* original = PyTuple_GET_ITEM(corpus->strings, str->index);
+    Py_INCREF(original);
+    return original;
+}
+
+static PyGetSetDef PreprocessedString_getset[] = {
+    {"original", PreprocessedString_get_original, nullptr, "string before preprocessing", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}};
+
+PyDoc_STRVAR(PreprocessedCorpus_doc, R"(Strings preprocessed by ``preprocess``, ``load_corpus`` or a ``TokenVocabulary``
+
+The processed strings are stored in one contiguous native buffer. The corpus can be passed
+as choices or queries and its elements as strings to all functions of this module.
+They are used without running the processor or converting them again, so any
+processor passed together with them is ignored.
+)");
+
+PyDoc_STRVAR(PreprocessedString_doc, R"(Element of a ``PreprocessedCorpus``
+
+``str()`` returns the processed string and ``original`` the string before preprocessing.
+Elements of sequences of hashables are returned as their hash, either as int or, when
+hashing an int of that value would change it, as an element whose ``hash()`` is that value.
+)");
+
+static int CorpusTypes_ready()
+{
+    PyTypeObject* type = &PreprocessedCorpusType;
+    type->tp_name = "jarowinkler.PreprocessedCorpus";
+    type->tp_doc = PreprocessedCorpus_doc;
+    type->tp_basicsize = sizeof(PreprocessedCorpus);
+    type->tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC;
+    type->tp_traverse = PreprocessedCorpus_traverse;
+    type->tp_clear = PreprocessedCorpus_clear;
+    type->tp_dealloc = PreprocessedCorpus_dealloc;
+    type->tp_repr = PreprocessedCorpus_repr;
+    type->tp_getset = PreprocessedCorpus_getset;
+    PreprocessedCorpus_as_sequence.sq_length = PreprocessedCorpus_length;
+    PreprocessedCorpus_as_sequence.sq_item = PreprocessedCorpus_item;
+    type->tp_as_sequence = &PreprocessedCorpus_as_sequence;
+    if (PyType_Ready(type) < 0) return -1;
+
+    type = &PreprocessedStringType;
+    type->tp_name = "jarowinkler.PreprocessedString";
+    type->tp_doc = PreprocessedString_doc;
+    type->tp_basicsize = sizeof(PreprocessedString);
+    type->tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC;
+    type->tp_traverse = PreprocessedString_traverse;
+    type->tp_clear = PreprocessedString_clear;
+    type->tp_dealloc = PreprocessedString_dealloc;
+    type->tp_repr = PreprocessedString_repr;
+    type->tp_str = PreprocessedString_str;
+    type->tp_getset = PreprocessedString_getset;
+    PreprocessedString_as_sequence.sq_length = PreprocessedString_length;
+    PreprocessedString_as_sequence.sq_item = PreprocessedString_item;
+    type->tp_as_sequence = &PreprocessedString_as_sequence;
+    if (PyType_Ready(type) < 0) return -1;
+
+    type = &HashedElementType;
+    type->tp_name = "jarowinkler.HashedElement";
+    type->tp_doc = "element of a PreprocessedString, which is only known by its hash";
+    type->tp_basicsize = sizeof(HashedElement);
+    type->tp_flags = Py_TPFLAGS_DEFAULT;
+    type->tp_hash = HashedElement_hash;
+    type->tp_richcompare = HashedElement_richcompare;
+    type->tp_repr = HashedElement_repr;
+    return PyType_Ready(type);
+}
@@ -0,0 +1,598 @@
+/* SPDX-License-Identifier: MIT */
+/* Copyright © 2022-present Max Bachmann */
+
+#pragma once
+
+#include "corpus.hpp"
+#include "cpp_common.hpp"
+#include "processor.hpp"
+#include "scorer_function.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+/*
+ * Corpus files written by compile_corpus and loaded by load_corpus. They hold the arena of a
+ * PreprocessedCorpus together with the original strings in a flat layout, which is used in
+ * place after mapping the file. Processes loading the same file share it through the page cache.
+ *
+ * The file starts with a header, which is padded to CORPUS_FILE_ALIGNMENT, followed by the
+ * sections listed in it. Every section starts at a multiple of CORPUS_FILE_ALIGNMENT:
+ *   entries            ArenaEntry of every string
+ *   chars8 ... chars64 characters of the processed strings by their width
+ *   original_offsets   count + 1 offsets into originals, ORIGINAL_NONE marks None
+ *   originals          original strings encoded as UTF-8
+ * All integers use the byte order of the machine writing the file, which is checked on load.
+ */
+
+static const char CORPUS_FILE_MAGIC[8] = {'J', 'W', 'C', 'O', 'R', 'P', 'U', 'S'};
+static const uint32_t CORPUS_FILE_VERSION = 1;
+static const uint32_t CORPUS_FILE_BYTE_ORDER = 0x01020304;
+static const uint64_t CORPUS_FILE_ALIGNMENT = 4096;
+
+enum CorpusFileSection {
+    SECTION_ENTRIES,
+    SECTION_CHARS8,
+    SECTION_CHARS16,
+    SECTION_CHARS32,
+    SECTION_CHARS64,
+    SECTION_ORIGINAL_OFFSETS,
+    SECTION_ORIGINALS,
+    SECTION_COUNT
+};
+
+/* processor of the strings, only native processors are restored by load_corpus */
+enum CorpusFileProcessor : uint32_t {
+    CORPUS_PROCESSOR_NONE,
+    CORPUS_PROCESSOR_NATIVE,
+    CORPUS_PROCESSOR_CALLABLE
+};
+
+struct CorpusFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t count;
+    uint32_t processor;
+    uint32_t processor_flags;
+    struct {
+        uint64_t offset;
+        uint64_t size;
+    } sections[SECTION_COUNT];
+};
+
+static_assert(sizeof(ArenaEntry) == 24, "ArenaEntry is part of the corpus file format");
+static_assert(sizeof(CorpusFileHeader) <= CORPUS_FILE_ALIGNMENT, "the header has to fit into the first page");
+
+/**
+ * @brief path passed to compile_corpus or load_corpus in the encoding of the file system
+ */
+class CorpusFilePath {
+public:
+    explicit CorpusFilePath(PyObject* path)
+    {
+#ifdef _WIN32
+        PyObject* decoded = nullptr;
+        if (!PyUnicode_FSDecoder(path, &decoded)) throw PythonError();
+        m_path = PyObjectRef(decoded);
+
+        wchar_t* native = PyUnicode_AsWideCharString(decoded, nullptr);
+        if (!native) throw PythonError();
+        m_native = native;
+        PyMem_Free(native);
+#else
+        PyObject* encoded = nullptr;
+        if (!PyUnicode_FSConverter(path, &encoded)) throw PythonError();
+        m_path = PyObjectRef(encoded);
+        m_native = PyBytes_AS_STRING(encoded);
+#endif
+    }
+
+#ifdef _WIN32
+    using NativePath = std::wstring;
+#else
+    using NativePath = std::string;
+#endif
+
+    const NativePath& native() const
+    {
+        return m_native;
+    }
+
+    /**
+     * @brief sets an OSError for the file from errno (or GetLastError on Windows when windows_error is set)
+     */
+    PythonError error(int errnum, bool windows_error = false) const
+    {
+#ifdef _WIN32
+        if (windows_error) {
+            PyErr_SetExcFromWindowsErrWithFilenameObject(PyExc_OSError, static_cast<int>(errnum), m_path.get());
+            return PythonError();
+        }
+#else
+        (void)windows_error;
+#endif
+        errno = errnum;
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, m_path.get());
+        return PythonError();
+    }
+
+private:
+    PyObjectRef m_path;
+    NativePath m_native;
+};
+
+/**
+ * @brief read-only bytes of a corpus file, which are either mapped or read into memory
+ */
+class CorpusFileBuffer {
+public:
+    CorpusFileBuffer(const CorpusFileBuffer&) = delete;
+    CorpusFileBuffer& operator=(const CorpusFileBuffer&) = delete;
+
+    ~CorpusFileBuffer()
+    {
+        if (!m_mapped) return;
+#ifdef _WIN32
+        UnmapViewOfFile(m_data);
+#else
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+    }
+
+    static std::shared_ptr<CorpusFileBuffer> map(const CorpusFilePath& path)
+    {
+        std::shared_ptr<CorpusFileBuffer> buffer(new CorpusFileBuffer());
+        int errnum = 0;
+        bool windows_error = false;
+        {
+            GilRelease gil;
+            errnum = buffer->map_file(path, windows_error);
+        }
+        if (errnum) throw path.error(errnum, windows_error);
+        return buffer;
+    }
+
+    static std::shared_ptr<CorpusFileBuffer> read(const CorpusFilePath& path)
+    {
+        std::shared_ptr<CorpusFileBuffer> buffer(new CorpusFileBuffer());
+        int errnum = 0;
+        {
+            GilRelease gil;
+            errnum = buffer->read_file(path);
+        }
+        if (errnum) throw path.error(errnum);
+        return buffer;
+    }
+
+    const uint8_t* data() const
+    {
+        return m_data;
+    }
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+private:
+    CorpusFileBuffer() = default;
+
+#ifdef _WIN32
+    int map_file(const CorpusFilePath& path, bool& windows_error)
+    {
+        windows_error = true;
+        HANDLE file = CreateFileW(path.native().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return static_cast<int>(GetLastError());
+
+        LARGE_INTEGER size;
+        HANDLE mapping = nullptr;
+        int errnum = 0;
+        if (!GetFileSizeEx(file, &size) ||
+            !(mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr)))
+            errnum = static_cast<int>(GetLastError());
+        else if (!(m_data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0))))
+            errnum = static_cast<int>(GetLastError());
+
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        if (errnum) return errnum;
+
+        m_size = static_cast<size_t>(size.QuadPart);
+        m_mapped = true;
+        return 0;
+    }
+
+    int read_file(const CorpusFilePath& path)
+    {
+        FILE* file = _wfopen(path.native().c_str(), L"rb");
+        if (!file) return errno;
+
+        struct _stat64 info;
+        int errnum = (_fstat64(_fileno(file), &info) < 0) ? errno : read_contents(file, info.st_size);
+        fclose(file);
+        return errnum;
+    }
+#else
+    int map_file(const CorpusFilePath& path, bool&)
+    {
+        int fd = open(path.native().c_str(), O_RDONLY);
+        if (fd < 0) return errno;
+
+        struct stat info;
+        int errnum = 0;
+        if (fstat(fd, &info) < 0) {
+            errnum = errno;
+        }
+        else if (info.st_size > 0) {
+            void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+            if (data == MAP_FAILED) {
+                errnum = errno;
+            }
+            else {
+                m_data = static_cast<const uint8_t*>(data);
+                m_size = static_cast<size_t>(info.st_size);
+                m_mapped = true;
+            }
+        }
+        close(fd);
+        return errnum;
+    }
+
+    int read_file(const CorpusFilePath& path)
+    {
+        FILE* file = fopen(path.native().c_str(), "rb");
+        if (!file) return errno;
+
+        struct stat info;
+        int errnum = (fstat(fileno(file), &info) < 0) ? errno : read_contents(file, info.st_size);
+        fclose(file);
+        return errnum;
+    }
+#endif
+
+    int read_contents(FILE* file, int64_t size)
+    {
+        /* uint64_t keeps the sections aligned for all of their types */
+        m_storage.resize((static_cast<size_t>(size) + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+        m_data = reinterpret_cast<const uint8_t*>(m_storage.data());
+        m_size = static_cast<size_t>(size);
+        if (std::fread(m_storage.data(), 1, m_size, file) != m_size) return ferror(file) ? errno : EIO;
+        return 0;
+    }
+
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    bool m_mapped = false;
+    std::vector<uint64_t> m_storage;
+};
+
+/**
+ * @brief checks the header and the sections of a corpus file and returns the spans of its arena
+ */
+static inline StringArenaSpans corpus_file_spans(const CorpusFileBuffer& buffer, CorpusFileHeader& header)
+{
+    if (buffer.size() < CORPUS_FILE_ALIGNMENT) throw std::invalid_argument("corpus file is truncated");
+    std::memcpy(&header, buffer.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, CORPUS_FILE_MAGIC, sizeof(CORPUS_FILE_MAGIC)) != 0)
+        throw std::invalid_argument("file is no corpus file written by compile_corpus");
+    if (header.byte_order != CORPUS_FILE_BYTE_ORDER)
+        throw std::invalid_argument("corpus file was written on a machine with a different byte order");
+    if (header.version != CORPUS_FILE_VERSION)
+        throw std::invalid_argument("corpus file version " + std::to_string(header.version) +
+                                    " is not supported, it has to be compiled again");
+
+    static const size_t element_size[SECTION_COUNT] = {sizeof(ArenaEntry), 1, 2, 4, 8, 8, 1};
+    const void* sections[SECTION_COUNT];
+    for (size_t i = 0; i < SECTION_COUNT; ++i) {
+        uint64_t offset = header.sections[i].offset;
+        uint64_t size = header.sections[i].size;
+        if (offset % CORPUS_FILE_ALIGNMENT || size % element_size[i] || offset > buffer.size() ||
+            size > buffer.size() - offset)
+            throw std::invalid_argument("corpus file is truncated or corrupted");
+        sections[i] = buffer.data() + offset;
+    }
+    if (header.count > SIZE_MAX / sizeof(ArenaEntry) ||
+        header.sections[SECTION_ENTRIES].size != header.count * sizeof(ArenaEntry) ||
+        header.sections[SECTION_ORIGINAL_OFFSETS].size != (header.count + 1) * sizeof(uint64_t))
+        throw std::invalid_argument("corpus file is truncated or corrupted");
+
+    StringArenaSpans spans;
+    spans.entries = static_cast<const ArenaEntry*>(sections[SECTION_ENTRIES]);
+    spans.size = static_cast<size_t>(header.count);
+    spans.chars8 = static_cast<const uint8_t*>(sections[SECTION_CHARS8]);
+    spans.chars16 = static_cast<const uint16_t*>(sections[SECTION_CHARS16]);
+    spans.chars32 = static_cast<const uint32_t*>(sections[SECTION_CHARS32]);
+    spans.chars64 = static_cast<const uint64_t*>(sections[SECTION_CHARS64]);
+    spans.original_offsets = static_cast<const uint64_t*>(sections[SECTION_ORIGINAL_OFFSETS]);
+    spans.originals = static_cast<const char*>(sections[SECTION_ORIGINALS]);
+
+    /* the strings are used without further checks, so every entry is checked once. This only
+     * reads the entries and offsets, the characters are not touched until they are compared */
+    uint64_t char_count[4];
+    for (size_t kind = 0; kind < 4; ++kind)
+        char_count[kind] = header.sections[SECTION_CHARS8 + kind].size >> kind;
+
+    uint64_t original_end = 0;
+    for (size_t i = 0; i < spans.size; ++i) {
+        const ArenaEntry& entry = spans.entries[i];
+        if (entry.kind > RF_UINT64 || entry.none > 1 || entry.length < 0 ||
+            entry.offset > char_count[entry.kind] ||
+            static_cast<uint64_t>(entry.length) > char_count[entry.kind] - entry.offset)
+            throw std::invalid_argument("corpus file is truncated or corrupted");
+
+        uint64_t start = spans.original_offsets[i] & ~ORIGINAL_NONE;
+        if (start != original_end) throw std::invalid_argument("corpus file is truncated or corrupted");
+        original_end = spans.original_offsets[i + 1] & ~ORIGINAL_NONE;
+        if (original_end < start) throw std::invalid_argument("corpus file is truncated or corrupted");
+    }
+    if (original_end > header.sections[SECTION_ORIGINALS].size)
+        throw std::invalid_argument("corpus file is truncated or corrupted");
+    return spans;
+}
+
+/**
+ * @brief writes the sections into a temporary file, which replaces path once it is complete
+ *
+ * @return 0 or the errno of the failed operation
+ */
+static inline int write_corpus_file(const CorpusFilePath& path, const CorpusFileHeader& header,
+                                    const void* const* sections)
+{
+    CorpusFilePath::NativePath temp_path = path.native();
+#ifdef _WIN32
+    temp_path += L".tmp";
+    FILE* file = _wfopen(temp_path.c_str(), L"wb");
+#else
+    temp_path += ".tmp";
+    FILE* file = fopen(temp_path.c_str(), "wb");
+#endif
+    if (!file) return errno;
+
+    static const char padding[CORPUS_FILE_ALIGNMENT] = {};
+    uint64_t position = 0;
+    auto write = [&](const void* data, uint64_t size) {
+        if (size && std::fwrite(data, 1, static_cast<size_t>(size), file) != size) return false;
+        position += size;
+        return true;
+    };
+    auto align = [&]() {
+        return write(padding, (CORPUS_FILE_ALIGNMENT - position % CORPUS_FILE_ALIGNMENT) % CORPUS_FILE_ALIGNMENT);
+    };
+
+    bool ok = write(&header, sizeof(header)) && align();
+    for (size_t i = 0; ok && i < SECTION_COUNT; ++i)
+        ok = write(sections[i], header.sections[i].size) && align();
+
+    int errnum = ok ? 0 : (errno ? errno : EIO);
+    if (std::fclose(file) != 0 && !errnum) errnum = errno;
+#ifdef _WIN32
+    if (!errnum && !MoveFileExW(temp_path.c_str(), path.native().c_str(), MOVEFILE_REPLACE_EXISTING))
+        errnum = EACCES;
+    if (errnum) _wremove(temp_path.c_str());
+#else
+    if (!errnum && std::rename(temp_path.c_str(), path.native().c_str()) != 0) errnum = errno;
+    if (errnum) std::remove(temp_path.c_str());
+#endif
+    return errnum;
+}
+
+PyDoc_STRVAR(compile_corpus_doc, R"(compile_corpus(strings, path, processor=None)
+--
+
+Preprocesses the strings like ``preprocess`` and writes them into a corpus file,
+which is loaded by ``load_corpus``. The file holds the processed strings, their
+lengths and the original strings in a flat, versioned layout. Every section starts
+at a page boundary, so the file is used in place after mapping it.
+
+The file is written next to path first and replaces it once it is complete.
+Processes which still map the old file keep using it.
+
+Parameters
+----------
+strings : Sequence[str | None] | PreprocessedCorpus
+    Strings to store. A PreprocessedCorpus is stored without processing it again.
+processor: callable, optional
+    Optional callable that is used to preprocess the strings. Default is None,
+    which only converts the strings.
+
+Raises
+------
+TypeError
+    If strings contains elements which are neither str nor None, or if it is a
+    corpus encoded by a TokenVocabulary
+OSError
+    If the file can not be written
+)");
+
+static PyObject* compile_corpus(PyObject* /*self*/, PyObject* const* args, Py_ssize_t nargs, PyObject* kwnames)
+{
+    static const char* const names[] = {"strings", "path", "processor"};
+    static const ArgParser parser = {"compile_corpus", names, 3, 3, 2};
+    PyObject* argv[3];
+    if (parse_args(parser, args, nargs, kwnames, argv) < 0) return nullptr;
+
+    try {
+        CorpusFilePath path(argv[1]);
+        PyObject* processor = argv[2] ? argv[2] : Py_None;
+
+        /* the strings are preprocessed unless they are passed as a corpus */
+        PreprocessedCorpus* corpus = get_corpus(argv[0]);
+        std::unique_ptr<StringArena> owned_arena;
+        PyObjectRef strings;
+        if (corpus) {
+            if (PyObject_TypeCheck(corpus->processor, &TokenVocabularyType)) {
+                PyErr_SetString(PyExc_TypeError, "corpora encoded by a TokenVocabulary can not be compiled");
+                throw PythonError();
+            }
+            processor = corpus->processor;
+            strings = PyObjectRef(PreprocessedCorpus_strings(corpus));
+            if (!strings) throw PythonError();
+        }
+        else {
+            strings = PyObjectRef(PySequence_Tuple(argv[0]));
+            if (!strings) throw PythonError();
+
+            owned_arena.reset(new StringArena());
+            for (const RF_StringWrapper& str :
+                 conv_sequences(strings.get(), processor, "strings has to be a sequence")) {
+                if (str.is_none())
+                    owned_arena->add_none();
+                else
+                    owned_arena->add(str.string);
+            }
+        }
+        const StringArena& arena = corpus ? *corpus->arena : *owned_arena;
+
+        std::vector<uint64_t> original_offsets;
+        std::string originals;
+        original_offsets.reserve(arena.size() + 1);
+        for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(strings.get()); ++i) {
+            PyObject* item = PyTuple_GET_ITEM(strings.get(), i);
+            if (item == Py_None) {
+                original_offsets.push_back(originals.size() | ORIGINAL_NONE);
+                continue;
+            }
+            if (!PyUnicode_Check(item)) {
+                PyErr_Format(PyExc_TypeError, "compile_corpus only supports str or None as strings, not %.200s",
+                             Py_TYPE(item)->tp_name);
+                throw PythonError();
+            }
+
+            PyObjectRef encoded(PyUnicode_AsEncodedString(item, "utf-8", "surrogatepass"));
+            if (!encoded) throw PythonError();
+            original_offsets.push_back(originals.size());
+            originals.append(PyBytes_AS_STRING(encoded.get()), static_cast<size_t>(PyBytes_GET_SIZE(encoded.get())));
+        }
+        original_offsets.push_back(originals.size());
+
+        CorpusFileHeader header = {};
+        std::memcpy(header.magic, CORPUS_FILE_MAGIC, sizeof(CORPUS_FILE_MAGIC));
+        header.version = CORPUS_FILE_VERSION;
+        header.byte_order = CORPUS_FILE_BYTE_ORDER;
+        header.count = arena.size();
+        if (processor == Py_None) {
+            header.processor = CORPUS_PROCESSOR_NONE;
+        }
+        else if (PyObject_TypeCheck(processor, &ProcessorType)) {
+            header.processor = CORPUS_PROCESSOR_NATIVE;
+            header.processor_flags = reinterpret_cast<Processor*>(processor)->impl.flags;
+        }
+        else {
+            header.processor = CORPUS_PROCESSOR_CALLABLE;
+        }
+
+        StringArenaSpans spans = arena.spans();
+        const void* sections[SECTION_COUNT] = {spans.entries, spans.chars8, spans.chars16, spans.chars32,
+                                               spans.chars64, original_offsets.data(), originals.data()};
+        uint64_t sizes[SECTION_COUNT] = {spans.size * sizeof(ArenaEntry), 0, 0, 0, 0,
+                                         original_offsets.size() * sizeof(uint64_t), originals.size()};
+        for (size_t i = 0; i < spans.size; ++i) {
+            const ArenaEntry& entry = spans.entries[i];
+            uint64_t& size = sizes[SECTION_CHARS8 + entry.kind];
+            size = std::max(size, (entry.offset + static_cast<uint64_t>(entry.length)) << entry.kind);
+        }
+
+        uint64_t offset = CORPUS_FILE_ALIGNMENT;
+        for (size_t i = 0; i < SECTION_COUNT; ++i) {
+            header.sections[i].offset = offset;
+            header.sections[i].size = sizes[i];
+            offset += (sizes[i] + CORPUS_FILE_ALIGNMENT - 1) / CORPUS_FILE_ALIGNMENT * CORPUS_FILE_ALIGNMENT;
+        }
+
+        int errnum = 0;
+        {
+            GilRelease gil;
+            errnum = write_corpus_file(path, header, sections);
+        }
+        if (errnum) throw path.error(errnum);
+        Py_RETURN_NONE;
+    }
+    catch (...) {
+        CppExn2PyErr();
+        return nullptr;
+    }
+}
+
+PyDoc_STRVAR(load_corpus_doc, R"(load_corpus(path, mmap=True)
+--
+
+Loads a corpus file written by ``compile_corpus``. The processed strings are
+used in place, so loading the file neither runs the processor nor converts or
+copies the strings. The original strings are only decoded when they are accessed,
+e.g. for the matches returned by ``extract``.
+
+Parameters
+----------
+path : str | os.PathLike
+    Path of the corpus file.
+mmap : bool, optional
+    Map the file read-only instead of reading it. Processes mapping the same
+    file share its memory through the page cache. Default is True.
+
+Returns
+-------
+corpus : PreprocessedCorpus
+    The stored corpus. Its ``processor`` is the processor passed to
+    ``compile_corpus`` when it was a ``Processor`` and None otherwise.
+
+Raises
+------
+ValueError
+    If the file is no corpus file, was written by an incompatible version or
+    on a machine with a different byte order, or is truncated
+OSError
+    If the file can not be read
+)");
+
+static PyObject* load_corpus(PyObject* /*self*/, PyObject* const* args, Py_ssize_t nargs, PyObject* kwnames)
+{
+    static const char* const names[] = {"path", "mmap"};
+    static const ArgParser parser = {"load_corpus", names, 2, 2, 1};
+    PyObject* argv[2];
+    if (parse_args(parser, args, nargs, kwnames, argv) < 0) return nullptr;
+
+    int use_mmap = argv[1] ? PyObject_IsTrue(argv[1]) : 1;
+    if (use_mmap < 0) return nullptr;
+
+    try {
+        CorpusFilePath path(argv[0]);
+        std::shared_ptr<CorpusFileBuffer> buffer =
+            use_mmap ? CorpusFileBuffer::map(path) : CorpusFileBuffer::read(path);
+
+        CorpusFileHeader header;
+        StringArenaSpans spans = corpus_file_spans(*buffer, header);
+        std::unique_ptr<StringArena> arena(new StringArena(std::move(buffer), spans));
+
+        PyObjectRef processor = PyObjectRef::borrow(Py_None);
+        if (header.processor == CORPUS_PROCESSOR_NATIVE) {
+            processor = PyObjectRef(Processor_create(&ProcessorType, header.processor_flags));
+            if (!processor) throw PythonError();
+        }
+        return PreprocessedCorpus_create(nullptr, processor.get(), std::move(arena));
+    }
+    catch (...) {
+        CppExn2PyErr();
+        return nullptr;
+    }
+}
@@ -0,0 +1,487 @@
+/* SPDX-License-Identifier: MIT */
+/* Copyright © 2022-present Max Bachmann */
+
+#pragma once
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "rapidfuzz_capi.h"
+
+/**
+ * @brief thrown when a Python exception is already set. It is only used to unwind
+ * the C++ stack and does not carry any information itself
+ */
+struct PythonError {};
+
+/**
+ * @brief converts the currently handled C++ exception into a Python exception.
+ * Has to be called from inside a catch block
+ */
+static inline void CppExn2PyErr()
+{
+    try {
+        throw;
+    }
+    catch (const PythonError&) {
+        /* the Python exception is already set */
+    }
+    catch (const std::bad_alloc&) {
+        PyErr_NoMemory();
+    }
+    catch (const std::invalid_argument& e) {
+        PyErr_SetString(PyExc_ValueError, e.what());
+    }
+    catch (const std::out_of_range& e) {
+        PyErr_SetString(PyExc_IndexError, e.what());
+    }
+    catch (const std::exception& e) {
+        PyErr_SetString(PyExc_RuntimeError, e.what());
+    }
+    catch (...) {
+        PyErr_SetString(PyExc_RuntimeError, "Unknown exception");
+    }
+}
+
+/**
+ * @brief owning reference to a Python object
+ */
+class PyObjectRef {
+public:
+    PyObjectRef() noexcept : m_obj(nullptr)
+    {}
+
+    /* steals the reference */
+    explicit PyObjectRef(PyObject* obj) noexcept : m_obj(obj)
+    {}
+
+    PyObjectRef(const PyObjectRef&) = delete;
+    PyObjectRef& operator=(const PyObjectRef&) = delete;
+
+    PyObjectRef(PyObjectRef&& other) noexcept : m_obj(other.m_obj)
+    {
+        other.m_obj = nullptr;
+    }
+
+    PyObjectRef& operator=(PyObjectRef&& other) noexcept
+    {
+        std::swap(m_obj, other.m_obj);
+        return *this;
+    }
+
+    ~PyObjectRef()
+    {
+        Py_XDECREF(m_obj);
+    }
+
+    static PyObjectRef borrow(PyObject* obj) noexcept
+    {
+        Py_XINCREF(obj);
+        return PyObjectRef(obj);
+    }
+
+    PyObject* get() const noexcept
+    {
+        return m_obj;
+    }
+
+    PyObject* release() noexcept
+    {
+        PyObject* obj = m_obj;
+        m_obj = nullptr;
+        return obj;
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return m_obj != nullptr;
+    }
+
+private:
+    PyObject* m_obj;
+};
+
+/**
+ * @brief locks obj for the lifetime of the object on the free-threaded build, so its items can be read
+ * while other threads run. On builds with a GIL this is a no-op. The lock is suspended when the thread
+ * blocks, e.g. while a processor runs, so it can not deadlock.
+ */
+class CriticalSection {
+public:
+#ifdef Py_GIL_DISABLED
+    explicit CriticalSection(PyObject* obj)
+    {
+        PyCriticalSection_Begin(&m_section, obj);
+    }
+
+    ~CriticalSection()
+    {
+        PyCriticalSection_End(&m_section);
+    }
+#else
+    explicit CriticalSection(PyObject*)
+    {}
+#endif
+
+    CriticalSection(const CriticalSection&) = delete;
+    CriticalSection& operator=(const CriticalSection&) = delete;
+
+#ifdef Py_GIL_DISABLED
+private:
+    PyCriticalSection m_section;
+#endif
+};
+
+/**
+ * @brief RF_String together with the Python object owning its buffer
+ */
+struct RF_StringWrapper {
+    RF_String string;
+    PyObjectRef obj;
+
+    RF_StringWrapper() noexcept : string{nullptr, RF_UINT8, nullptr, 0, nullptr}
+    {}
+
+    RF_StringWrapper(RF_String string_, PyObjectRef obj_) noexcept : string(string_), obj(std::move(obj_))
+    {}
+
+    RF_StringWrapper(const RF_StringWrapper&) = delete;
+    RF_StringWrapper& operator=(const RF_StringWrapper&) = delete;
+
+    RF_StringWrapper(RF_StringWrapper&& other) noexcept : RF_StringWrapper()
+    {
+        swap(*this, other);
+    }
+
+    RF_StringWrapper& operator=(RF_StringWrapper&& other) noexcept
+    {
+        swap(*this, other);
+        return *this;
+    }
+
+    ~RF_StringWrapper()
+    {
+        if (string.dtor) string.dtor(&string);
+    }
+
+    /* placeholder for elements which are None */
+    bool is_none() const noexcept
+    {
+        return string.data == nullptr;
+    }
+
+    friend void swap(RF_StringWrapper& a, RF_StringWrapper& b) noexcept
+    {
+        std::swap(a.string, b.string);
+        std::swap(a.obj, b.obj);
+    }
+};
+
+static inline void default_string_deinit(RF_String* string)
+{
+    free(string->data);
+}
+
+/**
+ * @brief copies code points into a new string using the smallest character type holding all of them
+ */
+static inline RF_StringWrapper conv_code_points(const std::vector<uint32_t>& chars)
+{
+    uint32_t max_char = 0;
+    for (uint32_t ch : chars)
+        max_char = std::max(max_char, ch);
+
+    size_t char_size = (max_char < 0x100) ? 1 : (max_char < 0x10000) ? 2 : 4;
+    void* buffer = malloc(chars.size() * char_size + 1);
+    if (!buffer) throw std::bad_alloc();
+
+    RF_String str = {default_string_deinit, (char_size == 1) ? RF_UINT8 : (char_size == 2) ? RF_UINT16 : RF_UINT32,
+                     buffer, static_cast<int64_t>(chars.size()), nullptr};
+    RF_StringWrapper wrapper(str, PyObjectRef());
+    for (size_t i = 0; i < chars.size(); ++i) {
+        if (char_size == 1)
+            static_cast<uint8_t*>(buffer)[i] = static_cast<uint8_t>(chars[i]);
+        else if (char_size == 2)
+            static_cast<uint16_t*>(buffer)[i] = static_cast<uint16_t>(chars[i]);
+        else
+            static_cast<uint32_t*>(buffer)[i] = chars[i];
+    }
+    return wrapper;
+}
+
+/**
+ * @brief converts an element of a sequence into a hash. Integers and single
+ * characters are mapped to their value, so they compare equal to the characters
+ * of a string and e.g. -1 and -2 (which share the same Python hash) stay distinct
+ */
+static inline uint64_t conv_element(PyObject* item)
+{
+    if (PyLong_Check(item)) {
+        int overflow = 0;
+        long long value = PyLong_AsLongLongAndOverflow(item, &overflow);
+        if (value == -1 && PyErr_Occurred()) throw PythonError();
+        if (!overflow) return static_cast<uint64_t>(value);
+    }
+    else if (PyUnicode_Check(item) && PyUnicode_GET_LENGTH(item) == 1) {
+        return PyUnicode_READ_CHAR(item, 0);
+    }
+    else if (PyBytes_Check(item) && PyBytes_GET_SIZE(item) == 1) {
+        return static_cast<uint8_t>(PyBytes_AS_STRING(item)[0]);
+    }
+
+    Py_hash_t hash = PyObject_Hash(item);
+    if (hash == -1 && PyErr_Occurred()) throw PythonError();
+    return static_cast<uint64_t>(hash);
+}
+
+static inline void buffer_string_deinit(RF_String* string)
+{
+    Py_buffer* view = static_cast<Py_buffer*>(string->context);
+    PyBuffer_Release(view);
+    delete view;
+}
+
+/* used for empty buffers, since a string without data marks None */
+static const uint64_t g_empty_buffer[1] = {0};
+
+/**
+ * @brief parses the struct format of a buffer of integers
+ *
+ * @return 1 for signed and 0 for unsigned integers in native byte order, -1 otherwise
+ */
+static inline int parse_int_format(const char* format)
+{
+    if (!format) return 0;
+
+    if (*format == '@' || *format == '=') {
+        ++format;
+    }
+    else if (*format == '<' || *format == '>' || *format == '!') {
+        const uint16_t probe = 1;
+        bool little_endian = *reinterpret_cast<const uint8_t*>(&probe) == 1;
+        if ((*format == '<') != little_endian) return -1;
+        ++format;
+    }
+
+    if (!format[0] || format[1]) return -1;
+    if (strchr("bhilqn", format[0])) return 1;
+    if (strchr("BHILQN", format[0])) return 0;
+    return -1;
+}
+
+template <typename T>
+static inline bool has_negative(const void* data, Py_ssize_t len)
+{
+    const T* items = static_cast<const T*>(data);
+    return std::any_of(items, items + len, [](T item) { return item < 0; });
+}
+
+/* unsigned 64 bit integers, which do not fit into a long long */
+static inline bool has_high_bit(const void* data, Py_ssize_t len)
+{
+    const uint64_t* items = static_cast<const uint64_t*>(data);
+    return std::any_of(items, items + len, [](uint64_t item) { return (item >> 63) != 0; });
+}
+
+/**
+ * @brief converts a contiguous one dimensional buffer of integers (e.g. array('q'), a
+ * NumPy integer array or a memoryview) into a RF_String. The integers are already hashed
+ * symbols, so they are used in place. Only signed integers smaller than 64 bit holding
+ * negative values are copied, to sign extend them like the elements of a list, and unsigned
+ * 64 bit integers of at least 2^63, which are hashed like the elements of a list
+ *
+ * @return false when obj does not export such a buffer
+ */
+static inline bool conv_int_buffer(PyObject* obj, RF_StringWrapper& wrapper)
+{
+    std::unique_ptr<Py_buffer> view(new Py_buffer());
+    if (PyObject_GetBuffer(obj, view.get(), PyBUF_ND | PyBUF_FORMAT) < 0) {
+        PyErr_Clear();
+        return false;
+    }
+
+    int is_signed = parse_int_format(view->format);
+    Py_ssize_t itemsize = view->itemsize;
+    if (view->ndim != 1 || is_signed < 0 || (itemsize != 1 && itemsize != 2 && itemsize != 4 && itemsize != 8)) {
+        PyBuffer_Release(view.get());
+        return false;
+    }
+
+    Py_ssize_t len = view->shape[0];
+    const void* buf = len ? view->buf : g_empty_buffer;
+    bool negative = is_signed && itemsize != 8 &&
+                    ((itemsize == 1)   ? has_negative<int8_t>(buf, len)
+                     : (itemsize == 2) ? has_negative<int16_t>(buf, len)
+                                       : has_negative<int32_t>(buf, len));
+    bool high_bit = !is_signed && itemsize == 8 && has_high_bit(buf, len);
+
+    if (negative || high_bit) {
+        uint64_t* data = static_cast<uint64_t*>(malloc(static_cast<size_t>(len) * sizeof(uint64_t) + 1));
+        if (!data) {
+            PyBuffer_Release(view.get());
+            throw std::bad_alloc();
+        }
+
+        /* owns data, so it is freed when hashing fails */
+        RF_StringWrapper copy({default_string_deinit, RF_UINT64, data, static_cast<int64_t>(len), nullptr},
+                              PyObjectRef());
+        for (Py_ssize_t i = 0; i < len; ++i) {
+            if (high_bit) {
+                data[i] = static_cast<const uint64_t*>(buf)[i];
+                if (data[i] >> 63) {
+                    PyObjectRef item(PyLong_FromUnsignedLongLong(data[i]));
+                    if (!item) {
+                        PyBuffer_Release(view.get());
+                        throw PythonError();
+                    }
+                    data[i] = conv_element(item.get());
+                }
+                continue;
+            }
+
+            int64_t value = (itemsize == 1)   ? static_cast<const int8_t*>(buf)[i]
+                            : (itemsize == 2) ? static_cast<const int16_t*>(buf)[i]
+                                              : static_cast<const int32_t*>(buf)[i];
+            data[i] = static_cast<uint64_t>(value);
+        }
+        PyBuffer_Release(view.get());
+        wrapper = std::move(copy);
+        return true;
+    }
+
+    RF_StringType kind = (itemsize == 1)   ? RF_UINT8
+                         : (itemsize == 2) ? RF_UINT16
+                         : (itemsize == 4) ? RF_UINT32
+                                           : RF_UINT64;
+    /* the buffer is released by the destructor of the string and keeps obj from being resized */
+    RF_String str = {buffer_string_deinit, kind, const_cast<void*>(buf), static_cast<int64_t>(len), view.release()};
+    wrapper = RF_StringWrapper(str, PyObjectRef());
+    return true;
+}
+
+/**
+ * @brief converts a str, bytes, buffer of integers or sequence of hashable objects into
+ * a RF_String. Strings, bytes and buffers of integers are used in place without copying them
+ */
+static inline RF_StringWrapper conv_sequence(PyObject* obj)
+{
+    if (PyUnicode_Check(obj)) {
+#if PY_VERSION_HEX < 0x030C0000
+        if (PyUnicode_READY(obj) < 0) throw PythonError();
+#endif
+        RF_String str = {nullptr, RF_UINT8, PyUnicode_DATA(obj), static_cast<int64_t>(PyUnicode_GET_LENGTH(obj)),
+                         nullptr};
+        switch (PyUnicode_KIND(obj)) {
+        case PyUnicode_1BYTE_KIND: str.kind = RF_UINT8; break;
+        case PyUnicode_2BYTE_KIND: str.kind = RF_UINT16; break;
+        default: str.kind = RF_UINT32; break;
+        }
+        return RF_StringWrapper(str, PyObjectRef::borrow(obj));
+    }
+
+    if (PyBytes_Check(obj)) {
+        RF_String str = {nullptr, RF_UINT8, PyBytes_AS_STRING(obj), static_cast<int64_t>(PyBytes_GET_SIZE(obj)),
+                         nullptr};
+        return RF_StringWrapper(str, PyObjectRef::borrow(obj));
+    }
+
+    if (PyObject_CheckBuffer(obj)) {
+        RF_StringWrapper wrapper;
+        if (conv_int_buffer(obj, wrapper)) return wrapper;
+    }
+
+    PyObjectRef seq(PySequence_Fast(obj, "expected str, bytes or a sequence of hashable objects"));
+    if (!seq) throw PythonError();
+
+    /* a list could be modified by other threads on the free-threaded build */
+    CriticalSection section(seq.get());
+    Py_ssize_t len = PySequence_Fast_GET_SIZE(seq.get());
+    PyObject** items = PySequence_Fast_ITEMS(seq.get());
+
+    uint64_t* data = static_cast<uint64_t*>(malloc(static_cast<size_t>(len) * sizeof(uint64_t) + 1));
+    if (!data) throw std::bad_alloc();
+
+    RF_String str = {default_string_deinit, RF_UINT64, data, static_cast<int64_t>(len), nullptr};
+    RF_StringWrapper wrapper(str, PyObjectRef());
+    for (Py_ssize_t i = 0; i < len; ++i)
+        data[i] = conv_element(items[i]);
+
+    return wrapper;
+}
+
+/**
+ * @brief converts the score_cutoff argument. None deactivates the cutoff
+ */
+static inline double conv_score_cutoff(PyObject* py_score_cutoff)
+{
+    if (py_score_cutoff == Py_None) return 0.0;
+
+    double score_cutoff = PyFloat_AsDouble(py_score_cutoff);
+    if (score_cutoff == -1.0 && PyErr_Occurred()) throw PythonError();
+    return score_cutoff;
+}
+
+/**
+ * @brief releases the GIL for the lifetime of the object
+ */
+class GilRelease {
+public:
+    GilRelease() : m_save(PyEval_SaveThread())
+    {}
+
+    GilRelease(const GilRelease&) = delete;
+    GilRelease& operator=(const GilRelease&) = delete;
+
+    ~GilRelease()
+    {
+        PyEval_RestoreThread(m_save);
+    }
+
+private:
+    PyThreadState* m_save;
+};
+
+/**
+ * @brief calls f(first, last, args...) with pointers to the characters of str
+ */
+template <typename Func, typename... Args>
+static inline auto visit(const RF_String& str, Func&& f, Args&&... args)
+{
+    switch (str.kind) {
+    case RF_UINT8:
+        return f(static_cast<const uint8_t*>(str.data), static_cast<const uint8_t*>(str.data) + str.length,
+                 std::forward<Args>(args)...);
+    case RF_UINT16:
+        return f(static_cast<const uint16_t*>(str.data), static_cast<const uint16_t*>(str.data) + str.length,
+                 std::forward<Args>(args)...);
+    case RF_UINT32:
+        return f(static_cast<const uint32_t*>(str.data), static_cast<const uint32_t*>(str.data) + str.length,
+                 std::forward<Args>(args)...);
+    case RF_UINT64:
+        return f(static_cast<const uint64_t*>(str.data), static_cast<const uint64_t*>(str.data) + str.length,
+                 std::forward<Args>(args)...);
+    default: throw std::logic_error("Invalid string type");
+    }
+}
+
+/**
+ * @brief calls f(first1, last1, first2, last2) with pointers to the characters of s1 and s2
+ */
+template <typename Func>
+static inline auto visitor(const RF_String& s1, const RF_String& s2, Func&& f)
+{
+    return visit(s2, [&](auto first2, auto last2) {
+        return visit(s1, std::forward<Func>(f), first2, last2);
+    });
+}
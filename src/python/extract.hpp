@@ -0,0 +1,109 @@
+/* SPDX-License-Identifier: MIT */
+/* Copyright © 2022-present Max Bachmann */
+
+#pragma once
+
+#include "corpus.hpp"
+#include "cpp_common.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+struct ExtractMatch {
+    double score;
+    size_t index;
+};
+
+/**
+ * @brief orders matches by descending score. Matches with the same score keep the order of the choices
+ */
+static inline bool extract_better(const ExtractMatch& a, const ExtractMatch& b)
+{
+    if (a.score != b.score) return a.score > b.score;
+    return a.index < b.index;
+}
+
+/**
+ * @brief the limit best matches found so far. They are kept in a heap with the worst match on top.
+ * Once the heap is full, the score of this match is used as score_cutoff, so the following
+ * choices are rejected by the length and common character filters as early as possible
+ */
+class TopMatches {
+public:
+    TopMatches(size_t limit, double score_cutoff) : m_limit(limit), m_score_cutoff(score_cutoff)
+    {}
+
+    /**
+     * @brief score_cutoff a choice has to reach to become one of the best matches
+     */
+    double score_cutoff() const
+    {
+        if (m_heap.size() < m_limit) return m_score_cutoff;
+        return std::max(m_score_cutoff, m_heap.front().score);
+    }
+
+    /**
+     * @brief adds a match scored with score_cutoff(). The scorer returns 0 for scores below the cutoff
+     */
+    void add(double score, size_t index)
+    {
+        if (!m_limit || score < score_cutoff()) return;
+
+        ExtractMatch match = {score, index};
+        if (m_heap.size() == m_limit) {
+            if (!extract_better(match, m_heap.front())) return;
+            std::pop_heap(m_heap.begin(), m_heap.end(), extract_better);
+            m_heap.back() = match;
+        }
+        else {
+            m_heap.push_back(match);
+        }
+        std::push_heap(m_heap.begin(), m_heap.end(), extract_better);
+    }
+
+    /**
+     * @return matches ordered from best to worst
+     */
+    std::vector<ExtractMatch> take()
+    {
+        std::sort_heap(m_heap.begin(), m_heap.end(), extract_better);
+        return std::move(m_heap);
+    }
+
+private:
+    size_t m_limit;
+    double m_score_cutoff;
+    std::vector<ExtractMatch> m_heap;
+};
+
+static inline size_t conv_limit(PyObject* py_limit, size_t choice_count)
+{
+    if (!py_limit) return 5;
+    if (py_limit == Py_None) return choice_count;
+
+    long long limit = PyLong_AsLongLong(py_limit);
+    if (limit == -1 && PyErr_Occurred()) throw PythonError();
+    if (limit < 0) throw std::invalid_argument("limit has to be a non negative number or None");
+    return static_cast<size_t>(limit);
+}
+
+/**
+ * @brief converts the matches into a list of (choice, score, index) tuples
+ *
+ * @param choices original choices returned by choices_tuple
+ */
+static inline PyObject* matches_to_python(PyObject* choices, const std::vector<ExtractMatch>& matches)
+{
+    PyObjectRef result(PyList_New(static_cast<Py_ssize_t>(matches.size())));
+    if (!result) throw PythonError();
+
+    for (size_t i = 0; i < matches.size(); ++i) {
+        PyObjectRef choice = choice_item(choices, matches[i].index);
+        PyObject* match =
+            Py_BuildValue("(Odn)", choice.get(), matches[i].score, static_cast<Py_ssize_t>(matches[i].index));
+        if (!match) throw PythonError();
+        PyList_SET_ITEM(result.get(), static_cast<Py_ssize_t>(i), match);
+    }
+    return result.release();
+}
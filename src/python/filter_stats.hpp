@@ -0,0 +1,27 @@
+/* SPDX-License-Identifier: MIT */
+/* Copyright © 2022-present Max Bachmann */
+
+#pragma once
+
+#include "cpp_common.hpp"
+
+#include <atomic>
+#include <cstdint>
+
+#include <jarowinkler/jarowinkler.hpp>
+
+/*
+ * Counters of the histogram filter summed over all batch calls. Each call (or cdist task)
+ * counts into a local FilterStats and adds it here once, so the scoring loops never touch
+ * the shared atomics.
+ */
+
+static std::atomic<int64_t> g_filter_candidates(0);
+static std::atomic<int64_t> g_filter_rejected(0);
+
+static inline void record_filter_stats(const jaro_winkler::FilterStats& stats)
+{
+    if (!stats.candidates) return;
+    g_filter_candidates.fetch_add(stats.candidates, std::memory_order_relaxed);
+    g_filter_rejected.fetch_add(stats.rejected, std::memory_order_relaxed);
+}
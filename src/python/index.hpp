@@ -0,0 +1,328 @@
+/* SPDX-License-Identifier: MIT */
+/* Copyright © 2022-present Max Bachmann */
+
+#pragma once
+
+#include "cpp_common.hpp"
+#include "extract.hpp"
+#include "filter_stats.hpp"
+#include "processor.hpp"
+#include "runtime_stats.hpp"
+#include "scorer_function.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <jarowinkler/jarowinkler.hpp>
+
+/*
+ * Python class holding a list of choices grouped by their length. The Jaro-Winkler similarity
+ * has an upper bound which only depends on the two lengths, so a query with a score_cutoff
+ * only has to look at the lengths whose bound reaches the score_cutoff.
+ */
+
+/**
+ * @brief choices sharing the same length. The Latin-1 choices are copied into one contiguous
+ * block and prepared for the SIMD kernel once, while the other choices are scored one at a time
+ * after checking their precomputed character histogram
+ */
+struct LengthBucket {
+    int64_t length = 0;
+
+    std::vector<size_t> latin1_indices;
+    std::vector<uint8_t> latin1_chars;
+    std::vector<const uint8_t*> latin1_data;
+    std::vector<int64_t> latin1_lengths;
+    std::unique_ptr<jaro_winkler::detail::JaroSimdPatterns> patterns;
+
+    std::vector<size_t> other_indices;
+    std::vector<RF_StringWrapper> others;
+    std::vector<jaro_winkler::detail::CharHistogram> other_histograms;
+};
+
+class LengthIndex {
+public:
+    LengthIndex(std::vector<RF_StringWrapper> choices, double prefix_weight) : m_prefix_weight(prefix_weight)
+    {
+        std::map<int64_t, size_t> bucket_pos;
+        for (size_t i = 0; i < choices.size(); ++i) {
+            if (choices[i].is_none()) continue;
+
+            int64_t length = choices[i].string.length;
+            auto pos = bucket_pos.find(length);
+            if (pos == bucket_pos.end()) {
+                pos = bucket_pos.emplace(length, m_buckets.size()).first;
+                m_buckets.emplace_back();
+                m_buckets.back().length = length;
+            }
+
+            LengthBucket& bucket = m_buckets[pos->second];
+            if (choices[i].string.kind == RF_UINT8) {
+                const uint8_t* data = static_cast<const uint8_t*>(choices[i].string.data);
+                bucket.latin1_indices.push_back(i);
+                bucket.latin1_chars.insert(bucket.latin1_chars.end(), data, data + length);
+            }
+            else {
+                bucket.other_indices.push_back(i);
+                bucket.other_histograms.push_back(visit(choices[i].string, [](auto first, auto last) {
+                    return jaro_winkler::detail::CharHistogram(first, last);
+                }));
+                bucket.others.push_back(std::move(choices[i]));
+            }
+        }
+
+        for (LengthBucket& bucket : m_buckets) {
+            size_t count = bucket.latin1_indices.size();
+            for (size_t i = 0; i < count; ++i)
+                bucket.latin1_data.push_back(bucket.latin1_chars.data() + i * static_cast<size_t>(bucket.length));
+            bucket.latin1_lengths.assign(count, bucket.length);
+            bucket.patterns.reset(new jaro_winkler::detail::JaroSimdPatterns(bucket.latin1_data.data(),
+                                                                             bucket.latin1_lengths.data(), count));
+        }
+    }
+
+    /**
+     * @brief finds the limit best choices. The lengths are visited ordered by their upper bound,
+     * so the search stops at the first length which can not reach the current score_cutoff
+     *
+     * @return matches ordered from best to worst
+     */
+    std::vector<ExtractMatch> extract(const RF_String& query, size_t limit, double score_cutoff) const
+    {
+        TopMatches matches(limit, score_cutoff);
+        if (!limit) return matches.take();
+        jaro_winkler::FilterStats stats;
+        StatsScope stats_scope;
+
+        std::vector<std::pair<double, const LengthBucket*>> order;
+        order.reserve(m_buckets.size());
+        for (const LengthBucket& bucket : m_buckets) {
+            double bound =
+                jaro_winkler::detail::jarowinkler_length_bound(query.length, bucket.length, m_prefix_weight);
+            if (bound >= score_cutoff) order.emplace_back(bound, &bucket);
+        }
+        std::sort(order.begin(), order.end(), [](const auto& a, const auto& b) {
+            return a.first > b.first;
+        });
+
+        visit(query, [&](auto first1, auto last1) {
+            using CharT1 = typename std::iterator_traits<decltype(first1)>::value_type;
+            jaro_winkler::CachedJaroWinklerSimilarity<CharT1> scorer(first1, last1, m_prefix_weight);
+
+            std::vector<double> scores;
+            for (const auto& entry : order) {
+                double cutoff = matches.score_cutoff();
+                if (entry.first < cutoff) break;
+
+                const LengthBucket& bucket = *entry.second;
+                scores.resize(bucket.latin1_indices.size());
+                scorer.similarity_many(*bucket.patterns, bucket.latin1_data.data(), bucket.latin1_lengths.data(),
+                                       scores.data(), cutoff, &stats);
+                for (size_t i = 0; i < scores.size(); ++i)
+                    matches.add(scores[i], bucket.latin1_indices[i]);
+
+                for (size_t i = 0; i < bucket.others.size(); ++i) {
+                    double other_cutoff = matches.score_cutoff();
+                    matches.add(visit(bucket.others[i].string, [&](auto first2, auto last2) {
+                        return scorer.filtered_similarity(bucket.other_histograms[i], first2, last2, other_cutoff,
+                                                          &stats);
+                    }), bucket.other_indices[i]);
+                }
+            }
+        });
+
+        record_filter_stats(stats);
+        return matches.take();
+    }
+
+private:
+    double m_prefix_weight;
+    std::vector<LengthBucket> m_buckets;
+};
+
+struct JaroWinklerIndex {
+    PyObject_HEAD
+    LengthIndex* index;
+    /* original choices returned by choices_tuple, which are returned by extract */
+    PyObject* choices;
+    PyObject* processor;
+    double prefix_weight;
+};
+
+PyDoc_STRVAR(JaroWinklerIndex_doc, R"(JaroWinklerIndex(choices, *, prefix_weight=0.1, processor=None)
+--
+
+List of choices grouped by their length. The Jaro-Winkler similarity of two
+strings can not exceed a bound calculated from their lengths, so a search with
+a score_cutoff skips all lengths which can not reach it. The choices of each
+length are stored next to each other and prepared for the SIMD kernel once.
+
+Parameters
+----------
+choices : Sequence[Sequence[Hashable]]
+    list of all strings searched by extract. Elements which are None are skipped.
+prefix_weight : float, optional
+    Weight used for the common prefix of the two strings.
+    Has to be between 0 and 0.25. Default is 0.1. A prefix_weight of 0
+    calculates the Jaro similarity.
+processor: callable, optional
+    Optional callable that is used to preprocess the choices and the queries
+    passed to extract. Default is None, which deactivates this behaviour.
+
+Raises
+------
+ValueError
+    If prefix_weight is invalid
+)");
+
+static PyObject* JaroWinklerIndex_new(PyTypeObject* type, PyObject* args, PyObject* kwargs)
+{
+    static const char* kwlist[] = {"choices", "prefix_weight", "processor", nullptr};
+    PyObject* py_choices;
+    double prefix_weight = 0.1;
+    PyObject* processor = Py_None;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|$dO:JaroWinklerIndex", const_cast<char**>(kwlist),
+                                     &py_choices, &prefix_weight, &processor))
+        return nullptr;
+
+    PyObjectRef obj(type->tp_alloc(type, 0));
+    if (!obj) return nullptr;
+
+    JaroWinklerIndex* self = reinterpret_cast<JaroWinklerIndex*>(obj.get());
+    Py_INCREF(processor);
+    self->processor = processor;
+    self->prefix_weight = prefix_weight;
+
+    try {
+        jaro_winkler::detail::validate_prefix_weight(prefix_weight);
+
+        /* the processor could modify choices, so the returned choices are taken from a copy */
+        self->choices = choices_tuple(py_choices).release();
+        PyObject* strings = get_corpus(py_choices) ? py_choices : self->choices;
+        self->index =
+            new LengthIndex(conv_sequences(strings, processor, "choices has to be a sequence"), prefix_weight);
+    }
+    catch (...) {
+        CppExn2PyErr();
+        return nullptr;
+    }
+
+    return obj.release();
+}
+
+static PyObject* JaroWinklerIndex_extract(PyObject* self, PyObject* const* args, Py_ssize_t nargs,
+                                          PyObject* kwnames)
+{
+    static const char* const names[] = {"query", "score_cutoff", "limit"};
+    static const ArgParser parser = {"extract", names, 3, 1, 1};
+    PyObject* argv[3];
+    if (parse_args(parser, args, nargs, kwnames, argv) < 0) return nullptr;
+
+    JaroWinklerIndex* index = reinterpret_cast<JaroWinklerIndex*>(self);
+    try {
+        double score_cutoff = conv_score_cutoff(argv[1] ? argv[1] : Py_None);
+        size_t limit = conv_limit(argv[2], choices_size(index->choices));
+        if (argv[0] == Py_None) return PyList_New(0);
+
+        RF_StringWrapper query = conv_processed(index->processor, argv[0]);
+
+        /* the search only accesses the C++ copy of the choices, so other threads can run meanwhile */
+        std::vector<ExtractMatch> matches;
+        {
+            GilRelease gil;
+            matches = index->index->extract(query.string, limit, score_cutoff);
+        }
+        return matches_to_python(index->choices, matches);
+    }
+    catch (...) {
+        CppExn2PyErr();
+        return nullptr;
+    }
+}
+
+static Py_ssize_t JaroWinklerIndex_length(PyObject* self)
+{
+    return static_cast<Py_ssize_t>(choices_size(reinterpret_cast<JaroWinklerIndex*>(self)->choices));
+}
+
+static int JaroWinklerIndex_traverse(PyObject* self, visitproc visit, void* arg)
+{
+    Py_VISIT(reinterpret_cast<JaroWinklerIndex*>(self)->choices);
+    Py_VISIT(reinterpret_cast<JaroWinklerIndex*>(self)->processor);
+    return 0;
+}
+
+static int JaroWinklerIndex_clear(PyObject* self)
+{
+    Py_CLEAR(reinterpret_cast<JaroWinklerIndex*>(self)->choices);
+    Py_CLEAR(reinterpret_cast<JaroWinklerIndex*>(self)->processor);
+    return 0;
+}
+
+static void JaroWinklerIndex_dealloc(PyObject* self)
+{
+    PyObject_GC_UnTrack(self);
+    JaroWinklerIndex* index = reinterpret_cast<JaroWinklerIndex*>(self);
+    delete index->index;
+    JaroWinklerIndex_clear(self);
+    Py_TYPE(self)->tp_free(self);
+}
+
+static PyObject* JaroWinklerIndex_get_processor(PyObject* self, void*)
+{
+    PyObject* processor = reinterpret_cast<JaroWinklerIndex*>(self)->processor;
+    Py_INCREF(processor);
+    return processor;
+}
+
+static PyObject* JaroWinklerIndex_get_prefix_weight(PyObject* self, void*)
+{
+    return PyFloat_FromDouble(reinterpret_cast<JaroWinklerIndex*>(self)->prefix_weight);
+}
+
+static PyMethodDef JaroWinklerIndex_methods[] = {
+    {"extract", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(JaroWinklerIndex_extract)),
+     METH_FASTCALL | METH_KEYWORDS,
+     "extract($self, query, *, score_cutoff=None, limit=5)\n--\n\n"
+     "Finds the best matches of query as list of (choice, similarity, index) tuples sorted by descending\n"
+     "similarity. Choices below score_cutoff are not returned. limit=None returns all matches."},
+    {nullptr, nullptr, 0, nullptr}};
+
+static PyGetSetDef JaroWinklerIndex_getset[] = {
+    {"processor", JaroWinklerIndex_get_processor, nullptr, "processor applied to the choices and the queries",
+     nullptr},
+    {"prefix_weight", JaroWinklerIndex_get_prefix_weight, nullptr, "weight used for the common prefix", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}};
+
+/* the slots are filled in JaroWinklerIndexType_ready, since the layout of
+ * PyTypeObject differs between Python versions */
+#if defined(__GNUC__)
+#    pragma GCC diagnostic push
+#    pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+#endif
+static PyTypeObject JaroWinklerIndexType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+static PySequenceMethods JaroWinklerIndex_as_sequence = {};
+#if defined(__GNUC__)
+#    pragma GCC diagnostic pop
+#endif
+
+static int JaroWinklerIndexType_ready()
+{
+    PyTypeObject* type = &JaroWinklerIndexType;
+    type->tp_name = "jarowinkler.JaroWinklerIndex";
+    type->tp_doc = JaroWinklerIndex_doc;
+    type->tp_basicsize = sizeof(JaroWinklerIndex);
+    type->tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC;
+    type->tp_new = JaroWinklerIndex_new;
+    type->tp_traverse = JaroWinklerIndex_traverse;
+    type->tp_clear = JaroWinklerIndex_clear;
+    type->tp_dealloc = JaroWinklerIndex_dealloc;
+    type->tp_methods = JaroWinklerIndex_methods;
+    type->tp_getset = JaroWinklerIndex_getset;
+    JaroWinklerIndex_as_sequence.sq_length = JaroWinklerIndex_length;
+    type->tp_as_sequence = &JaroWinklerIndex_as_sequence;
+    return PyType_Ready(type);
+}
@@ -0,0 +1,215 @@
+/* SPDX-License-Identifier: MIT */
+/* Copyright © 2022-present Max Bachmann */
+
+#pragma once
+
+#include "cpp_common.hpp"
+#include "processor.hpp"
+#include "scorer_function.hpp"
+
+#include <cstring>
+
+/*
+ * Python classes holding the cached scorer of a fixed pattern. The scorer is
+ * created through the RF_Scorer of the corresponding scorer function, so the
+ * matchers and rapidfuzz share the same cached implementation.
+ */
+
+struct Matcher {
+    PyObject_HEAD
+    RF_ScorerFunc scorer_func;
+    PyObject* pattern;
+    PyObject* processor;
+    /* negative for scorers without prefix_weight */
+    double prefix_weight;
+};
+
+/**
+ * @brief RF_Kwargs which are released when leaving the scope
+ */
+class ScorerKwargs {
+public:
+    ScorerKwargs(const RF_Scorer* scorer, PyObject* kwargs) : m_kwargs()
+    {
+        if (!scorer->kwargs_init(&m_kwargs, kwargs)) throw PythonError();
+    }
+
+    ScorerKwargs(const ScorerKwargs&) = delete;
+    ScorerKwargs& operator=(const ScorerKwargs&) = delete;
+
+    ~ScorerKwargs()
+    {
+        if (m_kwargs.dtor) m_kwargs.dtor(&m_kwargs);
+    }
+
+    const RF_Kwargs* get() const
+    {
+        return &m_kwargs;
+    }
+
+private:
+    RF_Kwargs m_kwargs;
+};
+
+/**
+ * @brief creates a matcher of the given type. Returns a new reference or nullptr
+ * with a Python exception set
+ */
+static PyObject* Matcher_create(PyTypeObject* type, const RF_Scorer* scorer, PyObject* pattern, PyObject* processor,
+                                double prefix_weight = -1.0)
+{
+    PyObjectRef obj(type->tp_alloc(type, 0));
+    if (!obj) return nullptr;
+
+    Matcher* self = reinterpret_cast<Matcher*>(obj.get());
+    Py_INCREF(pattern);
+    self->pattern = pattern;
+    Py_INCREF(processor);
+    self->processor = processor;
+    self->prefix_weight = prefix_weight;
+
+    try {
+        PyObjectRef kwargs;
+        if (prefix_weight >= 0) {
+            kwargs = PyObjectRef(Py_BuildValue("{s:d}", "prefix_weight", prefix_weight));
+            if (!kwargs) throw PythonError();
+        }
+        ScorerKwargs scorer_kwargs(scorer, kwargs.get());
+
+        RF_StringWrapper str = conv_processed(processor, pattern);
+        if (!scorer->scorer_func_init(&self->scorer_func, scorer_kwargs.get(), 1, &str.string)) throw PythonError();
+    }
+    catch (...) {
+        CppExn2PyErr();
+        return nullptr;
+    }
+
+    return obj.release();
+}
+
+static PyObject* Matcher_similarity(PyObject* self, PyObject* const* args, Py_ssize_t nargs, PyObject* kwnames)
+{
+    static const char* const names[] = {"s2", "score_cutoff"};
+    static const ArgParser parser = {"similarity", names, 2, 1, 1};
+    PyObject* argv[2];
+    if (parse_args(parser, args, nargs, kwnames, argv) < 0) return nullptr;
+
+    Matcher* matcher = reinterpret_cast<Matcher*>(self);
+    try {
+        double score_cutoff = conv_score_cutoff(argv[1] ? argv[1] : Py_None);
+        if (argv[0] == Py_None) return PyFloat_FromDouble(0.0);
+
+        RF_StringWrapper s2 = conv_processed(matcher->processor, argv[0]);
+
+        double result = 0;
+        if (!matcher->scorer_func.call.f64(&matcher->scorer_func, &s2.string, 1, score_cutoff, 0.0, &result))
+            return nullptr;
+        return PyFloat_FromDouble(result);
+    }
+    catch (...) {
+        CppExn2PyErr();
+        return nullptr;
+    }
+}
+
+static int Matcher_traverse(PyObject* self, visitproc visit, void* arg)
+{
+    Py_VISIT(reinterpret_cast<Matcher*>(self)->pattern);
+    Py_VISIT(reinterpret_cast<Matcher*>(self)->processor);
+    return 0;
+}
+
+static int Matcher_clear(PyObject* self)
+{
+    Py_CLEAR(reinterpret_cast<Matcher*>(self)->pattern);
+    Py_CLEAR(reinterpret_cast<Matcher*>(self)->processor);
+    return 0;
+}
+
+static void Matcher_dealloc(PyObject* self)
+{
+    PyObject_GC_UnTrack(self);
+    Matcher* matcher = reinterpret_cast<Matcher*>(self);
+    if (matcher->scorer_func.dtor) matcher->scorer_func.dtor(&matcher->scorer_func);
+    Matcher_clear(self);
+    Py_TYPE(self)->tp_free(self);
+}
+
+static PyObject* Matcher_repr(PyObject* self)
+{
+    Matcher* matcher = reinterpret_cast<Matcher*>(self);
+    const char* name = strrchr(Py_TYPE(self)->tp_name, '.') + 1;
+    if (matcher->prefix_weight < 0) return PyUnicode_FromFormat("%s(%R)", name, matcher->pattern);
+
+    PyObjectRef prefix_weight(PyFloat_FromDouble(matcher->prefix_weight));
+    if (!prefix_weight) return nullptr;
+    return PyUnicode_FromFormat("%s(%R, prefix_weight=%R)", name, matcher->pattern, prefix_weight.get());
+}
+
+static PyObject* Matcher_get_pattern(PyObject* self, void*)
+{
+    PyObject* pattern = reinterpret_cast<Matcher*>(self)->pattern;
+    Py_INCREF(pattern);
+    return pattern;
+}
+
+static PyObject* Matcher_get_processor(PyObject* self, void*)
+{
+    PyObject* processor = reinterpret_cast<Matcher*>(self)->processor;
+    Py_INCREF(processor);
+    return processor;
+}
+
+static PyObject* Matcher_get_prefix_weight(PyObject* self, void*)
+{
+    return PyFloat_FromDouble(reinterpret_cast<Matcher*>(self)->prefix_weight);
+}
+
+static PyMethodDef Matcher_methods[] = {
+    {"similarity", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(Matcher_similarity)),
+     METH_FASTCALL | METH_KEYWORDS,
+     "similarity($self, s2, *, score_cutoff=None)\n--\n\n"
+     "Calculates the similarity between the pattern and s2. None receives a score of 0."},
+    {nullptr, nullptr, 0, nullptr}};
+
+static PyGetSetDef JaroMatcher_getset[] = {
+    {"pattern", Matcher_get_pattern, nullptr, "pattern passed to the constructor", nullptr},
+    {"processor", Matcher_get_processor, nullptr, "processor applied to the pattern and the compared strings",
+     nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}};
+
+static PyGetSetDef JaroWinklerMatcher_getset[] = {
+    {"pattern", Matcher_get_pattern, nullptr, "pattern passed to the constructor", nullptr},
+    {"processor", Matcher_get_processor, nullptr, "processor applied to the pattern and the compared strings",
+     nullptr},
+    {"prefix_weight", Matcher_get_prefix_weight, nullptr, "weight used for the common prefix", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}};
+
+/* the slots are filled in MatcherType_ready, since the layout of
+ * PyTypeObject differs between Python versions */
+#if defined(__GNUC__)
+#    pragma GCC diagnostic push
+#    pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+#endif
+static PyTypeObject JaroMatcherType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+static PyTypeObject JaroWinklerMatcherType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+#if defined(__GNUC__)
+#    pragma GCC diagnostic pop
+#endif
+
+static int MatcherType_ready(PyTypeObject* type, const char* name, const char* doc, newfunc tp_new,
+                             PyGetSetDef* getset)
+{
+    type->tp_name = name;
+    type->tp_doc = doc;
+    type->tp_basicsize = sizeof(Matcher);
+    type->tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC;
+    type->tp_new = tp_new;
+    type->tp_repr = Matcher_repr;
+    type->tp_traverse = Matcher_traverse;
+    type->tp_clear = Matcher_clear;
+    type->tp_dealloc = Matcher_dealloc;
+    type->tp_methods = Matcher_methods;
+    type->tp_getset = getset;
+    return PyType_Ready(type);
+}
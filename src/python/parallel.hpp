@@ -0,0 +1,284 @@
+/* SPDX-License-Identifier: MIT */
+/* Copyright © 2022-present Max Bachmann */
+
+#pragma once
+
+#include "runtime_stats.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief resolves the workers argument: -1 uses all available cores
+ */
+static inline size_t resolve_workers(long long workers)
+{
+    if (workers == -1) return std::max<size_t>(1, std::thread::hardware_concurrency());
+    if (workers < 1) throw std::invalid_argument("workers has to be a positive number or -1");
+    return static_cast<size_t>(workers);
+}
+
+/**
+ * @brief batch of tasks [0, task_count) processed by the threads of a ThreadPool and the caller.
+ * Every participant owns a contiguous range of the tasks and takes them from its front. A participant
+ * running out of tasks steals the back half of the largest remaining range, so uneven tasks are
+ * balanced without a shared counter, while neighbouring tasks mostly stay on the same thread.
+ */
+class ParallelJob {
+public:
+    ParallelJob(size_t participants, size_t task_count, std::function<void(size_t)> func)
+        : m_ranges(participants), m_task_count(task_count), m_done(0), m_failed(false), m_func(std::move(func))
+    {
+        for (size_t i = 0; i < participants; ++i) {
+            m_ranges[i].first = task_count * i / participants;
+            m_ranges[i].last = task_count * (i + 1) / participants;
+        }
+    }
+
+    /**
+     * @brief processes tasks until none are left to take. slot is the range owned by the participant
+     */
+    void participate(size_t slot)
+    {
+        StatsScope stats_scope;
+        size_t task;
+        while (take(slot, task)) {
+            /* after a failure the remaining tasks are only counted, so the caller is released */
+            if (!m_failed.load(std::memory_order_relaxed)) {
+                try {
+                    m_func(task);
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> guard(m_error_mutex);
+                    if (!m_error) m_error = std::current_exception();
+                    m_failed = true;
+                }
+            }
+
+            if (m_done.fetch_add(1, std::memory_order_acq_rel) + 1 == m_task_count) {
+                std::lock_guard<std::mutex> guard(m_done_mutex);
+                m_done_cv.notify_all();
+            }
+        }
+    }
+
+    /**
+     * @brief waits until all tasks are finished and rethrows the first exception thrown by a task
+     */
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(m_done_mutex);
+        m_done_cv.wait(lock, [&] { return m_done.load(std::memory_order_acquire) == m_task_count; });
+        lock.unlock();
+
+        if (m_error) std::rethrow_exception(m_error);
+    }
+
+private:
+    struct TaskRange {
+        std::mutex mutex;
+        size_t first = 0;
+        size_t last = 0;
+    };
+
+    bool take(size_t slot, size_t& task)
+    {
+        TaskRange& own = m_ranges[slot];
+        {
+            std::lock_guard<std::mutex> guard(own.mutex);
+            if (own.first < own.last) {
+                task = own.first++;
+                return true;
+            }
+        }
+
+        while (true) {
+            /* the sizes are only read to choose a victim and checked again while it is locked */
+            size_t victim = m_ranges.size();
+            size_t victim_size = 0;
+            for (size_t i = 0; i < m_ranges.size(); ++i) {
+                std::lock_guard<std::mutex> guard(m_ranges[i].mutex);
+                size_t size = m_ranges[i].last - m_ranges[i].first;
+                if (size > victim_size) {
+                    victim = i;
+                    victim_size = size;
+                }
+            }
+            if (victim == m_ranges.size()) return false;
+
+            size_t first, last;
+            {
+                std::lock_guard<std::mutex> guard(m_ranges[victim].mutex);
+                TaskRange& range = m_ranges[victim];
+                if (range.first == range.last) continue;
+
+                first = range.first + (range.last - range.first) / 2;
+                last = range.last;
+                range.last = first;
+            }
+
+            std::lock_guard<std::mutex> guard(own.mutex);
+            task = first;
+            own.first = first + 1;
+            own.last = last;
+            return true;
+        }
+    }
+
+    std::vector<TaskRange> m_ranges;
+    size_t m_task_count;
+    std::atomic<size_t> m_done;
+    std::atomic<bool> m_failed;
+    std::function<void(size_t)> m_func;
+
+    std::mutex m_error_mutex;
+    std::exception_ptr m_error;
+
+    std::mutex m_done_mutex;
+    std::condition_variable m_done_cv;
+};
+
+/**
+ * @brief threads which are kept alive between calls. Jobs of several callers share the threads,
+ * so concurrent calls do not start more threads than the pool holds. The caller of run takes part
+ * in its own job, so a pool of n workers starts n - 1 threads.
+ */
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t workers) : m_stop(false)
+    {
+        try {
+            for (size_t i = 0; i + 1 < workers; ++i)
+                m_threads.emplace_back([this, i] { worker(i); });
+        }
+        catch (const std::system_error&) {
+            /* thread creation failed, so the work is shared by the threads that are running */
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool()
+    {
+        shutdown();
+    }
+
+    /**
+     * @brief stops the threads after the queued jobs are finished. Later jobs are
+     * processed by their caller alone
+     */
+    void shutdown()
+    {
+        std::lock_guard<std::mutex> shutdown_guard(m_shutdown_mutex);
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_all();
+
+        for (auto& thread : m_threads)
+            if (thread.joinable()) thread.join();
+    }
+
+    /* the threads stay available until shutdown is called */
+    size_t workers()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_stop ? 1 : m_threads.size() + 1;
+    }
+
+    /**
+     * @brief runs func(task) for every task in [0, task_count) and waits for them to finish.
+     * The first exception thrown by a task stops the processing and is rethrown to the caller.
+     */
+    template <typename Func>
+    void run(size_t task_count, Func&& func)
+    {
+        if (!task_count) return;
+
+        /* the caller owns the last range and takes the tasks of the other ranges when the job is not shared */
+        size_t slot = m_threads.size();
+        auto job = std::make_shared<ParallelJob>(slot + 1, task_count, std::function<void(size_t)>(func));
+        bool shared = false;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            if (!m_stop && slot && task_count > 1) {
+                m_jobs.push_back(job);
+                shared = true;
+            }
+        }
+        if (shared) m_cv.notify_all();
+
+        job->participate(slot);
+        job->wait();
+        if (shared) remove(job);
+    }
+
+private:
+    void remove(const std::shared_ptr<ParallelJob>& job)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto it = std::find(m_jobs.begin(), m_jobs.end(), job);
+        if (it != m_jobs.end()) m_jobs.erase(it);
+    }
+
+    void worker(size_t slot)
+    {
+        while (true) {
+            std::shared_ptr<ParallelJob> job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [&] { return m_stop || !m_jobs.empty(); });
+                if (m_jobs.empty()) return;
+                job = m_jobs.front();
+            }
+
+            /* no tasks are left to take, so the job is not handed out again */
+            job->participate(slot);
+            remove(job);
+        }
+    }
+
+    std::vector<std::thread> m_threads;
+    std::deque<std::shared_ptr<ParallelJob>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_stop;
+    std::mutex m_shutdown_mutex;
+};
+
+/**
+ * @brief runs func(task) for every task in [0, task_count) using the threads of pool, or on up
+ * to `workers` threads started for this call when no pool is passed. The first exception thrown
+ * by a task stops the processing and is rethrown to the caller.
+ *
+ * func is called without the GIL when the caller released it, so it must not access
+ * any Python objects.
+ */
+template <typename Func>
+static inline void run_parallel(ThreadPool* pool, size_t workers, size_t task_count, Func&& func)
+{
+    if (pool) return pool->run(task_count, std::forward<Func>(func));
+
+    workers = std::min(workers, task_count);
+    if (workers <= 1) {
+        StatsScope stats_scope;
+        for (size_t task = 0; task < task_count; ++task)
+            func(task);
+        return;
+    }
+
+    ThreadPool(workers).run(task_count, std::forward<Func>(func));
+}
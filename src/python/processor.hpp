@@ -0,0 +1,419 @@
+/* SPDX-License-Identifier: MIT */
+/* Copyright © 2022-present Max Bachmann */
+
+#pragma once
+
+#include "corpus.hpp"
+#include "cpp_common.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Native processors. A Processor passed as processor is recognised by the conversion
+ * functions below and applied to the characters of a str while it is converted, so
+ * neither the processor is called through Python nor a new Python string is created.
+ * Every other callable is called for each string as before.
+ */
+
+enum ProcessorFlags : uint32_t {
+    PROCESS_ASCII_FOLD = 1 << 0,
+    PROCESS_LOWERCASE = 1 << 1,
+    PROCESS_CASEFOLD = 1 << 2,
+    PROCESS_REMOVE_PUNCTUATION = 1 << 3,
+    PROCESS_STRIP = 1 << 4
+};
+
+/* the flags in the order they are applied, which is the order they are listed in the repr */
+static const struct {
+    ProcessorFlags flag;
+    const char* name;
+} g_processor_flags[] = {{PROCESS_ASCII_FOLD, "ascii_fold"},
+                         {PROCESS_LOWERCASE, "lowercase"},
+                         {PROCESS_CASEFOLD, "casefold"},
+                         {PROCESS_REMOVE_PUNCTUATION, "remove_punctuation"},
+                         {PROCESS_STRIP, "strip"}};
+
+/* ASCII replacements of the letters U+00C0 - U+017F. nullptr marks characters which are kept */
+static const char* const g_ascii_fold[] = {
+    /* U+00C0 */ "A", "A", "A", "A", "A", "A", "AE", "C", "E", "E", "E", "E", "I", "I", "I", "I",
+    /* U+00D0 */ "D", "N", "O", "O", "O", "O", "O", nullptr, "O", "U", "U", "U", "U", "Y", "TH", "ss",
+    /* U+00E0 */ "a", "a", "a", "a", "a", "a", "ae", "c", "e", "e", "e", "e", "i", "i", "i", "i",
+    /* U+00F0 */ "d", "n", "o", "o", "o", "o", "o", nullptr, "o", "u", "u", "u", "u", "y", "th", "y",
+    /* U+0100 */ "A", "a", "A", "a", "A", "a", "C", "c", "C", "c", "C", "c", "C", "c", "D", "d",
+    /* U+0110 */ "D", "d", "E", "e", "E", "e", "E", "e", "E", "e", "E", "e", "G", "g", "G", "g",
+    /* U+0120 */ "G", "g", "G", "g", "H", "h", "H", "h", "I", "i", "I", "i", "I", "i", "I", "i",
+    /* U+0130 */ "I", "i", "IJ", "ij", "J", "j", "K", "k", "k", "L", "l", "L", "l", "L", "l", "L",
+    /* U+0140 */ "l", "L", "l", "N", "n", "N", "n", "N", "n", "n", "N", "n", "O", "o", "O", "o",
+    /* U+0150 */ "O", "o", "OE", "oe", "R", "r", "R", "r", "R", "r", "S", "s", "S", "s", "S", "s",
+    /* U+0160 */ "S", "s", "T", "t", "T", "t", "T", "t", "U", "u", "U", "u", "U", "u", "U", "u",
+    /* U+0170 */ "U", "u", "U", "u", "W", "w", "Y", "y", "Y", "Z", "z", "Z", "z", "Z", "z", "s",
+};
+
+/**
+ * @brief simple case folding of a single character. It matches the lowercase
+ * character, except for the characters listed here and Cherokee letters, which
+ * are folded to uppercase
+ */
+static inline Py_UCS4 casefold_char(Py_UCS4 ch)
+{
+    Py_UCS4 lower = Py_UNICODE_TOLOWER(ch);
+    if (lower >= 0xAB70 && lower <= 0xABBF) return lower - 0xAB70 + 0x13A0;
+    if (lower >= 0x13F8 && lower <= 0x13FD) return lower - 8;
+
+    switch (lower) {
+    case 0x00B5: return 0x03BC;
+    case 0x017F: return 0x0073;
+    case 0x0345: return 0x03B9;
+    case 0x03C2: return 0x03C3;
+    case 0x03D0: return 0x03B2;
+    case 0x03D1: return 0x03B8;
+    case 0x03D5: return 0x03C6;
+    case 0x03D6: return 0x03C0;
+    case 0x03F0: return 0x03BA;
+    case 0x03F1: return 0x03C1;
+    case 0x03F5: return 0x03B5;
+    case 0x1C80: return 0x0432;
+    case 0x1C81: return 0x0434;
+    case 0x1C82: return 0x043E;
+    case 0x1C83: return 0x0441;
+    case 0x1C84: return 0x0442;
+    case 0x1C85: return 0x0442;
+    case 0x1C86: return 0x044A;
+    case 0x1C87: return 0x0463;
+    case 0x1C88: return 0xA64B;
+    case 0x1E9B: return 0x1E61;
+    case 0x1FBE: return 0x03B9;
+    default: return lower;
+    }
+}
+
+/**
+ * @brief applies the flags (except PROCESS_STRIP, which depends on the position) to a single character
+ *
+ * @return number of characters written to out (0 - 2)
+ */
+static inline int process_char(Py_UCS4 ch, uint32_t flags, Py_UCS4 out[2])
+{
+    int count = 1;
+    out[0] = ch;
+    if ((flags & PROCESS_ASCII_FOLD) && ch >= 0xC0 && ch < 0x180 && g_ascii_fold[ch - 0xC0]) {
+        const char* folded = g_ascii_fold[ch - 0xC0];
+        out[0] = static_cast<Py_UCS4>(folded[0]);
+        if (folded[1]) out[count++] = static_cast<Py_UCS4>(folded[1]);
+    }
+
+    for (int i = 0; i < count; ++i) {
+        if (flags & PROCESS_CASEFOLD) {
+            out[i] = casefold_char(out[i]);
+            /* ß is the only character expanded like str.casefold does */
+            if (out[i] == 0xDF) {
+                out[0] = out[1] = 's';
+                count = 2;
+                break;
+            }
+        }
+        else if (flags & PROCESS_LOWERCASE) {
+            out[i] = Py_UNICODE_TOLOWER(out[i]);
+        }
+    }
+
+    if (flags & PROCESS_REMOVE_PUNCTUATION) {
+        int kept = 0;
+        for (int i = 0; i < count; ++i)
+            if (Py_UNICODE_ISALNUM(out[i]) || Py_UNICODE_ISSPACE(out[i])) out[kept++] = out[i];
+        count = kept;
+    }
+    return count;
+}
+
+/**
+ * @brief flags of a processor together with their result for all Latin-1 characters,
+ * so the common case does not need any Unicode database lookups
+ */
+struct NativeProcessor {
+    uint32_t flags;
+    uint8_t latin1_count[256];
+    Py_UCS4 latin1_chars[256][2];
+    /* Latin-1 strings stay Latin-1 strings, so they can be written directly */
+    bool latin1_closed;
+
+    void init(uint32_t flags_)
+    {
+        flags = flags_;
+        latin1_closed = true;
+        for (Py_UCS4 ch = 0; ch < 256; ++ch) {
+            latin1_count[ch] = static_cast<uint8_t>(process_char(ch, flags, latin1_chars[ch]));
+            for (int i = 0; i < latin1_count[ch]; ++i)
+                if (latin1_chars[ch][i] >= 256) latin1_closed = false;
+        }
+    }
+
+    RF_StringWrapper apply(const uint8_t* first, const uint8_t* last) const
+    {
+        if (!latin1_closed) return apply_generic(first, last);
+
+        uint8_t* buffer = static_cast<uint8_t*>(malloc(static_cast<size_t>(last - first) * 2 + 1));
+        if (!buffer) throw std::bad_alloc();
+
+        RF_String str = {default_string_deinit, RF_UINT8, buffer, 0, nullptr};
+        RF_StringWrapper wrapper(str, PyObjectRef());
+        bool strip = flags & PROCESS_STRIP;
+        int64_t length = 0;
+        for (; first != last; ++first) {
+            for (int i = 0; i < latin1_count[*first]; ++i) {
+                Py_UCS4 ch = latin1_chars[*first][i];
+                if (strip && !length && Py_UNICODE_ISSPACE(ch)) continue;
+                buffer[length++] = static_cast<uint8_t>(ch);
+            }
+        }
+
+        if (strip)
+            while (length && Py_UNICODE_ISSPACE(buffer[length - 1]))
+                --length;
+
+        wrapper.string.length = length;
+        return wrapper;
+    }
+
+    template <typename CharT>
+    RF_StringWrapper apply(const CharT* first, const CharT* last) const
+    {
+        return apply_generic(first, last);
+    }
+
+    template <typename CharT>
+    RF_StringWrapper apply_generic(const CharT* first, const CharT* last) const
+    {
+        /* reused between calls, so only the final string is allocated */
+        thread_local std::vector<uint32_t> chars;
+        chars.clear();
+        chars.reserve(static_cast<size_t>(last - first) * 2);
+
+        bool strip = flags & PROCESS_STRIP;
+        for (; first != last; ++first) {
+            Py_UCS4 ch = static_cast<Py_UCS4>(*first);
+            Py_UCS4 buffer[2];
+            const Py_UCS4* out = buffer;
+            int count;
+            if (ch < 256) {
+                out = latin1_chars[ch];
+                count = latin1_count[ch];
+            }
+            else {
+                count = process_char(ch, flags, buffer);
+            }
+
+            for (int i = 0; i < count; ++i) {
+                if (strip && chars.empty() && Py_UNICODE_ISSPACE(out[i])) continue;
+                chars.push_back(out[i]);
+            }
+        }
+
+        if (strip)
+            while (!chars.empty() && Py_UNICODE_ISSPACE(chars.back()))
+                chars.pop_back();
+
+        return conv_code_points(chars);
+    }
+
+    RF_StringWrapper apply(const RF_String& str) const
+    {
+        return visit(str, [&](auto first, auto last) {
+            return apply(first, last);
+        });
+    }
+};
+
+struct Processor {
+    PyObject_HEAD
+    NativeProcessor impl;
+};
+
+/* the slots are filled in ProcessorType_ready, since the layout of
+ * PyTypeObject differs between Python versions */
+#if defined(__GNUC__)
+#    pragma GCC diagnostic push
+#    pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+#endif
+static PyTypeObject ProcessorType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+#if defined(__GNUC__)
+#    pragma GCC diagnostic pop
+#endif
+
+/**
+ * @return the native processor or nullptr when processor is any other callable
+ */
+static inline const NativeProcessor* get_native_processor(PyObject* processor)
+{
+    if (!PyObject_TypeCheck(processor, &ProcessorType)) return nullptr;
+    return &reinterpret_cast<Processor*>(processor)->impl;
+}
+
+/**
+ * @brief applies the processor to obj. Returns obj itself when processor is None
+ */
+static inline PyObjectRef preprocess(PyObject* processor, PyObject* obj)
+{
+    if (processor == Py_None) return PyObjectRef::borrow(obj);
+
+    PyObjectRef proc_obj(PyObject_CallFunctionObjArgs(processor, obj, nullptr));
+    if (!proc_obj) throw PythonError();
+    return proc_obj;
+}
+
+/**
+ * @brief preprocesses and converts obj. Native processors are applied while converting str,
+ * while elements of a PreprocessedCorpus are used as they are
+ */
+static inline RF_StringWrapper conv_processed(PyObject* processor, PyObject* obj)
+{
+    RF_StringWrapper str;
+    if (conv_preprocessed_string(obj, str)) return str;
+
+    const NativeProcessor* native = get_native_processor(processor);
+    if (native && PyUnicode_Check(obj)) return native->apply(conv_sequence(obj).string);
+
+    PyObjectRef proc_obj = preprocess(processor, obj);
+    return conv_sequence(proc_obj.get());
+}
+
+/**
+ * @brief preprocesses and converts all elements of a sequence. Elements which are
+ * None are kept as placeholder, so the indices stay aligned with the sequence.
+ * A PreprocessedCorpus is used in place without applying the processor again
+ */
+static inline std::vector<RF_StringWrapper> conv_sequences(PyObject* obj, PyObject* processor, const char* err_msg)
+{
+    std::vector<RF_StringWrapper> corpus;
+    if (conv_preprocessed_corpus(obj, corpus)) return corpus;
+
+    PyObjectRef seq(PySequence_Fast(obj, err_msg));
+    if (!seq) throw PythonError();
+
+    CriticalSection section(seq.get());
+    Py_ssize_t len = PySequence_Fast_GET_SIZE(seq.get());
+    std::vector<RF_StringWrapper> strings;
+    strings.reserve(static_cast<size_t>(len));
+
+    for (Py_ssize_t i = 0; i < len; ++i) {
+        /* the processor could modify the sequence, so keep the element alive */
+        PyObjectRef item = PyObjectRef::borrow(PySequence_Fast_GET_ITEM(seq.get(), i));
+        if (item.get() == Py_None) {
+            strings.emplace_back();
+            continue;
+        }
+
+        strings.push_back(conv_processed(processor, item.get()));
+    }
+    return strings;
+}
+
+PyDoc_STRVAR(Processor_doc, R"(Processor(*, ascii_fold=False, lowercase=False, casefold=False, remove_punctuation=False, strip=False)
+--
+
+Native string processor. When it is passed as processor, it is applied while the
+strings are converted, without calling back into Python or creating new strings.
+Processors can be combined using ``|``. The enabled steps are applied in the order
+of the parameters. Calling the processor applies it to a str.
+
+Parameters
+----------
+ascii_fold : bool, optional
+    Replace the Latin letters U+00C0 - U+017F with their ASCII base letters,
+    e.g. ``é`` with ``e`` and ``æ`` with ``ae``.
+lowercase : bool, optional
+    Convert all characters to lowercase. Characters with a multi-character
+    lowercase mapping (only ``İ``) keep a single character.
+casefold : bool, optional
+    Fold the case of all characters. In contrast to ``str.casefold`` only
+    ``ß`` is expanded into multiple characters, while the few other characters
+    with a multi-character folding keep a single character.
+remove_punctuation : bool, optional
+    Remove all characters which are neither alphanumeric nor whitespace.
+strip : bool, optional
+    Remove leading and trailing whitespace.
+)");
+
+static PyObject* Processor_create(PyTypeObject* type, uint32_t flags)
+{
+    PyObject* self = type->tp_alloc(type, 0);
+    if (!self) return nullptr;
+
+    reinterpret_cast<Processor*>(self)->impl.init(flags);
+    return self;
+}
+
+static PyObject* Processor_new(PyTypeObject* type, PyObject* args, PyObject* kwargs)
+{
+    static const char* kwlist[] = {"ascii_fold", "lowercase", "casefold", "remove_punctuation", "strip", nullptr};
+    int options[5] = {0, 0, 0, 0, 0};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|$ppppp:Processor", const_cast<char**>(kwlist), &options[0],
+                                     &options[1], &options[2], &options[3], &options[4]))
+        return nullptr;
+
+    uint32_t flags = 0;
+    for (int i = 0; i < 5; ++i)
+        if (options[i]) flags |= g_processor_flags[i].flag;
+    return Processor_create(type, flags);
+}
+
+static PyObject* Processor_call(PyObject* self, PyObject* args, PyObject* kwargs)
+{
+    PyObject* s;
+    static const char* kwlist[] = {"s", nullptr};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "U:Processor", const_cast<char**>(kwlist), &s)) return nullptr;
+
+    try {
+        RF_StringWrapper str = reinterpret_cast<Processor*>(self)->impl.apply(conv_sequence(s).string);
+        int kind = (str.string.kind == RF_UINT8)    ? PyUnicode_1BYTE_KIND
+                   : (str.string.kind == RF_UINT16) ? PyUnicode_2BYTE_KIND
+                                                    : PyUnicode_4BYTE_KIND;
+        return PyUnicode_FromKindAndData(kind, str.string.data, static_cast<Py_ssize_t>(str.string.length));
+    }
+    catch (...) {
+        CppExn2PyErr();
+        return nullptr;
+    }
+}
+
+static PyObject* Processor_or(PyObject* a, PyObject* b)
+{
+    const NativeProcessor* proc_a = get_native_processor(a);
+    const NativeProcessor* proc_b = get_native_processor(b);
+    if (!proc_a || !proc_b) Py_RETURN_NOTIMPLEMENTED;
+
+    return Processor_create(&ProcessorType, proc_a->flags | proc_b->flags);
+}
+
+static PyObject* Processor_repr(PyObject* self)
+{
+    uint32_t flags = reinterpret_cast<Processor*>(self)->impl.flags;
+    std::string repr = "Processor(";
+    for (const auto& option : g_processor_flags) {
+        if (!(flags & option.flag)) continue;
+        if (repr.back() != '(') repr += ", ";
+        repr += option.name;
+        repr += "=True";
+    }
+    repr += ")";
+    return PyUnicode_FromString(repr.c_str());
+}
+
+static PyNumberMethods Processor_as_number;
+
+static int ProcessorType_ready()
+{
+    Processor_as_number.nb_or = Processor_or;
+
+    ProcessorType.tp_name = "jarowinkler.Processor";
+    ProcessorType.tp_doc = Processor_doc;
+    ProcessorType.tp_basicsize = sizeof(Processor);
+    ProcessorType.tp_flags = Py_TPFLAGS_DEFAULT;
+    ProcessorType.tp_new = Processor_new;
+    ProcessorType.tp_call = Processor_call;
+    ProcessorType.tp_repr = Processor_repr;
+    ProcessorType.tp_as_number = &Processor_as_number;
+    return PyType_Ready(&ProcessorType);
+}
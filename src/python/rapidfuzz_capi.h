@@ -0,0 +1,111 @@
+/* SPDX-License-Identifier: MIT */
+/* Copyright © 2021-present Max Bachmann */
+
+/*
+ * Scorer interface of the RapidFuzz C-API. Scorers exposing an RF_Scorer
+ * through the `_RF_Scorer` PyCapsule attribute can be called by
+ * rapidfuzz.process without any Python overhead.
+ *
+ * This has to stay ABI compatible with rapidfuzz/rapidfuzz_capi.h
+ */
+
+#ifndef RAPIDFUZZ_CAPI_H
+#define RAPIDFUZZ_CAPI_H
+
+#include <Python.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum RF_StringType {
+    RF_UINT8,  /* uint8_t */
+    RF_UINT16, /* uint16_t */
+    RF_UINT32, /* uint32_t */
+    RF_UINT64  /* uint64_t */
+};
+
+#define RF_SCORER_FLAG_MULTI_STRING_INIT ((uint32_t)1 << 0)
+#define RF_SCORER_FLAG_MULTI_STRING_CALL ((uint32_t)1 << 1)
+#define RF_SCORER_FLAG_RESULT_F64 ((uint32_t)1 << 5)
+#define RF_SCORER_FLAG_RESULT_I64 ((uint32_t)1 << 6)
+#define RF_SCORER_FLAG_RESULT_SIZE_T ((uint32_t)1 << 7)
+#define RF_SCORER_FLAG_SYMMETRIC ((uint32_t)1 << 11)
+#define RF_SCORER_NONE_IS_WORST_SCORE ((uint32_t)1 << 12)
+
+typedef struct _RF_String {
+    /* dtor */
+    void (*dtor)(struct _RF_String* self);
+
+    /* members */
+    enum RF_StringType kind;
+    void* data;
+    int64_t length;
+    void* context;
+} RF_String;
+
+typedef struct _RF_Kwargs {
+    /* dtor */
+    void (*dtor)(struct _RF_Kwargs* self);
+
+    /* members */
+    void* context;
+} RF_Kwargs;
+
+typedef bool (*RF_KwargsInit)(RF_Kwargs* self, PyObject* kwargs);
+
+typedef struct {
+    uint32_t flags;
+
+    union {
+        double f64;
+        int64_t i64;
+        size_t sizet;
+    } optimal_score;
+
+    union {
+        double f64;
+        int64_t i64;
+        size_t sizet;
+    } worst_score;
+} RF_ScorerFlags;
+
+typedef bool (*RF_GetScorerFlags)(const RF_Kwargs* kwargs, RF_ScorerFlags* scorer_flags);
+
+typedef struct _RF_ScorerFunc {
+    /* dtor */
+    void (*dtor)(struct _RF_ScorerFunc* self);
+
+    /* members */
+    union {
+        bool (*f64)(const struct _RF_ScorerFunc* self, const RF_String* str, int64_t str_count,
+                    double score_cutoff, double score_hint, double* result);
+        bool (*i64)(const struct _RF_ScorerFunc* self, const RF_String* str, int64_t str_count,
+                    int64_t score_cutoff, int64_t score_hint, int64_t* result);
+        bool (*sizet)(const struct _RF_ScorerFunc* self, const RF_String* str, int64_t str_count,
+                      size_t score_cutoff, size_t score_hint, size_t* result);
+    } call;
+
+    void* context;
+} RF_ScorerFunc;
+
+typedef bool (*RF_ScorerFuncInit)(RF_ScorerFunc* self, const RF_Kwargs* kwargs, int64_t str_count,
+                                  const RF_String* str);
+
+#define SCORER_STRUCT_VERSION ((uint32_t)3)
+
+typedef struct {
+    uint32_t version;
+    RF_KwargsInit kwargs_init;
+    RF_GetScorerFlags get_scorer_flags;
+    RF_ScorerFuncInit scorer_func_init;
+} RF_Scorer;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RAPIDFUZZ_CAPI_H */
@@ -0,0 +1,168 @@
+/* SPDX-License-Identifier: MIT */
+/* Copyright © 2022-present Max Bachmann */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <jarowinkler/jarowinkler.hpp>
+
+/*
+ * Runtime statistics of the paths taken by the scorers (see jaro_winkler::JaroStats). They are
+ * disabled by default. While they are enabled every thread entering the extension counts into
+ * its own JaroStats, which is registered in the StatsRegistry. The counters of all threads are
+ * only merged when they are read, so the scoring loops never touch shared cache lines.
+ */
+
+static std::atomic<bool> g_stats_enabled(false);
+
+/**
+ * @brief plain copy of the counters of jaro_winkler::JaroStats
+ */
+struct StatsTotals {
+    int64_t calls = 0;
+    int64_t empty = 0;
+    int64_t length_rejected = 0;
+    int64_t histogram_rejected = 0;
+    int64_t single_word = 0;
+    int64_t multi_word = 0;
+    int64_t simd = 0;
+    int64_t hashed = 0;
+    int64_t early_exits = 0;
+    int64_t length_histogram[jaro_winkler::JaroStats::LENGTH_BUCKETS] = {};
+
+    void add(const jaro_winkler::JaroStats& stats)
+    {
+        auto load = [](const std::atomic<int64_t>& counter) {
+            return counter.load(std::memory_order_relaxed);
+        };
+        calls += load(stats.calls);
+        empty += load(stats.empty);
+        length_rejected += load(stats.length_rejected);
+        histogram_rejected += load(stats.histogram_rejected);
+        single_word += load(stats.single_word);
+        multi_word += load(stats.multi_word);
+        simd += load(stats.simd);
+        hashed += load(stats.hashed);
+        early_exits += load(stats.early_exits);
+        for (size_t i = 0; i < jaro_winkler::JaroStats::LENGTH_BUCKETS; ++i)
+            length_histogram[i] += load(stats.length_histogram[i]);
+    }
+
+    void subtract(const StatsTotals& other)
+    {
+        calls -= other.calls;
+        empty -= other.empty;
+        length_rejected -= other.length_rejected;
+        histogram_rejected -= other.histogram_rejected;
+        single_word -= other.single_word;
+        multi_word -= other.multi_word;
+        simd -= other.simd;
+        hashed -= other.hashed;
+        early_exits -= other.early_exits;
+        for (size_t i = 0; i < jaro_winkler::JaroStats::LENGTH_BUCKETS; ++i)
+            length_histogram[i] -= other.length_histogram[i];
+    }
+};
+
+struct StatsRegistry {
+    std::mutex mutex;
+    std::vector<const jaro_winkler::JaroStats*> threads;
+    /* counters of the threads which already exited */
+    StatsTotals retired;
+    /* totals at the last reset. The counters of a thread are only written by the thread itself,
+     * so a reset can not clear them and the totals are reported relative to this instead */
+    StatsTotals offset;
+
+    StatsTotals totals_locked() const
+    {
+        StatsTotals totals = retired;
+        for (const jaro_winkler::JaroStats* stats : threads)
+            totals.add(*stats);
+        return totals;
+    }
+};
+
+/* never destroyed, since threads can still exit while the interpreter shuts down */
+static StatsRegistry& stats_registry()
+{
+    static StatsRegistry* registry = new StatsRegistry();
+    return *registry;
+}
+
+/**
+ * @brief counters of a single thread. They are registered on the first call of the thread
+ * with stats enabled and moved into the retired counters when the thread exits
+ */
+struct ThreadStats {
+    jaro_winkler::JaroStats stats;
+
+    ThreadStats()
+    {
+        StatsRegistry& registry = stats_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.threads.push_back(&stats);
+    }
+
+    ThreadStats(const ThreadStats&) = delete;
+    ThreadStats& operator=(const ThreadStats&) = delete;
+
+    ~ThreadStats()
+    {
+        StatsRegistry& registry = stats_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.retired.add(stats);
+        registry.threads.erase(std::find(registry.threads.begin(), registry.threads.end(), &stats));
+    }
+};
+
+static jaro_winkler::JaroStats* thread_stats_block()
+{
+    static thread_local ThreadStats block;
+    return &block.stats;
+}
+
+/**
+ * @brief installs the counters of the calling thread while stats are enabled. Placed at every
+ * entry into the extension and in the worker threads, so disabling the stats takes effect with
+ * the next call
+ */
+class StatsScope {
+public:
+    StatsScope() : m_installed(g_stats_enabled.load(std::memory_order_relaxed)), m_previous(nullptr)
+    {
+        if (m_installed) m_previous = jaro_winkler::set_thread_stats(thread_stats_block());
+    }
+
+    StatsScope(const StatsScope&) = delete;
+    StatsScope& operator=(const StatsScope&) = delete;
+
+    ~StatsScope()
+    {
+        if (m_installed) jaro_winkler::set_thread_stats(m_previous);
+    }
+
+private:
+    bool m_installed;
+    jaro_winkler::JaroStats* m_previous;
+};
+
+/**
+ * @brief counters of all threads since the last reset
+ *
+ * @param reset start counting from zero again afterwards
+ */
+static StatsTotals read_stats(bool reset)
+{
+    StatsRegistry& registry = stats_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    StatsTotals totals = registry.totals_locked();
+    StatsTotals result = totals;
+    result.subtract(registry.offset);
+    if (reset) registry.offset = totals;
+    return result;
+}
@@ -0,0 +1,294 @@
+/* SPDX-License-Identifier: MIT */
+/* Copyright © 2022-present Max Bachmann */
+
+#pragma once
+
+#include "cpp_common.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief writable, C-contiguous buffer of float32 or float64 scores provided by the caller
+ * through the buffer protocol (e.g. array.array("d") or a numpy array)
+ */
+class ScoreBuffer {
+public:
+    ScoreBuffer(PyObject* obj, const std::vector<Py_ssize_t>& shape) : m_view(), m_f32(false)
+    {
+        if (PyObject_GetBuffer(obj, &m_view, PyBUF_WRITABLE | PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) < 0)
+            throw PythonError();
+
+        try {
+            validate(shape);
+        }
+        catch (...) {
+            PyBuffer_Release(&m_view);
+            throw;
+        }
+    }
+
+    ScoreBuffer(const ScoreBuffer&) = delete;
+    ScoreBuffer& operator=(const ScoreBuffer&) = delete;
+
+    ~ScoreBuffer()
+    {
+        PyBuffer_Release(&m_view);
+    }
+
+    bool is_f32() const
+    {
+        return m_f32;
+    }
+
+    void* data() const
+    {
+        return m_view.buf;
+    }
+
+    void set(size_t index, double score)
+    {
+        if (m_f32)
+            static_cast<float*>(m_view.buf)[index] = static_cast<float>(score);
+        else
+            static_cast<double*>(m_view.buf)[index] = score;
+    }
+
+private:
+    static bool is_native_prefix(char c)
+    {
+        const uint16_t probe = 1;
+        bool little_endian = *reinterpret_cast<const char*>(&probe) == 1;
+        return c == '@' || c == '=' || (little_endian ? c == '<' : (c == '>' || c == '!'));
+    }
+
+    void validate(const std::vector<Py_ssize_t>& shape)
+    {
+        const char* format = m_view.format ? m_view.format : "B";
+        if (is_native_prefix(format[0])) ++format;
+
+        if (!strcmp(format, "f"))
+            m_f32 = true;
+        else if (!strcmp(format, "d"))
+            m_f32 = false;
+        else
+            throw std::invalid_argument("out has to be a buffer of float32 or float64 values");
+
+        if (m_view.ndim != static_cast<int>(shape.size()))
+            throw std::invalid_argument("out has an incompatible number of dimensions");
+
+        for (size_t i = 0; i < shape.size(); ++i)
+            if (m_view.shape[i] != shape[i]) throw std::invalid_argument("out has an incompatible shape");
+    }
+
+    Py_buffer m_view;
+    bool m_f32;
+};
+
+/**
+ * @brief vector of scores. It either wraps the out buffer provided by the user,
+ * which is validated before any score is calculated, or stores the scores for a list of floats
+ */
+class ScoreVector {
+public:
+    ScoreVector(size_t size, PyObject* out) : m_size(size)
+    {
+        if (out && out != Py_None) {
+            m_out = std::unique_ptr<ScoreBuffer>(new ScoreBuffer(out, {static_cast<Py_ssize_t>(size)}));
+            m_obj = PyObjectRef::borrow(out);
+            for (size_t i = 0; i < size; ++i)
+                m_out->set(i, 0.0);
+            return;
+        }
+
+        m_scores.resize(size, 0.0);
+    }
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    void set(size_t index, double score)
+    {
+        if (m_out)
+            m_out->set(index, score);
+        else
+            m_scores[index] = score;
+    }
+
+    /**
+     * @brief returns out when it was provided, or the scores as list of floats.
+     * Returns a new reference
+     */
+    PyObject* to_python()
+    {
+        if (m_out) {
+            m_out.reset();
+            return m_obj.release();
+        }
+
+        PyObjectRef list(PyList_New(static_cast<Py_ssize_t>(m_size)));
+        if (!list) throw PythonError();
+
+        for (size_t i = 0; i < m_size; ++i) {
+            PyObject* score = PyFloat_FromDouble(m_scores[i]);
+            if (!score) throw PythonError();
+            PyList_SET_ITEM(list.get(), static_cast<Py_ssize_t>(i), score);
+        }
+        return list.release();
+    }
+
+private:
+    size_t m_size;
+    std::vector<double> m_scores;
+    std::unique_ptr<ScoreBuffer> m_out;
+    PyObjectRef m_obj;
+};
+
+/*
+ * Owner of the score matrices allocated by the extension. It only exports its memory
+ * through the buffer protocol and is handed to the user wrapped in a memoryview.
+ * memoryview.cast can not be used for this, since it does not support shapes with zeros.
+ */
+struct ResultBuffer {
+    PyObject_HEAD
+    char* data;
+    int ndim;
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+    Py_ssize_t itemsize;
+    char format[2];
+};
+
+static int ResultBuffer_getbuffer(PyObject* self, Py_buffer* view, int flags)
+{
+    ResultBuffer* buffer = reinterpret_cast<ResultBuffer*>(self);
+
+    view->obj = self;
+    Py_INCREF(self);
+    view->buf = buffer->data;
+    view->len = buffer->itemsize;
+    for (int i = 0; i < buffer->ndim; ++i)
+        view->len *= buffer->shape[i];
+    view->readonly = 0;
+    view->itemsize = buffer->itemsize;
+    view->format = (flags & PyBUF_FORMAT) ? buffer->format : nullptr;
+    view->ndim = buffer->ndim;
+    view->shape = (flags & PyBUF_ND) ? buffer->shape : nullptr;
+    view->strides = ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) ? buffer->strides : nullptr;
+    view->suboffsets = nullptr;
+    view->internal = nullptr;
+    return 0;
+}
+
+static void ResultBuffer_dealloc(PyObject* self)
+{
+    PyMem_Free(reinterpret_cast<ResultBuffer*>(self)->data);
+    Py_TYPE(self)->tp_free(self);
+}
+
+static PyBufferProcs ResultBuffer_as_buffer = {ResultBuffer_getbuffer, nullptr};
+
+#if defined(__GNUC__)
+#    pragma GCC diagnostic push
+#    pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+#endif
+static PyTypeObject ResultBufferType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+#if defined(__GNUC__)
+#    pragma GCC diagnostic pop
+#endif
+
+static int ResultBufferType_ready()
+{
+    ResultBufferType.tp_name = "jarowinkler._initialize_cpp.ResultBuffer";
+    ResultBufferType.tp_basicsize = sizeof(ResultBuffer);
+    ResultBufferType.tp_flags = Py_TPFLAGS_DEFAULT;
+    ResultBufferType.tp_dealloc = ResultBuffer_dealloc;
+    ResultBufferType.tp_as_buffer = &ResultBuffer_as_buffer;
+    return PyType_Ready(&ResultBufferType);
+}
+
+/**
+ * @brief allocates a C-contiguous ResultBuffer of float32 ('f'), float64 ('d') or int64 ('q') values
+ *
+ * @return new reference
+ */
+static inline PyObjectRef ResultBuffer_create(const std::vector<Py_ssize_t>& shape, char format)
+{
+    ResultBuffer* buffer = PyObject_New(ResultBuffer, &ResultBufferType);
+    if (!buffer) throw PythonError();
+    buffer->data = nullptr;
+    PyObjectRef obj(reinterpret_cast<PyObject*>(buffer));
+
+    size_t size = 1;
+    for (Py_ssize_t dim : shape)
+        size *= static_cast<size_t>(dim);
+
+    buffer->itemsize = (format == 'f') ? sizeof(float) : sizeof(double);
+    buffer->data = static_cast<char*>(PyMem_Malloc(std::max<size_t>(1, size) * buffer->itemsize));
+    if (!buffer->data) throw std::bad_alloc();
+
+    buffer->ndim = static_cast<int>(shape.size());
+    Py_ssize_t stride = buffer->itemsize;
+    for (int i = buffer->ndim - 1; i >= 0; --i) {
+        buffer->shape[i] = shape[static_cast<size_t>(i)];
+        buffer->strides[i] = stride;
+        stride *= shape[static_cast<size_t>(i)];
+    }
+    buffer->format[0] = format;
+    buffer->format[1] = '\0';
+    return obj;
+}
+
+/**
+ * @brief score matrix of float32 or float64 values. It either wraps the out buffer
+ * provided by the user or memory allocated by the extension
+ */
+class ScoreMatrix {
+public:
+    ScoreMatrix(size_t rows, size_t cols, PyObject* out, bool f32) : m_cols(cols)
+    {
+        if (out && out != Py_None) {
+            m_out = std::unique_ptr<ScoreBuffer>(
+                new ScoreBuffer(out, {static_cast<Py_ssize_t>(rows), static_cast<Py_ssize_t>(cols)}));
+            m_obj = PyObjectRef::borrow(out);
+            m_data = m_out->data();
+            m_f32 = m_out->is_f32();
+            return;
+        }
+
+        m_obj = ResultBuffer_create({static_cast<Py_ssize_t>(rows), static_cast<Py_ssize_t>(cols)}, f32 ? 'f' : 'd');
+        m_data = reinterpret_cast<ResultBuffer*>(m_obj.get())->data;
+        m_f32 = f32;
+    }
+
+    /* can be called without holding the GIL */
+    void set(size_t row, size_t col, double score)
+    {
+        size_t index = row * m_cols + col;
+        if (m_f32)
+            static_cast<float*>(m_data)[index] = static_cast<float>(score);
+        else
+            static_cast<double*>(m_data)[index] = score;
+    }
+
+    /**
+     * @brief returns out when it was provided, or a memoryview of the allocated scores
+     */
+    PyObject* to_python()
+    {
+        m_out.reset();
+        if (PyObject_TypeCheck(m_obj.get(), &ResultBufferType)) return PyMemoryView_FromObject(m_obj.get());
+        return m_obj.release();
+    }
+
+private:
+    size_t m_cols;
+    void* m_data;
+    bool m_f32;
+    std::unique_ptr<ScoreBuffer> m_out;
+    PyObjectRef m_obj;
+};
@@ -0,0 +1,267 @@
+/* SPDX-License-Identifier: MIT */
+/* Copyright © 2022-present Max Bachmann */
+
+#pragma once
+
+#include "cpp_common.hpp"
+#include "runtime_stats.hpp"
+
+#include <cstddef>
+
+/*
+ * Native callable used for the public scorers. Builtin functions can not hold
+ * attributes like `_RF_Scorer`, while wrapping them in Python functions adds an
+ * additional frame to every call. So the scorers are instances of this type,
+ * which provides vectorcall, a docstring and a __dict__ for the attributes.
+ *
+ * PyPy does not support vectorcall in cpyext, so there the arguments are
+ * converted inside tp_call instead.
+ */
+
+#if PY_VERSION_HEX >= 0x03090000
+#    define JW_TPFLAGS_HAVE_VECTORCALL Py_TPFLAGS_HAVE_VECTORCALL
+#else
+#    define JW_TPFLAGS_HAVE_VECTORCALL _Py_TPFLAGS_HAVE_VECTORCALL
+#endif
+
+#if defined(PYPY_VERSION)
+#    define JW_USE_VECTORCALL 0
+#else
+#    define JW_USE_VECTORCALL 1
+#endif
+
+typedef PyObject* (*ScorerImpl)(PyObject* const* args, Py_ssize_t nargs, PyObject* kwnames);
+
+struct ScorerFunction {
+    PyObject_HEAD
+#if JW_USE_VECTORCALL
+    vectorcallfunc vectorcall;
+#endif
+    PyObject* dict;
+    const char* name;
+    const char* doc;
+    ScorerImpl impl;
+};
+
+/**
+ * @brief keyword aware argument parser for the fastcall calling convention
+ *
+ * The first `positional` names can be passed positionally or as keyword,
+ * the remaining names are keyword only. The first `required` names have to be
+ * provided. Arguments which are not passed are set to nullptr.
+ */
+struct ArgParser {
+    const char* fname;
+    const char* const* names;
+    Py_ssize_t count;
+    Py_ssize_t positional;
+    Py_ssize_t required;
+};
+
+static inline int parse_args(const ArgParser& parser, PyObject* const* args, Py_ssize_t nargs, PyObject* kwnames,
+                             PyObject** out)
+{
+    if (nargs > parser.positional) {
+        PyErr_Format(PyExc_TypeError, "%s() takes at most %zd positional arguments (%zd given)", parser.fname,
+                     parser.positional, nargs);
+        return -1;
+    }
+
+    for (Py_ssize_t i = 0; i < parser.count; ++i)
+        out[i] = (i < nargs) ? args[i] : nullptr;
+
+    Py_ssize_t nkwargs = kwnames ? PyTuple_GET_SIZE(kwnames) : 0;
+    for (Py_ssize_t k = 0; k < nkwargs; ++k) {
+        PyObject* key = PyTuple_GET_ITEM(kwnames, k);
+        Py_ssize_t i = 0;
+        for (; i < parser.count; ++i)
+            if (PyUnicode_CompareWithASCIIString(key, parser.names[i]) == 0) break;
+
+        if (i == parser.count) {
+            PyErr_Format(PyExc_TypeError, "%s() got an unexpected keyword argument '%U'", parser.fname, key);
+            return -1;
+        }
+        if (out[i]) {
+            PyErr_Format(PyExc_TypeError, "%s() got multiple values for argument '%s'", parser.fname,
+                         parser.names[i]);
+            return -1;
+        }
+        out[i] = args[nargs + k];
+    }
+
+    for (Py_ssize_t i = 0; i < parser.required; ++i) {
+        if (!out[i]) {
+            PyErr_Format(PyExc_TypeError, "%s() missing required argument '%s' (pos %zd)", parser.fname,
+                         parser.names[i], i + 1);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+#if JW_USE_VECTORCALL
+static PyObject* ScorerFunction_vectorcall(PyObject* self, PyObject* const* args, size_t nargsf, PyObject* kwnames)
+{
+    StatsScope stats_scope;
+    return reinterpret_cast<ScorerFunction*>(self)->impl(args, PyVectorcall_NARGS(nargsf), kwnames);
+}
+#endif
+
+static PyObject* ScorerFunction_call(PyObject* self, PyObject* args, PyObject* kwargs)
+{
+    Py_ssize_t nargs = PyTuple_GET_SIZE(args);
+    Py_ssize_t nkwargs = kwargs ? PyDict_GET_SIZE(kwargs) : 0;
+    Py_ssize_t count = nargs + nkwargs;
+
+    /* convert to the fastcall calling convention */
+    PyObject* small_stack[8];
+    PyObject** stack = small_stack;
+    if (count > 8) {
+        stack = static_cast<PyObject**>(PyMem_Malloc(static_cast<size_t>(count) * sizeof(PyObject*)));
+        if (!stack) return PyErr_NoMemory();
+    }
+
+    for (Py_ssize_t i = 0; i < nargs; ++i)
+        stack[i] = PyTuple_GET_ITEM(args, i);
+
+    PyObjectRef kwnames;
+    if (nkwargs) {
+        kwnames = PyObjectRef(PyTuple_New(nkwargs));
+        if (!kwnames) {
+            if (stack != small_stack) PyMem_Free(stack);
+            return nullptr;
+        }
+
+        Py_ssize_t pos = 0;
+        Py_ssize_t k = 0;
+        PyObject* key;
+        PyObject* value;
+        while (PyDict_Next(kwargs, &pos, &key, &value)) {
+            Py_INCREF(key);
+            PyTuple_SET_ITEM(kwnames.get(), k, key);
+            stack[nargs + k] = value;
+            ++k;
+        }
+    }
+
+    StatsScope stats_scope;
+    PyObject* result = reinterpret_cast<ScorerFunction*>(self)->impl(stack, nargs, kwnames.get());
+    if (stack != small_stack) PyMem_Free(stack);
+    return result;
+}
+
+static int ScorerFunction_traverse(PyObject* self, visitproc visit, void* arg)
+{
+    Py_VISIT(reinterpret_cast<ScorerFunction*>(self)->dict);
+    return 0;
+}
+
+static int ScorerFunction_clear(PyObject* self)
+{
+    Py_CLEAR(reinterpret_cast<ScorerFunction*>(self)->dict);
+    return 0;
+}
+
+static void ScorerFunction_dealloc(PyObject* self)
+{
+    PyObject_GC_UnTrack(self);
+    ScorerFunction_clear(self);
+    Py_TYPE(self)->tp_free(self);
+}
+
+static PyObject* ScorerFunction_repr(PyObject* self)
+{
+    return PyUnicode_FromFormat("<scorer function %s>", reinterpret_cast<ScorerFunction*>(self)->name);
+}
+
+static PyObject* ScorerFunction_get_name(PyObject* self, void*)
+{
+    return PyUnicode_FromString(reinterpret_cast<ScorerFunction*>(self)->name);
+}
+
+static PyObject* ScorerFunction_get_doc(PyObject* self, void*)
+{
+    const char* doc = reinterpret_cast<ScorerFunction*>(self)->doc;
+    if (!doc) Py_RETURN_NONE;
+    return PyUnicode_FromString(doc);
+}
+
+/* pickle as a reference to the module level function */
+static PyObject* ScorerFunction_reduce(PyObject* self, PyObject*)
+{
+    return ScorerFunction_get_name(self, nullptr);
+}
+
+static PyGetSetDef ScorerFunction_getset[] = {
+    {"__name__", ScorerFunction_get_name, nullptr, nullptr, nullptr},
+    {"__qualname__", ScorerFunction_get_name, nullptr, nullptr, nullptr},
+    {"__doc__", ScorerFunction_get_doc, nullptr, nullptr, nullptr},
+    {"__dict__", PyObject_GenericGetDict, PyObject_GenericSetDict, nullptr, nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}};
+
+static PyMethodDef ScorerFunction_methods[] = {
+    {"__reduce__", ScorerFunction_reduce, METH_NOARGS, nullptr},
+    {nullptr, nullptr, 0, nullptr}};
+
+/* the slots are filled in ScorerFunctionType_ready, since the layout of
+ * PyTypeObject differs between Python versions */
+#if defined(__GNUC__)
+#    pragma GCC diagnostic push
+#    pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+#endif
+static PyTypeObject ScorerFunctionType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+#if defined(__GNUC__)
+#    pragma GCC diagnostic pop
+#endif
+
+static int ScorerFunctionType_ready()
+{
+    ScorerFunctionType.tp_name = "jarowinkler._initialize_cpp.ScorerFunction";
+    ScorerFunctionType.tp_basicsize = sizeof(ScorerFunction);
+    ScorerFunctionType.tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC;
+#if JW_USE_VECTORCALL
+    ScorerFunctionType.tp_flags |= JW_TPFLAGS_HAVE_VECTORCALL;
+    ScorerFunctionType.tp_vectorcall_offset = offsetof(ScorerFunction, vectorcall);
+#endif
+    ScorerFunctionType.tp_dictoffset = offsetof(ScorerFunction, dict);
+    ScorerFunctionType.tp_call = ScorerFunction_call;
+    ScorerFunctionType.tp_repr = ScorerFunction_repr;
+    ScorerFunctionType.tp_traverse = ScorerFunction_traverse;
+    ScorerFunctionType.tp_clear = ScorerFunction_clear;
+    ScorerFunctionType.tp_dealloc = ScorerFunction_dealloc;
+    ScorerFunctionType.tp_getset = ScorerFunction_getset;
+    ScorerFunctionType.tp_methods = ScorerFunction_methods;
+    return PyType_Ready(&ScorerFunctionType);
+}
+
+/**
+ * @brief creates a new scorer function and adds it to the module
+ */
+static PyObject* add_scorer_function(PyObject* module, const char* name, const char* doc, ScorerImpl impl)
+{
+    ScorerFunction* func = PyObject_GC_New(ScorerFunction, &ScorerFunctionType);
+    if (!func) return nullptr;
+
+#if JW_USE_VECTORCALL
+    func->vectorcall = ScorerFunction_vectorcall;
+#endif
+    func->dict = nullptr;
+    func->name = name;
+    func->doc = doc;
+    func->impl = impl;
+    PyObject_GC_Track(func);
+
+    PyObject* obj = reinterpret_cast<PyObject*>(func);
+    /* the scorers are exported from the jarowinkler package, which allows pickling them by reference */
+    PyObjectRef module_name(PyUnicode_FromString("jarowinkler"));
+    if (!module_name || PyObject_SetAttrString(obj, "__module__", module_name.get()) < 0) {
+        Py_DECREF(obj);
+        return nullptr;
+    }
+
+    if (PyModule_AddObject(module, name, obj) < 0) {
+        Py_DECREF(obj);
+        return nullptr;
+    }
+    return obj;
+}
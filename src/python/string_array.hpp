@@ -0,0 +1,271 @@
+/* SPDX-License-Identifier: MIT */
+/* Copyright © 2022-present Max Bachmann */
+
+#pragma once
+
+#include "cpp_common.hpp"
+#include "processor.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+/*
+ * Zero-copy access to columns of strings, which are not stored as Python objects:
+ *  - Arrow arrays of the types utf8, large_utf8, binary and large_binary exported through
+ *    the Arrow PyCapsule interface (`__arrow_c_array__`). No Arrow library is required.
+ *  - NumPy arrays with the dtype S (bytes) or U (UCS4) exported through the buffer protocol.
+ *
+ * The strings point directly into the memory of the array. Only UTF-8 strings with
+ * non ASCII characters are decoded into a temporary buffer.
+ */
+
+/* Arrow C data interface (https://arrow.apache.org/docs/format/CDataInterface.html) */
+struct ArrowSchema {
+    const char* format;
+    const char* name;
+    const char* metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema** children;
+    struct ArrowSchema* dictionary;
+    void (*release)(struct ArrowSchema*);
+    void* private_data;
+};
+
+struct ArrowArray {
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void** buffers;
+    struct ArrowArray** children;
+    struct ArrowArray* dictionary;
+    void (*release)(struct ArrowArray*);
+    void* private_data;
+};
+
+/**
+ * @brief keeps the memory of an Arrow or NumPy array alive. The strings created
+ * by conv_string_array point into it, so it has to outlive them
+ */
+class StringArrayOwner {
+public:
+    StringArrayOwner() : m_view(), m_has_view(false)
+    {}
+
+    StringArrayOwner(const StringArrayOwner&) = delete;
+    StringArrayOwner& operator=(const StringArrayOwner&) = delete;
+
+    ~StringArrayOwner()
+    {
+        if (m_has_view) PyBuffer_Release(&m_view);
+    }
+
+    Py_buffer* acquire_buffer(PyObject* obj)
+    {
+        if (PyObject_GetBuffer(obj, &m_view, PyBUF_STRIDES | PyBUF_FORMAT) < 0) return nullptr;
+        m_has_view = true;
+        return &m_view;
+    }
+
+    /* the capsules own the exported structs and release them when they are destroyed */
+    PyObjectRef arrow_capsules;
+
+private:
+    Py_buffer m_view;
+    bool m_has_view;
+};
+
+/* used for empty strings, since a string without data marks None */
+static const uint8_t g_empty_string[1] = {0};
+
+static inline RF_StringWrapper string_view(RF_StringType kind, const void* data, int64_t length)
+{
+    /* the strings are never modified, RF_String just does not use a const pointer */
+    RF_String str = {nullptr, kind, const_cast<void*>(length ? data : g_empty_string), length, nullptr};
+    return RF_StringWrapper(str, PyObjectRef());
+}
+
+/**
+ * @brief converts a UTF-8 string. ASCII strings are used in place, while all other
+ * strings are decoded into the smallest character type holding all of their characters
+ */
+static inline RF_StringWrapper conv_utf8(const uint8_t* data, int64_t length)
+{
+    int64_t i = 0;
+    while (i < length && data[i] < 0x80)
+        ++i;
+    if (i == length) return string_view(RF_UINT8, data, length);
+
+    std::vector<uint32_t> chars;
+    chars.reserve(static_cast<size_t>(length));
+    for (i = 0; i < length;) {
+        uint32_t ch = data[i];
+        int extra = (ch >= 0xF0) ? 3 : (ch >= 0xE0) ? 2 : (ch >= 0xC0) ? 1 : 0;
+        ch &= (extra == 3) ? 0x07 : (extra == 2) ? 0x0F : (extra == 1) ? 0x1F : 0x7F;
+        for (++i; extra > 0 && i < length; --extra, ++i)
+            ch = (ch << 6) | (data[i] & 0x3F);
+
+        chars.push_back(ch);
+    }
+    return conv_code_points(chars);
+}
+
+template <typename OffsetT>
+static inline void conv_arrow_strings(const ArrowArray& array, bool utf8, std::vector<RF_StringWrapper>& strings)
+{
+    const uint8_t* validity = static_cast<const uint8_t*>(array.buffers[0]);
+    const OffsetT* offsets = static_cast<const OffsetT*>(array.buffers[1]);
+    const uint8_t* data = static_cast<const uint8_t*>(array.buffers[2]);
+
+    strings.reserve(static_cast<size_t>(array.length));
+    for (int64_t i = 0; i < array.length; ++i) {
+        int64_t pos = array.offset + i;
+        if (validity && !((validity[pos / 8] >> (pos % 8)) & 1)) {
+            strings.emplace_back();
+            continue;
+        }
+
+        const uint8_t* first = data ? data + offsets[pos] : g_empty_string;
+        int64_t length = static_cast<int64_t>(offsets[pos + 1] - offsets[pos]);
+        strings.push_back(utf8 ? conv_utf8(first, length) : string_view(RF_UINT8, first, length));
+    }
+}
+
+/**
+ * @brief converts an object implementing the Arrow PyCapsule interface
+ *
+ * @return false when obj is not an Arrow array of strings or binaries
+ */
+static inline bool conv_arrow_array(PyObject* obj, StringArrayOwner& owner, std::vector<RF_StringWrapper>& strings)
+{
+    owner.arrow_capsules = PyObjectRef(PyObject_CallMethod(obj, "__arrow_c_array__", nullptr));
+    if (!owner.arrow_capsules) throw PythonError();
+    if (!PyTuple_Check(owner.arrow_capsules.get()) || PyTuple_GET_SIZE(owner.arrow_capsules.get()) != 2)
+        throw std::invalid_argument("__arrow_c_array__ has to return a tuple of two capsules");
+
+    auto schema = static_cast<const ArrowSchema*>(
+        PyCapsule_GetPointer(PyTuple_GET_ITEM(owner.arrow_capsules.get(), 0), "arrow_schema"));
+    if (!schema) throw PythonError();
+    auto array = static_cast<const ArrowArray*>(
+        PyCapsule_GetPointer(PyTuple_GET_ITEM(owner.arrow_capsules.get(), 1), "arrow_array"));
+    if (!array) throw PythonError();
+
+    const char* format = schema->format;
+    if (!strcmp(format, "u") || !strcmp(format, "z"))
+        conv_arrow_strings<int32_t>(*array, format[0] == 'u', strings);
+    else if (!strcmp(format, "U") || !strcmp(format, "Z"))
+        conv_arrow_strings<int64_t>(*array, format[0] == 'U', strings);
+    else
+        return false;
+
+    return true;
+}
+
+/**
+ * @brief parses the buffer format of a NumPy array with the dtype S or U
+ *
+ * @return the character type or -1 when the format is not supported
+ */
+static inline int parse_numpy_format(const char* format)
+{
+    if (!format) return -1;
+
+    bool native = true;
+    if (*format == '@' || *format == '=') {
+        ++format;
+    }
+    else if (*format == '<' || *format == '>' || *format == '!') {
+#if PY_LITTLE_ENDIAN
+        native = *format == '<';
+#else
+        native = *format != '<';
+#endif
+        ++format;
+    }
+
+    while (*format >= '0' && *format <= '9')
+        ++format;
+
+    if (!strcmp(format, "s")) return RF_UINT8;
+    /* the byte order of UCS4 characters has to match the native one */
+    if (!strcmp(format, "w") && native) return RF_UINT32;
+    return -1;
+}
+
+/**
+ * @brief converts a one dimensional NumPy array with the dtype S or U. The strings
+ * are padded with zeros to the size of the dtype, which are removed like NumPy does
+ *
+ * @return false when obj is not such an array
+ */
+static inline bool conv_numpy_array(PyObject* obj, StringArrayOwner& owner, std::vector<RF_StringWrapper>& strings)
+{
+    Py_buffer* view = owner.acquire_buffer(obj);
+    if (!view) {
+        PyErr_Clear();
+        return false;
+    }
+
+    int kind = parse_numpy_format(view->format);
+    if (view->ndim != 1 || kind < 0) return false;
+
+    const char* data = static_cast<const char*>(view->buf);
+    strings.reserve(static_cast<size_t>(view->shape[0]));
+    for (Py_ssize_t i = 0; i < view->shape[0]; ++i) {
+        const char* item = data + i * view->strides[0];
+        if (kind == RF_UINT8) {
+            const uint8_t* chars = reinterpret_cast<const uint8_t*>(item);
+            int64_t length = static_cast<int64_t>(view->itemsize);
+            while (length && !chars[length - 1])
+                --length;
+            strings.push_back(string_view(RF_UINT8, chars, length));
+        }
+        else {
+            const uint32_t* chars = reinterpret_cast<const uint32_t*>(item);
+            int64_t length = static_cast<int64_t>(view->itemsize) / 4;
+            while (length && !chars[length - 1])
+                --length;
+            strings.push_back(string_view(RF_UINT32, chars, length));
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief converts an Arrow or NumPy string array without creating Python objects
+ *
+ * @return false when obj is neither of them, so it has to be converted as sequence
+ */
+static inline bool conv_string_array(PyObject* obj, StringArrayOwner& owner, std::vector<RF_StringWrapper>& strings)
+{
+    if (PyUnicode_Check(obj) || PyBytes_Check(obj) || PyByteArray_Check(obj)) return false;
+
+    if (PyObject_HasAttrString(obj, "__arrow_c_array__")) return conv_arrow_array(obj, owner, strings);
+    if (PyObject_CheckBuffer(obj)) return conv_numpy_array(obj, owner, strings);
+    return false;
+}
+
+/**
+ * @brief converts the choices of a batch function. Arrow and NumPy string arrays are read in
+ * place when no processor or a native processor is used, while all other objects are converted
+ * as sequence
+ */
+static inline std::vector<RF_StringWrapper> conv_choices(PyObject* obj, PyObject* processor, const char* err_msg,
+                                                         StringArrayOwner& owner)
+{
+    const NativeProcessor* native = get_native_processor(processor);
+    if (processor != Py_None && !native) return conv_sequences(obj, processor, err_msg);
+
+    std::vector<RF_StringWrapper> strings;
+    if (!conv_string_array(obj, owner, strings)) return conv_sequences(obj, processor, err_msg);
+
+    if (native)
+        for (auto& str : strings)
+            if (!str.is_none()) str = native->apply(str.string);
+    return strings;
+}
@@ -0,0 +1,142 @@
+/* SPDX-License-Identifier: MIT */
+/* Copyright © 2022-present Max Bachmann */
+
+#pragma once
+
+#include "cpp_common.hpp"
+#include "parallel.hpp"
+
+/*
+ * Python class owning a ThreadPool, which can be passed as workers to share the
+ * threads between calls, e.g. between the concurrent requests of a service.
+ */
+
+struct PyThreadPool {
+    PyObject_HEAD
+    ThreadPool* pool;
+};
+
+/* the slots are filled in ThreadPoolType_ready, since the layout of
+ * PyTypeObject differs between Python versions */
+#if defined(__GNUC__)
+#    pragma GCC diagnostic push
+#    pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+#endif
+static PyTypeObject ThreadPoolType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+#if defined(__GNUC__)
+#    pragma GCC diagnostic pop
+#endif
+
+/**
+ * @brief the ThreadPool of a jarowinkler.ThreadPool or nullptr for any other object
+ */
+static inline ThreadPool* get_thread_pool(PyObject* obj)
+{
+    if (!obj || !PyObject_TypeCheck(obj, &ThreadPoolType)) return nullptr;
+    return reinterpret_cast<PyThreadPool*>(obj)->pool;
+}
+
+PyDoc_STRVAR(ThreadPool_doc, R"(ThreadPool(workers=-1)
+--
+
+Threads which are kept alive between calls. It can be passed as ``workers`` to ``cdist``.
+Calls sharing a pool split their work between the same threads, so concurrent calls do
+not use more cores than the pool holds. The calling thread takes part in its own call.
+
+The work of a call is split into contiguous ranges, one per thread. A thread running
+out of work steals half of the largest remaining range, so strings of very different
+lengths are balanced between the threads.
+
+Parameters
+----------
+workers : int, optional
+    Number of threads including the calling thread. -1 uses all available cores.
+    Default is -1.
+)");
+
+static PyObject* ThreadPool_new(PyTypeObject* type, PyObject* args, PyObject* kwargs)
+{
+    long long workers = -1;
+    static const char* kwlist[] = {"workers", nullptr};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|L:ThreadPool", const_cast<char**>(kwlist), &workers))
+        return nullptr;
+
+    PyObjectRef obj(type->tp_alloc(type, 0));
+    if (!obj) return nullptr;
+
+    try {
+        reinterpret_cast<PyThreadPool*>(obj.get())->pool = new ThreadPool(resolve_workers(workers));
+    }
+    catch (...) {
+        CppExn2PyErr();
+        return nullptr;
+    }
+    return obj.release();
+}
+
+static void ThreadPool_dealloc(PyObject* self)
+{
+    /* running calls hold a reference, so no work is left and the threads stop right away */
+    delete reinterpret_cast<PyThreadPool*>(self)->pool;
+    Py_TYPE(self)->tp_free(self);
+}
+
+static PyObject* ThreadPool_close(PyObject* self, PyObject*)
+{
+    ThreadPool* pool = reinterpret_cast<PyThreadPool*>(self)->pool;
+    {
+        /* the threads finish the calls which are still running first */
+        GilRelease gil;
+        pool->shutdown();
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* ThreadPool_enter(PyObject* self, PyObject*)
+{
+    Py_INCREF(self);
+    return self;
+}
+
+static PyObject* ThreadPool_exit(PyObject* self, PyObject*)
+{
+    return ThreadPool_close(self, nullptr);
+}
+
+static PyObject* ThreadPool_repr(PyObject* self)
+{
+    size_t workers = reinterpret_cast<PyThreadPool*>(self)->pool->workers();
+    return PyUnicode_FromFormat("ThreadPool(workers=%zu)", workers);
+}
+
+static PyObject* ThreadPool_get_workers(PyObject* self, void*)
+{
+    return PyLong_FromSize_t(reinterpret_cast<PyThreadPool*>(self)->pool->workers());
+}
+
+static PyMethodDef ThreadPool_methods[] = {
+    {"close", ThreadPool_close, METH_NOARGS,
+     "close($self)\n--\n\n"
+     "Stops the threads once the running calls are finished. Later calls run on the calling thread."},
+    {"__enter__", ThreadPool_enter, METH_NOARGS, nullptr},
+    {"__exit__", ThreadPool_exit, METH_VARARGS, nullptr},
+    {nullptr, nullptr, 0, nullptr}};
+
+static PyGetSetDef ThreadPool_getset[] = {
+    {"workers", ThreadPool_get_workers, nullptr, "number of threads including the calling thread", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}};
+
+static int ThreadPoolType_ready()
+{
+    PyTypeObject* type = &ThreadPoolType;
+    type->tp_name = "jarowinkler.ThreadPool";
+    type->tp_doc = ThreadPool_doc;
+    type->tp_basicsize = sizeof(PyThreadPool);
+    type->tp_flags = Py_TPFLAGS_DEFAULT;
+    type->tp_new = ThreadPool_new;
+    type->tp_dealloc = ThreadPool_dealloc;
+    type->tp_repr = ThreadPool_repr;
+    type->tp_methods = ThreadPool_methods;
+    type->tp_getset = ThreadPool_getset;
+    return PyType_Ready(type);
+}
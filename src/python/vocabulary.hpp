@@ -0,0 +1,301 @@
+/* SPDX-License-Identifier: MIT */
+/* Copyright © 2022-present Max Bachmann */
+
+#pragma once
+
+#include "corpus.hpp"
+#include "cpp_common.hpp"
+#include "scorer_function.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+/*
+ * TokenVocabulary interns tokens to dense integer ids. Tokenised sequences are encoded once
+ * into a PreprocessedCorpus, which stores the ids of all sequences in one flat arena with
+ * offsets. Comparing them hashes no Python object, since only the ids are compared.
+ */
+
+/**
+ * @brief id of a token. Tokens seen for the first time receive the next free id
+ */
+static inline uint32_t TokenVocabulary_intern(TokenVocabulary* self, PyObject* token)
+{
+    PyObject* id = PyDict_GetItemWithError(self->ids, token);
+    if (id) return static_cast<uint32_t>(PyLong_AsUnsignedLong(id));
+    if (PyErr_Occurred()) throw PythonError();
+
+    Py_ssize_t next = PyList_GET_SIZE(self->tokens);
+    if (static_cast<uint64_t>(next) >= UINT32_MAX)
+        throw std::overflow_error("TokenVocabulary can hold at most 2^32 - 1 tokens");
+
+    PyObjectRef py_id(PyLong_FromSsize_t(next));
+    if (!py_id) throw PythonError();
+    if (PyDict_SetItem(self->ids, token, py_id.get()) < 0) throw PythonError();
+    if (PyList_Append(self->tokens, token) < 0) throw PythonError();
+    return static_cast<uint32_t>(next);
+}
+
+/**
+ * @brief splits obj into tokens. str is split at whitespace like str.split() unless a
+ * tokenizer is passed, while all other objects are already sequences of tokens
+ */
+static inline PyObjectRef TokenVocabulary_tokenize(PyObject* tokenizer, PyObject* obj)
+{
+    PyObjectRef tokens;
+    if (tokenizer != Py_None)
+        tokens = PyObjectRef(PyObject_CallFunctionObjArgs(tokenizer, obj, nullptr));
+    else if (PyUnicode_Check(obj))
+        tokens = PyObjectRef(PyUnicode_Split(obj, nullptr, -1));
+    else
+        tokens = PyObjectRef::borrow(obj);
+    if (!tokens) throw PythonError();
+
+    PyObjectRef seq(PySequence_Fast(tokens.get(), "tokens have to be a str or a sequence of hashable objects"));
+    if (!seq) throw PythonError();
+    return seq;
+}
+
+/**
+ * @brief encodes the elements of strings into arena. ids is reused between the elements
+ */
+static inline void TokenVocabulary_encode_into(TokenVocabulary* self, PyObject* tokenizer, PyObject* strings,
+                                               StringArena& arena)
+{
+    /* ids and tokens of the vocabulary are only modified while it is locked */
+    CriticalSection section(reinterpret_cast<PyObject*>(self));
+    std::vector<uint32_t> ids;
+    for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(strings); ++i) {
+        PyObject* item = PyTuple_GET_ITEM(strings, i);
+        if (item == Py_None) {
+            arena.add_none();
+            continue;
+        }
+
+        PyObjectRef tokens = TokenVocabulary_tokenize(tokenizer, item);
+        CriticalSection tokens_section(tokens.get());
+        ids.clear();
+        for (Py_ssize_t j = 0; j < PySequence_Fast_GET_SIZE(tokens.get()); ++j)
+            ids.push_back(TokenVocabulary_intern(self, PySequence_Fast_GET_ITEM(tokens.get(), j)));
+
+        arena.add(conv_code_points(ids).string);
+    }
+}
+
+/**
+ * @brief encodes strings into a PreprocessedCorpus. Returns a new reference or nullptr
+ * with a Python exception set
+ */
+static PyObject* TokenVocabulary_encode_tuple(PyObject* self, PyObject* tokenizer, PyObject* strings)
+{
+    try {
+        std::unique_ptr<StringArena> arena(new StringArena());
+        TokenVocabulary_encode_into(reinterpret_cast<TokenVocabulary*>(self), tokenizer, strings, *arena);
+        return PreprocessedCorpus_create(strings, self, std::move(arena));
+    }
+    catch (...) {
+        CppExn2PyErr();
+        return nullptr;
+    }
+}
+
+static PyObject* TokenVocabulary_encode(PyObject* self, PyObject* const* args, Py_ssize_t nargs, PyObject* kwnames)
+{
+    static const char* const names[] = {"tokens", "tokenizer"};
+    static const ArgParser parser = {"encode", names, 2, 1, 1};
+    PyObject* argv[2];
+    if (parse_args(parser, args, nargs, kwnames, argv) < 0) return nullptr;
+
+    PyObjectRef strings(PyTuple_Pack(1, argv[0]));
+    if (!strings) return nullptr;
+
+    PyObjectRef corpus(TokenVocabulary_encode_tuple(self, argv[1] ? argv[1] : Py_None, strings.get()));
+    if (!corpus) return nullptr;
+    return PreprocessedCorpus_item(corpus.get(), 0);
+}
+
+static PyObject* TokenVocabulary_encode_corpus(PyObject* self, PyObject* const* args, Py_ssize_t nargs,
+                                               PyObject* kwnames)
+{
+    static const char* const names[] = {"sequences", "tokenizer"};
+    static const ArgParser parser = {"encode_corpus", names, 2, 1, 1};
+    PyObject* argv[2];
+    if (parse_args(parser, args, nargs, kwnames, argv) < 0) return nullptr;
+
+    PyObjectRef strings(PySequence_Tuple(argv[0]));
+    if (!strings) return nullptr;
+    return TokenVocabulary_encode_tuple(self, argv[1] ? argv[1] : Py_None, strings.get());
+}
+
+PyDoc_STRVAR(TokenVocabulary_doc, R"(TokenVocabulary(tokens=())
+--
+
+Interns tokens to dense integer ids, so sequences of tokens (e.g. the words of a
+sentence) are compared without hashing the tokens in every comparison. Each token
+receives the next free id when it is encoded for the first time.
+
+The encoded sequences are accepted by all functions of this module. They should only
+be compared with sequences encoded by the same vocabulary.
+
+Parameters
+----------
+tokens : Iterable[Hashable], optional
+    tokens which receive the ids 0, 1, ... in this order
+
+Examples
+--------
+>>> vocabulary = TokenVocabulary()
+>>> corpus = vocabulary.encode_corpus(["this is an example", "this is a test"])
+>>> jarowinkler_similarity_many(vocabulary.encode("this is a example"), corpus)
+[0.8666666666666667, 0.8833333333333334]
+)");
+
+PyDoc_STRVAR(TokenVocabulary_encode_doc, R"(encode($self, tokens, *, tokenizer=None)
+--
+
+Encodes one sequence of tokens.
+
+Parameters
+----------
+tokens : str | Sequence[Hashable] | None
+    str is split at whitespace like ``str.split()``, while other
+    sequences are used as tokens.
+tokenizer : Callable, optional
+    Called with ``tokens`` to split them into tokens.
+
+Returns
+-------
+encoded : PreprocessedString | None
+    The token ids. Its elements are the tokens and ``original`` is ``tokens``.
+)");
+
+PyDoc_STRVAR(TokenVocabulary_encode_corpus_doc, R"(encode_corpus($self, sequences, *, tokenizer=None)
+--
+
+Encodes a list of token sequences into one flat array of token ids.
+
+Parameters
+----------
+sequences : Sequence[str | Sequence[Hashable] | None]
+    sequences encoded like in ``encode``. None is kept as None.
+tokenizer : Callable, optional
+    Called with every sequence to split it into tokens.
+
+Returns
+-------
+corpus : PreprocessedCorpus
+    The encoded sequences. ``strings`` holds ``sequences`` and ``processor``
+    the vocabulary.
+)");
+
+static PyObject* TokenVocabulary_new(PyTypeObject* type, PyObject* args, PyObject* kwargs)
+{
+    PyObject* tokens = nullptr;
+    static const char* kwlist[] = {"tokens", nullptr};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O:TokenVocabulary", const_cast<char**>(kwlist), &tokens))
+        return nullptr;
+
+    PyObjectRef obj(type->tp_alloc(type, 0));
+    if (!obj) return nullptr;
+
+    TokenVocabulary* self = reinterpret_cast<TokenVocabulary*>(obj.get());
+    self->ids = PyDict_New();
+    self->tokens = PyList_New(0);
+    if (!self->ids || !self->tokens) return nullptr;
+    if (!tokens) return obj.release();
+
+    try {
+        PyObjectRef seq(PySequence_Fast(tokens, "tokens has to be an iterable of hashable objects"));
+        if (!seq) throw PythonError();
+        for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(seq.get()); ++i)
+            TokenVocabulary_intern(self, PySequence_Fast_GET_ITEM(seq.get(), i));
+    }
+    catch (...) {
+        CppExn2PyErr();
+        return nullptr;
+    }
+    return obj.release();
+}
+
+static Py_ssize_t TokenVocabulary_length(PyObject* self)
+{
+    return PyList_GET_SIZE(reinterpret_cast<TokenVocabulary*>(self)->tokens);
+}
+
+static int TokenVocabulary_contains(PyObject* self, PyObject* token)
+{
+    return PyDict_Contains(reinterpret_cast<TokenVocabulary*>(self)->ids, token);
+}
+
+static int TokenVocabulary_traverse(PyObject* self, visitproc visit, void* arg)
+{
+    Py_VISIT(reinterpret_cast<TokenVocabulary*>(self)->ids);
+    Py_VISIT(reinterpret_cast<TokenVocabulary*>(self)->tokens);
+    return 0;
+}
+
+static int TokenVocabulary_clear(PyObject* self)
+{
+    Py_CLEAR(reinterpret_cast<TokenVocabulary*>(self)->ids);
+    Py_CLEAR(reinterpret_cast<TokenVocabulary*>(self)->tokens);
+    return 0;
+}
+
+static void TokenVocabulary_dealloc(PyObject* self)
+{
+    PyObject_GC_UnTrack(self);
+    TokenVocabulary_clear(self);
+    Py_TYPE(self)->tp_free(self);
+}
+
+static PyObject* TokenVocabulary_repr(PyObject* self)
+{
+    return PyUnicode_FromFormat("<TokenVocabulary of %zd tokens>", TokenVocabulary_length(self));
+}
+
+static PyObject* TokenVocabulary_get_tokens(PyObject* self, void*)
+{
+    return PyList_AsTuple(reinterpret_cast<TokenVocabulary*>(self)->tokens);
+}
+
+static PyMethodDef TokenVocabulary_methods[] = {
+    {"encode", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(TokenVocabulary_encode)),
+     METH_FASTCALL | METH_KEYWORDS, TokenVocabulary_encode_doc},
+    {"encode_corpus", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(TokenVocabulary_encode_corpus)),
+     METH_FASTCALL | METH_KEYWORDS, TokenVocabulary_encode_corpus_doc},
+    {nullptr, nullptr, 0, nullptr}};
+
+static PyGetSetDef TokenVocabulary_getset[] = {
+    {"tokens", TokenVocabulary_get_tokens, nullptr, "tuple of the tokens indexed by their id", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}};
+
+#if defined(__GNUC__)
+#    pragma GCC diagnostic push
+#    pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+#endif
+static PySequenceMethods TokenVocabulary_as_sequence = {};
+#if defined(__GNUC__)
+#    pragma GCC diagnostic pop
+#endif
+
+static int TokenVocabularyType_ready()
+{
+    PyTypeObject* type = &TokenVocabularyType;
+    type->tp_name = "jarowinkler.TokenVocabulary";
+    type->tp_doc = TokenVocabulary_doc;
+    type->tp_basicsize = sizeof(TokenVocabulary);
+    type->tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC;
+    type->tp_new = TokenVocabulary_new;
+    type->tp_traverse = TokenVocabulary_traverse;
+    type->tp_clear = TokenVocabulary_clear;
+    type->tp_dealloc = TokenVocabulary_dealloc;
+    type->tp_repr = TokenVocabulary_repr;
+    type->tp_methods = TokenVocabulary_methods;
+    type->tp_getset = TokenVocabulary_getset;
+    TokenVocabulary_as_sequence.sq_length = TokenVocabulary_length;
+    TokenVocabulary_as_sequence.sq_contains = TokenVocabulary_contains;
+    type->tp_as_sequence = &TokenVocabulary_as_sequence;
+    return PyType_Ready(type);
+}
@@ -1,10 +1,11 @@
 #!/usr/bin/env python
 # -*- coding: utf-8 -*-
 
+import pickle
 import unittest
 import pytest
 
-from jarowinkler import jarowinkler_similarity
+from jarowinkler import jaro_similarity, jarowinkler_similarity
 
 
 class JaroWinklerTest(unittest.TestCase):
@@ -37,6 +38,33 @@ class JaroWinklerTest(unittest.TestCase):
         s2 = "01000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
         self._jaro_winkler_similarity(s2, s1, 0.85234)
 
+    def test_keyword_arguments(self):
+        self.assertAlmostEqual(jarowinkler_similarity(s1="Johnathan", s2="Jonathan"), 0.90370, places=4)
+        self.assertAlmostEqual(
+            jarowinkler_similarity("Johnathan", "Jonathan", prefix_weight=0.2), 0.92778, places=4
+        )
+        self.assertEqual(jaro_similarity("Johnathan", "Jonathan", score_cutoff=0.9), 0)
+        self.assertEqual(jarowinkler_similarity("ABC", "abc", processor=str.lower), 1)
+
+        with pytest.raises(TypeError):
+            jarowinkler_similarity("a")
+        with pytest.raises(TypeError):
+            jarowinkler_similarity("a", "b", 0.1)
+        with pytest.raises(TypeError):
+            jarowinkler_similarity("a", "b", weight=0.1)
+        with pytest.raises(TypeError):
+            jarowinkler_similarity("a", s1="b")
+        with pytest.raises(ValueError):
+            jarowinkler_similarity("a", "b", prefix_weight=0.3)
+
+    def test_scorer_attributes(self):
+        for scorer in (jaro_similarity, jarowinkler_similarity):
+            self.assertIs(scorer._RF_OriginalScorer, scorer)
+            self.assertIn("get_scorer_flags", scorer._RF_ScorerPy)
+            self.assertTrue(hasattr(scorer, "_RF_Scorer"))
+            self.assertTrue(scorer.__doc__)
+            self.assertIs(pickle.loads(pickle.dumps(scorer)), scorer)
+
 
 if __name__ == "__main__":
     unittest.main()
@@ -0,0 +1,116 @@
+from array import array
+
+import pytest
+
+import threading
+
+from jarowinkler import ThreadPool, cdist, jaro_similarity, jarowinkler_similarity
+
+QUERIES = ["Johnathan", "", "0" * 70, "Джон", None, ["J", "o", "n"]]
+CHOICES = ["Jonathan", "Johnathan", "", "Jon", "0" * 65, "nathan", "Джонатан", None]
+
+
+def expected_matrix(scorer, queries, choices, **kwargs):
+    return [[scorer(query, choice, **kwargs) for choice in choices] for query in queries]
+
+
+def assert_matrix_approx(result, expected, **kwargs):
+    # pytest.approx does not support nested lists, so the rows are compared one at a time
+    assert len(result) == len(expected)
+    for row, expected_row in zip(result, expected):
+        assert row == pytest.approx(expected_row, **kwargs)
+
+
+@pytest.mark.parametrize("workers", [1, 3, -1])
+@pytest.mark.parametrize("score_cutoff", [None, 0.5, 0.9])
+def test_matches_single_calls(workers, score_cutoff):
+    result = cdist(QUERIES, CHOICES, prefix_weight=0.2, score_cutoff=score_cutoff, dtype="float64", workers=workers)
+    assert result.shape == (len(QUERIES), len(CHOICES))
+    expected = expected_matrix(jarowinkler_similarity, QUERIES, CHOICES, prefix_weight=0.2, score_cutoff=score_cutoff)
+    assert_matrix_approx(result.tolist(), expected)
+
+    result = cdist(QUERIES, CHOICES, scorer=jaro_similarity, score_cutoff=score_cutoff, workers=workers)
+    expected = expected_matrix(jaro_similarity, QUERIES, CHOICES, score_cutoff=score_cutoff)
+    assert_matrix_approx(result.tolist(), expected, rel=1e-6)
+
+
+@pytest.mark.parametrize("workers", [1, 4])
+def test_symmetric(workers):
+    strings = QUERIES + CHOICES + [f"string{i}" for i in range(100)]
+    result = cdist(strings, strings, dtype="float64", workers=workers)
+    assert_matrix_approx(result.tolist(), expected_matrix(jarowinkler_similarity, strings, strings))
+
+
+def test_uneven_lengths():
+    strings = ["a" * n + "b" * (n % 7) for n in (1, 8, 512, 3, 300, 64, 65, 2, 129)] * 5
+    expected = cdist(strings, strings[::-1], dtype="float64").tolist()
+    for workers in (2, 7):
+        assert cdist(strings, strings[::-1], dtype="float64", workers=workers).tolist() == expected
+
+
+def test_thread_pool():
+    strings = QUERIES + CHOICES + [f"string{i}" * (i % 40) for i in range(200)]
+    expected = cdist(strings, CHOICES, dtype="float64").tolist()
+
+    with ThreadPool(4) as pool:
+        assert pool.workers == 4
+        assert cdist(strings, CHOICES, dtype="float64", workers=pool).tolist() == expected
+
+        # concurrent calls share the threads of the pool
+        results = []
+        threads = [
+            threading.Thread(target=lambda: results.append(cdist(strings, CHOICES, dtype="float64", workers=pool)))
+            for _ in range(4)
+        ]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        assert [result.tolist() for result in results] == [expected] * 4
+
+    # a closed pool runs the calls on the calling thread
+    assert pool.workers == 1
+    assert cdist(strings, CHOICES, dtype="float64", workers=pool).tolist() == expected
+
+    with pytest.raises(ValueError):
+        ThreadPool(0)
+
+
+def test_dtype():
+    assert cdist(["a"], ["a"]).format == "f"
+    assert cdist(["a"], ["a"], dtype="float32").format == "f"
+    assert cdist(["a"], ["a"], dtype="float64").format == "d"
+    with pytest.raises(ValueError):
+        cdist(["a"], ["a"], dtype="int32")
+
+
+def test_processor():
+    result = cdist(["JOHN"], ["john", "JANE"], processor=str.lower, dtype="float64")
+    assert_matrix_approx(result.tolist(), [[1.0, jarowinkler_similarity("john", "jane")]])
+
+
+def test_empty():
+    assert cdist([], ["a", "b"]).shape == (0, 2)
+    assert cdist(["a", "b"], []).shape == (2, 0)
+
+
+@pytest.mark.parametrize("typecode", ["f", "d"])
+def test_out_buffer(typecode):
+    out = memoryview(array(typecode, [-1.0] * 4)).cast("B").cast(typecode, [2, 2])
+    result = cdist(["Johnathan", "x"], ["Jonathan", "Johnathan"], out=out)
+    assert result is out
+    assert_matrix_approx(out.tolist(), [[0.9037037, 1.0], [0.0, 0.0]])
+
+    with pytest.raises(ValueError):
+        cdist(["a"], ["a", "b"], out=out)
+
+
+def test_invalid_arguments():
+    with pytest.raises(ValueError):
+        cdist(["a"], ["a"], workers=0)
+    with pytest.raises(ValueError):
+        cdist(["a"], ["a"], scorer=len)
+    with pytest.raises(ValueError):
+        cdist(["a"], ["a"], scorer=jaro_similarity, prefix_weight=0.1)
+    with pytest.raises(ValueError):
+        cdist(["a"], ["a"], prefix_weight=0.3)
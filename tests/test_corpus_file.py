@@ -0,0 +1,119 @@
+import struct
+import sys
+
+import pytest
+
+from jarowinkler import (
+    JaroWinklerIndex,
+    PreprocessedCorpus,
+    cdist,
+    compile_corpus,
+    extract,
+    jarowinkler_similarity_many,
+    load_corpus,
+    preprocess,
+)
+from jarowinkler import processors
+
+STRINGS = ["Johnathan", None, "JONATHAN", "", "Nathan", "ÄBC" * 30, "東京", "\U0001f600 smile", "a\udc80b"]
+
+
+@pytest.fixture
+def corpus_path(tmp_path):
+    path = tmp_path / "names.jwc"
+    compile_corpus(STRINGS, path, processors.lowercase)
+    return path
+
+
+@pytest.mark.parametrize("mmap", [True, False])
+def test_roundtrip(corpus_path, mmap):
+    expected = preprocess(STRINGS, processors.lowercase)
+    corpus = load_corpus(corpus_path, mmap=mmap)
+    assert isinstance(corpus, PreprocessedCorpus)
+    assert len(corpus) == len(STRINGS)
+    assert corpus.strings == tuple(STRINGS)
+    assert [s if s is None else s.original for s in corpus] == STRINGS
+    assert [s if s is None else str(s) for s in corpus] == [s if s is None else str(s) for s in expected]
+    assert repr(corpus.processor) == repr(processors.lowercase)
+
+
+def test_same_scores(corpus_path):
+    expected = preprocess(STRINGS, processors.lowercase)
+    corpus = load_corpus(corpus_path)
+    assert jarowinkler_similarity_many("jonathan", corpus) == jarowinkler_similarity_many("jonathan", expected)
+    assert cdist(corpus, corpus).tolist() == cdist(expected, expected).tolist()
+    assert extract("jonathan", corpus, limit=None) == extract("jonathan", expected, limit=None)
+    assert JaroWinklerIndex(corpus).extract("nathan") == JaroWinklerIndex(expected).extract("nathan")
+    assert len(JaroWinklerIndex(corpus)) == len(STRINGS)
+
+
+def test_compile_corpus(tmp_path):
+    """
+    a PreprocessedCorpus is stored without running its processor again
+    """
+    path = tmp_path / "corpus.jwc"
+    compile_corpus(preprocess(STRINGS, processors.casefold | processors.strip), str(path))
+    corpus = load_corpus(path)
+    assert repr(corpus.processor) == repr(processors.casefold | processors.strip)
+    assert str(corpus[5]) == "äbc" * 30
+
+    compile_corpus(corpus, path.with_suffix(".copy"))
+    copy = load_corpus(path.with_suffix(".copy"))
+    assert [s if s is None else str(s) for s in copy] == [s if s is None else str(s) for s in corpus]
+
+
+def test_python_processor(tmp_path):
+    path = tmp_path / "corpus.jwc"
+    compile_corpus(STRINGS, path, lambda s: s.upper())
+    corpus = load_corpus(path)
+    assert corpus.processor is None
+    assert str(corpus[0]) == "JOHNATHAN"
+
+
+def test_empty(tmp_path):
+    path = tmp_path / "empty.jwc"
+    compile_corpus([], path)
+    corpus = load_corpus(path)
+    assert len(corpus) == 0
+    assert extract("a", corpus) == []
+
+
+@pytest.mark.skipif(sys.platform == "win32", reason="mapped files can not be replaced on Windows")
+def test_replace_mapped_file(corpus_path):
+    corpus = load_corpus(corpus_path)
+    compile_corpus(["other"], corpus_path)
+    assert corpus.strings == tuple(STRINGS)
+    assert load_corpus(corpus_path).strings == ("other",)
+
+
+def test_unsupported_strings(tmp_path):
+    with pytest.raises(TypeError):
+        compile_corpus([["a", "b"]], tmp_path / "corpus.jwc")
+    with pytest.raises(TypeError):
+        compile_corpus([1], tmp_path / "corpus.jwc")
+    assert not (tmp_path / "corpus.jwc").exists()
+
+
+def test_invalid_files(tmp_path, corpus_path):
+    with pytest.raises(OSError):
+        load_corpus(tmp_path / "missing.jwc")
+
+    path = tmp_path / "invalid.jwc"
+    path.write_bytes(b"\0" * 8192)
+    with pytest.raises(ValueError, match="no corpus file"):
+        load_corpus(path)
+
+    data = corpus_path.read_bytes()
+    path.write_bytes(data[: len(data) - 4096])
+    with pytest.raises(ValueError, match="truncated"):
+        load_corpus(path)
+
+    path.write_bytes(data[:8] + struct.pack("=I", 1000) + data[12:])
+    with pytest.raises(ValueError, match="version"):
+        load_corpus(path)
+
+    # entry of the first string pointing behind the characters
+    entries = struct.unpack_from("=Q", data, 32)[0]
+    path.write_bytes(data[:entries] + struct.pack("=Q", 1 << 40) + data[entries + 8 :])
+    with pytest.raises(ValueError, match="corrupted"):
+        load_corpus(path, mmap=False)
@@ -0,0 +1,61 @@
+import pytest
+
+from jarowinkler import extract, jaro_similarity, jarowinkler_similarity
+
+CHOICES = ["Jonathan", "Johnathan", "", "Jon", "0" * 65, "nathan", "Джонатан", None, "Jonathan", ["J", "o", "n"]]
+
+
+def expected_matches(scorer, query, choices, limit, score_cutoff, **kwargs):
+    matches = [
+        (choice, scorer(query, choice, **kwargs), i)
+        for i, choice in enumerate(choices)
+        if choice is not None and scorer(query, choice, **kwargs) >= (score_cutoff or 0.0)
+    ]
+    matches.sort(key=lambda match: (-match[1], match[2]))
+    return matches if limit is None else matches[:limit]
+
+
+def assert_matches(result, expected):
+    assert [(choice, index) for choice, _, index in result] == [(choice, index) for choice, _, index in expected]
+    assert [score for _, score, _ in result] == pytest.approx([score for _, score, _ in expected])
+
+
+@pytest.mark.parametrize("limit", [None, 0, 1, 2, 5, 20])
+@pytest.mark.parametrize("score_cutoff", [None, 0.5, 0.9])
+def test_matches_single_calls(limit, score_cutoff):
+    for query in ["Johnathan", "", "0" * 70, "Джон"]:
+        result = extract(query, CHOICES, prefix_weight=0.2, score_cutoff=score_cutoff, limit=limit)
+        expected = expected_matches(jarowinkler_similarity, query, CHOICES, limit, score_cutoff, prefix_weight=0.2)
+        assert_matches(result, expected)
+
+        result = extract(query, CHOICES, scorer=jaro_similarity, score_cutoff=score_cutoff, limit=limit)
+        assert_matches(result, expected_matches(jaro_similarity, query, CHOICES, limit, score_cutoff))
+
+
+def test_default_limit():
+    choices = [f"string{i}" for i in range(20)]
+    assert len(extract("string", choices)) == 5
+
+
+def test_ties_keep_choice_order():
+    assert [index for _, _, index in extract("abc", ["abd", "abc", "abd", "abd"], limit=3)] == [1, 0, 2]
+
+
+def test_processor():
+    result = extract("JOHN", ["jane", "JOHN", "john"], processor=str.lower, limit=2)
+    assert result == [("JOHN", 1.0, 1), ("john", 1.0, 2)]
+
+
+def test_none_query():
+    assert extract(None, ["a", "b"]) == []
+
+
+def test_invalid_arguments():
+    with pytest.raises(ValueError):
+        extract("a", ["a"], limit=-1)
+    with pytest.raises(ValueError):
+        extract("a", ["a"], scorer=len)
+    with pytest.raises(ValueError):
+        extract("a", ["a"], scorer=jaro_similarity, prefix_weight=0.1)
+    with pytest.raises(ValueError):
+        extract("a", ["a"], prefix_weight=0.3)
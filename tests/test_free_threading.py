@@ -0,0 +1,153 @@
+"""
+Stress tests calling the scorers from many threads at once. On the free-threaded build
+(python3.13t) the threads run in parallel, on other builds they are interleaved by the GIL.
+"""
+
+import random
+import sys
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+import pytest
+
+from jarowinkler import (
+    JaroWinklerIndex,
+    JaroWinklerMatcher,
+    TokenVocabulary,
+    cdist,
+    jaro_similarity,
+    jarowinkler_similarity,
+    jarowinkler_similarity_many,
+    preprocess,
+    processors,
+)
+
+THREADS = 8
+GIL_ENABLED = getattr(sys, "_is_gil_enabled", lambda: True)()
+
+
+def random_strings(count, seed=42):
+    rng = random.Random(seed)
+    alphabets = ["abcde", "abcdefghijklmnopqrstuvwxyz", "äöüßÄÖÜ", "東京都大阪", "\U0001f600\U0001f601ab"]
+    lengths = [0, 1, 5, 16, 63, 64, 65, 200]
+    return ["".join(rng.choices(rng.choice(alphabets), k=rng.choice(lengths))) for _ in range(count)]
+
+
+STRINGS = random_strings(300)
+PAIRS = list(zip(STRINGS, STRINGS[1:] + STRINGS[:1]))
+
+
+def run_threads(func, threads=THREADS):
+    with ThreadPoolExecutor(threads) as pool:
+        return list(pool.map(lambda i: func(i), range(threads)))
+
+
+def test_scorers():
+    expected_jw = [jarowinkler_similarity(a, b) for a, b in PAIRS]
+    expected_jaro = [jaro_similarity(a, b, processor=processors.lowercase) for a, b in PAIRS]
+
+    def work(i):
+        order = list(range(len(PAIRS)))
+        random.Random(i).shuffle(order)
+        for j in order:
+            a, b = PAIRS[j]
+            assert jarowinkler_similarity(a, b) == expected_jw[j]
+            assert jaro_similarity(a, b, processor=processors.lowercase) == expected_jaro[j]
+        return True
+
+    assert all(run_threads(work))
+
+
+def test_shared_objects():
+    """
+    matchers, indices and corpora are shared between the threads
+    """
+    matcher = JaroWinklerMatcher(STRINGS[0])
+    index = JaroWinklerIndex(STRINGS)
+    corpus = preprocess(STRINGS, processors.casefold)
+    expected_matcher = [jarowinkler_similarity(STRINGS[0], s) for s in STRINGS]
+    expected_many = jarowinkler_similarity_many(corpus[3], corpus)
+    expected_index = index.extract(STRINGS[7], limit=10)
+
+    def work(_):
+        for _ in range(5):
+            assert [matcher.similarity(s) for s in STRINGS] == expected_matcher
+            assert jarowinkler_similarity_many(corpus[3], corpus) == expected_many
+            assert index.extract(STRINGS[7], limit=10) == expected_index
+        return True
+
+    assert all(run_threads(work))
+
+
+def test_shared_vocabulary():
+    """
+    threads add tokens to the same vocabulary, so every token has to receive exactly one id
+    """
+    vocabulary = TokenVocabulary()
+    sentences = [" ".join(random_strings(10, seed=i)) for i in range(THREADS * 20)]
+
+    def work(i):
+        corpus = vocabulary.encode_corpus(sentences[i::THREADS])
+        return [list(encoded) for encoded in corpus]
+
+    results = run_threads(work)
+    for i, encoded in enumerate(results):
+        assert encoded == [s.split() for s in sentences[i::THREADS]]
+    assert len(vocabulary) == len(set(vocabulary.tokens))
+    assert sorted(vocabulary.tokens) == sorted({token for s in sentences for token in s.split()})
+
+
+def test_shared_list_modified():
+    """
+    a list which is modified by another thread is read consistently
+    """
+    tokens = list(range(50))
+
+    def work(i):
+        for _ in range(200):
+            if i == 0:
+                tokens.append(tokens.pop(0))
+            else:
+                assert 0.0 <= jarowinkler_similarity(tokens, list(range(50))) <= 1.0
+        return True
+
+    assert all(run_threads(work, threads=4))
+
+
+def scaling(func, threads):
+    start = time.perf_counter()
+    run_threads(func, threads)
+    return time.perf_counter() - start
+
+
+def test_scaling(record_property):
+    """
+    every thread does the same amount of work, so without a global lock the wall time stays
+    about the same. The speedup is only reported, since it depends on the machine
+    """
+
+    def work(_):
+        for a, b in PAIRS * 5:
+            jarowinkler_similarity(a, b)
+        cdist(STRINGS[:50], STRINGS)
+
+    work(0)
+    single = scaling(work, 1)
+    parallel = scaling(work, THREADS)
+    speedup = THREADS * single / parallel
+    record_property("free_threaded", not GIL_ENABLED)
+    record_property("speedup", round(speedup, 2))
+    print(f"speedup with {THREADS} threads: {speedup:.2f} (GIL {'enabled' if GIL_ENABLED else 'disabled'})")
+    assert speedup > 0
+
+
+@pytest.mark.skipif(not hasattr(sys, "_is_gil_enabled"), reason="requires Python 3.13")
+def test_gil_not_reenabled():
+    """
+    importing the extension on the free-threaded build must not enable the GIL again
+    """
+    import sysconfig
+
+    if not sysconfig.get_config_var("Py_GIL_DISABLED"):
+        pytest.skip("requires the free-threaded build")
+    assert not sys._is_gil_enabled()
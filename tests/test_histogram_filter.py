@@ -0,0 +1,51 @@
+import pytest
+
+from jarowinkler import (
+    JaroWinklerIndex,
+    cdist,
+    extract,
+    histogram_filter_stats,
+    jaro_similarity,
+    jaro_similarity_many,
+    jarowinkler_similarity,
+    jarowinkler_similarity_many,
+)
+
+# long and non Latin-1 strings are scored one at a time and checked by the filter first. Strings, which
+# can not reach score_cutoff because of their length, are rejected before the filter
+CHOICES = ["Джонатан Смит", "Джон Смит", "Смит", "абвгдеёзйклпр"]
+CHOICES += ["abcdefghijklmnopqrstuvwxyz", "zyxwvutsrqponmlkjihgfedcba"]
+CHOICES += ["0" * 65, "0" * 64 + "1", "", [1, 2, 3], ["a", "b"]]
+
+
+@pytest.mark.parametrize("score_cutoff", [0.5, 0.8, 0.95])
+def test_matches_single_calls(score_cutoff):
+    for query in ["Джонатан Смит", "abcdefghijklmnopqrstuvwxyz", "0" * 70, [1, 2, 3]]:
+        expected = [jarowinkler_similarity(query, choice, score_cutoff=score_cutoff) for choice in CHOICES]
+        assert jarowinkler_similarity_many(query, CHOICES, score_cutoff=score_cutoff) == pytest.approx(expected)
+
+        expected = [jaro_similarity(query, choice, score_cutoff=score_cutoff) for choice in CHOICES]
+        assert jaro_similarity_many(query, CHOICES, score_cutoff=score_cutoff) == pytest.approx(expected)
+
+
+def test_stats():
+    histogram_filter_stats(reset=True)
+    jarowinkler_similarity_many("Джонатан Смит", CHOICES)
+    assert histogram_filter_stats() == {"candidates": 0, "rejected": 0}
+
+    jarowinkler_similarity_many("Джонатан Смит", CHOICES, score_cutoff=0.9)
+    stats = histogram_filter_stats(reset=True)
+    assert stats["candidates"] > 0
+    assert 0 < stats["rejected"] <= stats["candidates"]
+    assert histogram_filter_stats() == {"candidates": 0, "rejected": 0}
+
+
+def test_all_batch_functions_count():
+    for search in [
+        lambda: extract("Джонатан Смит", CHOICES, score_cutoff=0.9),
+        lambda: JaroWinklerIndex(CHOICES).extract("Джонатан Смит", score_cutoff=0.5),
+        lambda: cdist(["Джонатан Смит"], CHOICES, score_cutoff=0.9),
+    ]:
+        histogram_filter_stats(reset=True)
+        search()
+        assert histogram_filter_stats()["rejected"] > 0
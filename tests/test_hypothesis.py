@@ -95,3 +95,17 @@ def test_jaro_winkler_block(s1, s2):
 def test_jaro_winkler_random(s1, s2):
     print(s1, s2)
     assert isclose(jaro_winkler_similarity(s1, s2), jarowinkler_similarity(s1, s2))
+
+
+# the last character of every alphabet forces the storage width of the str (1, 2 or 4 bytes per character)
+WIDTH_ALPHABETS = ["abcÿ", "abcÿĀ", "abcÿĀ😀"]
+
+
+@given(data=st.data())
+@settings(max_examples=20, deadline=None)
+def test_jaro_winkler_widths(data):
+    for alphabet1 in WIDTH_ALPHABETS:
+        for alphabet2 in WIDTH_ALPHABETS:
+            s1 = data.draw(st.text(alphabet=alphabet1, max_size=70)) + alphabet1[-1]
+            s2 = data.draw(st.text(alphabet=alphabet2, max_size=70)) + alphabet2[-1]
+            assert isclose(jaro_winkler_similarity(s1, s2), jarowinkler_similarity(s1, s2))
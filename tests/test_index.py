@@ -0,0 +1,48 @@
+import pytest
+
+from jarowinkler import JaroWinklerIndex, extract, jaro_similarity
+
+CHOICES = ["Jonathan", "Johnathan", "", "Jon", "0" * 65, "nathan", "Джонатан", None, "Jonathan", ["J", "o", "n"]]
+CHOICES += [f"name{i}" * (i % 4 + 1) for i in range(50)]
+
+
+def assert_matches(result, expected):
+    assert [(choice, index) for choice, _, index in result] == [(choice, index) for choice, _, index in expected]
+    assert [score for _, score, _ in result] == pytest.approx([score for _, score, _ in expected])
+
+
+@pytest.mark.parametrize("limit", [None, 0, 1, 3, 20])
+@pytest.mark.parametrize("score_cutoff", [None, 0.5, 0.9])
+def test_matches_extract(limit, score_cutoff):
+    index = JaroWinklerIndex(CHOICES, prefix_weight=0.2)
+    for query in ["Johnathan", "", "0" * 70, "Джон", "name3name3"]:
+        result = index.extract(query, score_cutoff=score_cutoff, limit=limit)
+        assert_matches(result, extract(query, CHOICES, prefix_weight=0.2, score_cutoff=score_cutoff, limit=limit))
+
+
+def test_jaro():
+    index = JaroWinklerIndex(CHOICES, prefix_weight=0)
+    result = index.extract("Johnathan", score_cutoff=0.7, limit=None)
+    assert_matches(result, extract("Johnathan", CHOICES, scorer=jaro_similarity, score_cutoff=0.7, limit=None))
+
+
+def test_processor():
+    index = JaroWinklerIndex(["jane", "JOHN", "john"], processor=str.lower)
+    assert index.extract("JOHN", limit=2) == [("JOHN", 1.0, 1), ("john", 1.0, 2)]
+    assert index.processor is str.lower
+
+
+def test_attributes():
+    index = JaroWinklerIndex(["a", None, "b"])
+    assert len(index) == 3
+    assert index.prefix_weight == pytest.approx(0.1)
+    assert index.extract(None) == []
+
+
+def test_invalid_arguments():
+    with pytest.raises(ValueError):
+        JaroWinklerIndex(["a"], prefix_weight=0.3)
+    with pytest.raises(ValueError):
+        JaroWinklerIndex(["a"]).extract("a", limit=-1)
+    with pytest.raises(TypeError):
+        JaroWinklerIndex(1)
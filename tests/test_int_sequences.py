@@ -0,0 +1,93 @@
+from array import array
+
+import pytest
+
+from jarowinkler import (
+    JaroWinklerIndex,
+    JaroWinklerMatcher,
+    cdist,
+    extract,
+    jaro_similarity,
+    jarowinkler_similarity,
+    jarowinkler_similarity_many,
+)
+
+S1 = [17, 4, -3, 1023, 5, 1 << 40]
+S2 = [17, -3, 4, 1023, 6, 1 << 40, 8]
+SMALL1 = [1, 2, -3, 4, 5]
+SMALL2 = [1, -3, 2, 4, 7, 9]
+
+
+@pytest.mark.parametrize("typecode", ["b", "h", "i", "l", "q"])
+def test_signed_array(typecode):
+    expected = jarowinkler_similarity(SMALL1, SMALL2)
+    assert jarowinkler_similarity(array(typecode, SMALL1), array(typecode, SMALL2)) == expected
+    assert jarowinkler_similarity(array(typecode, SMALL1), SMALL2) == expected
+
+
+@pytest.mark.parametrize("typecode", ["B", "H", "I", "L", "Q"])
+def test_unsigned_array(typecode):
+    s1 = [abs(x) for x in SMALL1]
+    s2 = [abs(x) for x in SMALL2]
+    assert jaro_similarity(array(typecode, s1), array(typecode, s2)) == jaro_similarity(s1, s2)
+
+
+def test_int64():
+    expected = jarowinkler_similarity(S1, S2)
+    assert jarowinkler_similarity(array("q", S1), array("q", S2)) == expected
+    assert jarowinkler_similarity(memoryview(array("q", S1)), S2) == expected
+
+
+def test_uint64_high_bit():
+    """
+    unsigned integers of at least 2^63 are hashed like the same integers in a list
+    """
+    s1 = [1 << 63, 5, (1 << 64) - 1]
+    s2 = [1 << 63, 5, (1 << 64) - 1, 7]
+    assert jarowinkler_similarity(array("Q", s1), s1) == 1.0
+    assert jarowinkler_similarity(array("Q", s1), array("Q", s2)) == jarowinkler_similarity(s1, s2)
+    assert jarowinkler_similarity(array("Q", s1), s2) == jarowinkler_similarity(s1, s2)
+
+
+def test_same_as_characters():
+    """
+    integers are compared with the code points of strings
+    """
+    assert jarowinkler_similarity(array("B", b"Johnathan"), "Johnathan") == 1.0
+    assert jarowinkler_similarity(array("I", map(ord, "東京都")), "東京") == jarowinkler_similarity("東京都", "東京")
+    assert jarowinkler_similarity(memoryview(b"Jonathan"), "Johnathan") == jarowinkler_similarity(
+        "Jonathan", "Johnathan"
+    )
+
+
+def test_empty():
+    assert jarowinkler_similarity(array("q"), array("q")) == jarowinkler_similarity([], [])
+    assert jarowinkler_similarity(array("q"), array("q", [1])) == 0.0
+
+
+def test_array_not_resized_while_used():
+    s1 = array("q", S1)
+    matcher = JaroWinklerMatcher(s1)
+    s1.append(1)
+    assert matcher.similarity(S1) == 1.0
+
+
+def test_batch_functions():
+    choices = [array("q", S2), array("q", S1), array("q")]
+    expected = [jarowinkler_similarity(S1, list(c)) for c in choices]
+    assert jarowinkler_similarity_many(array("q", S1), choices) == expected
+    assert cdist([array("q", S1)], choices).tolist() == [pytest.approx(expected)]
+    assert extract(array("q", S1), choices, limit=1)[0][1:] == (1.0, 1)
+    assert JaroWinklerIndex(choices).extract(array("q", S1), limit=1)[0][1:] == (1.0, 1)
+
+
+def test_numpy():
+    np = pytest.importorskip("numpy")
+    expected = jarowinkler_similarity(S1, S2)
+    assert jarowinkler_similarity(np.array(S1, dtype=np.int64), np.array(S2, dtype=np.int64)) == expected
+    unsigned = np.array(S1, dtype=np.int64).view(np.uint64)
+    assert jarowinkler_similarity(unsigned, S2) == jarowinkler_similarity([int(x) for x in unsigned], S2)
+    assert jarowinkler_similarity(np.array(SMALL1, dtype=np.int8), SMALL2) == jarowinkler_similarity(SMALL1, SMALL2)
+    # non contiguous and non native arrays are converted element by element
+    assert jarowinkler_similarity(np.array(S1)[::2], S2) == jarowinkler_similarity(S1[::2], S2)
+    assert jarowinkler_similarity(np.array(S1, dtype=">i8"), S2) == expected
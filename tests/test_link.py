@@ -0,0 +1,104 @@
+import csv
+import json
+import threading
+
+import pytest
+
+from jarowinkler import jarowinkler_similarity
+from jarowinkler.link import main
+
+LEFT = [
+    {"id": "l1", "name": "Johnathan", "city": "Berlin"},
+    {"id": "l2", "name": "Martha", "city": "Paris"},
+    {"id": "l3", "name": "Jonathan", "city": "Paris"},
+    {"id": "l4", "name": "", "city": "Paris"},
+]
+RIGHT = [
+    {"key": 1, "full_name": "Jonathan", "city": "Berlin"},
+    {"key": 2, "full_name": "Marhta", "city": "Paris"},
+    {"key": 3, "full_name": "Johnathan", "city": "Paris"},
+    {"key": 4, "full_name": "Peter", "city": "Paris"},
+]
+
+
+def write_inputs(tmp_path):
+    left = tmp_path / "left.csv"
+    with open(left, "w", newline="") as f:
+        writer = csv.DictWriter(f, fieldnames=["id", "name", "city"])
+        writer.writeheader()
+        writer.writerows(LEFT)
+
+    right = tmp_path / "right.jsonl"
+    right.write_text("".join(json.dumps(record) + "\n" for record in RIGHT))
+    return str(left), str(right)
+
+
+def expected_pairs(threshold, block=None):
+    return sorted(
+        (left["id"], right["key"], jarowinkler_similarity(left["name"], right["full_name"]))
+        for left in LEFT
+        for right in RIGHT
+        if left["name"]
+        and jarowinkler_similarity(left["name"], right["full_name"]) >= threshold
+        and (block is None or left[block] == right[block])
+    )
+
+
+def read_output(path):
+    with open(path) as f:
+        return sorted((row["left_id"], int(row["right_id"]), float(row["score"])) for row in csv.DictReader(f))
+
+
+@pytest.mark.parametrize("processes, threads", [(1, 1), (1, 2), (2, 2)])
+def test_link(tmp_path, processes, threads):
+    left, right = write_inputs(tmp_path)
+    output = str(tmp_path / "out.csv")
+    args = [left, right, "--left-field", "name", "--right-field", "full_name", "--left-id", "id"]
+    args += ["--right-id", "key", "--threshold", "0.85", "--chunk-size", "1", "-o", output]
+    args += ["--processes", str(processes), "--threads", str(threads)]
+    assert main(args) == 0
+
+    result = read_output(output)
+    expected = expected_pairs(0.85)
+    assert [pair[:2] for pair in result] == [pair[:2] for pair in expected]
+    assert [pair[2] for pair in result] == pytest.approx([pair[2] for pair in expected])
+
+
+def test_threads_stopped(tmp_path):
+    left, right = write_inputs(tmp_path)
+    args = [left, right, "--left-field", "name", "--right-field", "full_name", "--threads", "4"]
+    args += ["-o", str(tmp_path / "out.csv")]
+    before = threading.active_count()
+    for _ in range(3):
+        assert main(args) == 0
+    assert threading.active_count() == before
+
+
+def test_block_field(tmp_path):
+    left, right = write_inputs(tmp_path)
+    output = str(tmp_path / "out.csv")
+    args = [left, right, "--left-field", "name", "--right-field", "full_name", "--left-id", "id"]
+    args += ["--right-id", "key", "--threshold", "0.85", "--block-field", "city", "-o", output]
+    assert main(args) == 0
+    assert [pair[:2] for pair in read_output(output)] == [pair[:2] for pair in expected_pairs(0.85, "city")]
+
+
+def test_jsonl_output(tmp_path):
+    left, right = write_inputs(tmp_path)
+    output = tmp_path / "out.jsonl"
+    args = [left, right, "--left-field", "name", "--right-field", "full_name", "--block-prefix", "1"]
+    assert main(args + ["--threshold", "0.99", "-o", str(output)]) == 0
+
+    rows = [json.loads(line) for line in output.read_text().splitlines()]
+    assert sorted(rows, key=lambda row: row["left_id"]) == [
+        {"left_id": 0, "right_id": 2, "left": "Johnathan", "right": "Johnathan", "score": 1.0},
+        {"left_id": 2, "right_id": 0, "left": "Jonathan", "right": "Jonathan", "score": 1.0},
+    ]
+
+
+def test_invalid_arguments(tmp_path):
+    left, right = write_inputs(tmp_path)
+    with pytest.raises(SystemExit):
+        main([left, right, "--left-field", "name", "--processes", "0"])
+    with pytest.raises(SystemExit):
+        main([left, right, "--left-field", "name", "--prefix-weight", "0.3"])
@@ -0,0 +1,48 @@
+import pytest
+
+from jarowinkler import JaroMatcher, JaroWinklerMatcher, jaro_similarity, jarowinkler_similarity
+
+STRINGS = ["Johnathan", "Jonathan", "", "Jon", "0" * 65, "0" * 64, "nathan", "Джонатан", ["J", "o", "n"], [1, 2, 3]]
+
+
+@pytest.mark.parametrize("score_cutoff", [None, 0.5, 0.9])
+def test_matches_single_calls(score_cutoff):
+    for pattern in STRINGS:
+        jaro = JaroMatcher(pattern)
+        jarowinkler = JaroWinklerMatcher(pattern, prefix_weight=0.2)
+        for s2 in STRINGS:
+            assert jaro.similarity(s2, score_cutoff=score_cutoff) == pytest.approx(
+                jaro_similarity(pattern, s2, score_cutoff=score_cutoff)
+            )
+            assert jarowinkler.similarity(s2, score_cutoff=score_cutoff) == pytest.approx(
+                jarowinkler_similarity(pattern, s2, prefix_weight=0.2, score_cutoff=score_cutoff)
+            )
+
+
+def test_processor():
+    matcher = JaroWinklerMatcher("JOHN", processor=str.lower)
+    assert matcher.similarity("john") == 1.0
+    assert matcher.processor is str.lower
+
+
+def test_none():
+    assert JaroMatcher("a").similarity(None) == 0.0
+    with pytest.raises(TypeError):
+        JaroMatcher(None)
+
+
+def test_attributes():
+    matcher = JaroWinklerMatcher("Johnathan", prefix_weight=0.2)
+    assert matcher.pattern == "Johnathan"
+    assert matcher.prefix_weight == 0.2
+    assert repr(matcher) == "JaroWinklerMatcher('Johnathan', prefix_weight=0.2)"
+    assert repr(JaroMatcher("Jon")) == "JaroMatcher('Jon')"
+
+
+def test_invalid_arguments():
+    with pytest.raises(ValueError):
+        JaroWinklerMatcher("a", prefix_weight=0.3)
+    with pytest.raises(TypeError):
+        JaroMatcher("a", prefix_weight=0.1)
+    with pytest.raises(TypeError):
+        JaroMatcher("a").similarity()
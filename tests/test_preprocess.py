@@ -0,0 +1,103 @@
+import pytest
+
+from jarowinkler import (
+    JaroMatcher,
+    JaroWinklerIndex,
+    PreprocessedCorpus,
+    cdist,
+    extract,
+    jaro_similarity,
+    jarowinkler_similarity,
+    jarowinkler_similarity_many,
+    preprocess,
+)
+from jarowinkler import processors
+
+STRINGS = ["Johnathan", None, "JONATHAN", "", "Nathan", "ÄBC" * 30, "東京"]
+
+
+class CountingProcessor:
+    def __init__(self):
+        self.calls = 0
+
+    def __call__(self, s):
+        self.calls += 1
+        return s.lower()
+
+
+def test_processor_runs_once():
+    processor = CountingProcessor()
+    corpus = preprocess(STRINGS, processor)
+    assert processor.calls == len([s for s in STRINGS if s is not None])
+
+    jarowinkler_similarity_many(corpus[0], corpus, processor=processor)
+    cdist(corpus, corpus, processor=processor)
+    extract(corpus[2], corpus, processor=processor)
+    JaroWinklerIndex(corpus, processor=processor).extract(corpus[0])
+    for s in corpus:
+        jarowinkler_similarity(corpus[0], s, processor=processor)
+    assert processor.calls == len([s for s in STRINGS if s is not None])
+
+
+def test_corpus():
+    corpus = preprocess(STRINGS, str.lower)
+    assert isinstance(corpus, PreprocessedCorpus)
+    assert len(corpus) == len(STRINGS)
+    assert corpus.strings == tuple(STRINGS)
+    assert corpus.processor is str.lower
+    assert corpus[1] is None
+    assert str(corpus[-1]) == "東京"
+    assert str(corpus[0]) == "johnathan"
+    assert list(corpus[0]) == list("johnathan")
+    assert corpus[0].original == "Johnathan"
+    assert repr(corpus[4]) == "PreprocessedString('nathan')"
+    with pytest.raises(IndexError):
+        corpus[len(STRINGS)]
+
+
+def test_sequences_of_hashables():
+    corpus = preprocess([[1, 2, 3], (1, 2)])
+    assert str(corpus[0]) == "[1, 2, 3]"
+    assert jaro_similarity(corpus[0], corpus[1]) == jaro_similarity([1, 2, 3], [1, 2])
+
+    # about half of the element hashes are negative
+    tokens = ["foo", "bar", "baz", "qux", "quux", -1, 1 << 63]
+    corpus = preprocess([tokens, tokens[::-1]])
+    for i, expected in enumerate([tokens, tokens[::-1]]):
+        assert jarowinkler_similarity(list(corpus[i]), expected) == 1.0
+        assert jarowinkler_similarity(list(corpus[i]), corpus[i]) == 1.0
+    assert jarowinkler_similarity(list(corpus[0]), corpus[1]) == jarowinkler_similarity(tokens, tokens[::-1])
+
+
+@pytest.mark.parametrize("processor", [str.lower, processors.lowercase])
+def test_same_results(processor):
+    corpus = preprocess(STRINGS, processor)
+    for i, s1 in enumerate(STRINGS):
+        expected = list(jarowinkler_similarity_many(s1, STRINGS, processor=processor))
+        assert list(jarowinkler_similarity_many(corpus[i], corpus)) == expected
+        assert list(jarowinkler_similarity_many(s1, corpus, processor=processor)) == expected
+        if s1 is not None:
+            assert [jarowinkler_similarity(corpus[i], s2) for s2 in corpus] == expected
+            assert JaroMatcher(corpus[i]).similarity(corpus[0]) == jaro_similarity(s1, STRINGS[0], processor=processor)
+
+    assert cdist(corpus, corpus).tolist() == cdist(STRINGS, STRINGS, processor=processor).tolist()
+    assert extract(corpus[0], corpus, limit=None) == extract(STRINGS[0], STRINGS, processor=processor, limit=None)
+    assert JaroWinklerIndex(corpus).extract(corpus[0], limit=None) == extract(
+        STRINGS[0], STRINGS, processor=processor, limit=None
+    )
+
+
+def test_rapidfuzz():
+    process = pytest.importorskip("rapidfuzz.process")
+    corpus = preprocess(["Johnathan", "JONATHAN", "nathan"], str.lower)
+    result = process.cdist(corpus, corpus, scorer=jarowinkler_similarity)
+    expected = cdist(corpus, corpus)
+    assert [list(row) for row in result] == [list(row) for row in expected.tolist()]
+
+    # rapidfuzz reads the elements of sequences of hashables
+    tokens = [["foo", "bar", "baz", "qux", "quux"], ["foo", "bar", "qux"], ["baz", -1, 1 << 63]]
+    corpus = preprocess(tokens)
+    for query in tokens:
+        assert process.extractOne(query, corpus, scorer=jarowinkler_similarity)[1] == 1.0
+    result = process.cdist(corpus, corpus, scorer=jarowinkler_similarity)
+    assert [list(row) for row in result] == [list(row) for row in cdist(tokens, tokens).tolist()]
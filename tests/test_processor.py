@@ -0,0 +1,101 @@
+import sys
+
+import pytest
+
+from jarowinkler import (
+    JaroWinklerIndex,
+    JaroWinklerMatcher,
+    Processor,
+    cdist,
+    extract,
+    jaro_similarity,
+    jarowinkler_similarity,
+    jarowinkler_similarity_many,
+)
+from jarowinkler import processors
+
+ALL_CHARS = "".join(chr(ch) for ch in range(sys.maxunicode + 1) if not 0xD800 <= ch < 0xE000)
+
+
+def py_process(s):
+    return "".join(ch for ch in s.lower() if ch.isalnum() or ch.isspace()).strip()
+
+
+NATIVE = processors.lowercase | processors.remove_punctuation | processors.strip
+
+
+def test_lowercase():
+    # İ is the only character which is lowercased into multiple characters
+    assert [ch for ch in ALL_CHARS if processors.lowercase(ch) != ch.lower()] == ["İ"]
+
+
+def test_casefold():
+    assert processors.casefold("Straße ẞ µ ς") == "strasse ss μ σ"
+    for ch in ALL_CHARS:
+        if processors.casefold(ch) != ch.casefold():
+            assert len(ch.casefold()) > 1
+
+
+def test_remove_punctuation():
+    expected = "".join(ch for ch in ALL_CHARS if ch.isalnum() or ch.isspace())
+    assert processors.remove_punctuation(ALL_CHARS) == expected
+
+
+@pytest.mark.parametrize("s", ["", "   ", " a b ", "　x\t", "x"])
+def test_strip(s):
+    assert processors.strip(s) == s.strip()
+
+
+def test_ascii_fold():
+    assert processors.ascii_fold("Crème Brûlée, Æsir, Łódź, Þór, Straße") == "Creme Brulee, AEsir, Lodz, THor, Strasse"
+    # characters without a replacement are kept
+    assert processors.ascii_fold("× 東京 Ω") == "× 東京 Ω"
+
+
+def test_combined():
+    assert repr(NATIVE) == "Processor(lowercase=True, remove_punctuation=True, strip=True)"
+    assert repr(Processor()) == "Processor()"
+    assert (processors.ascii_fold | processors.lowercase)(" Crème BRÛLÉE! ") == " creme brulee! "
+    assert NATIVE(" Crème BRÛLÉE! ") == "crème brûlée"
+    with pytest.raises(TypeError):
+        NATIVE | str.lower
+    with pytest.raises(TypeError):
+        NATIVE(b"bytes")
+
+
+def test_similarity():
+    pairs = [("  JOHN!", "john"), ("Ꭰx", "ꭰX"), ("Müller-Lüdenscheidt", "muller ludenscheidt"), ("", " ")]
+    for s1, s2 in pairs:
+        assert jaro_similarity(s1, s2, processor=NATIVE) == jaro_similarity(s1, s2, processor=py_process)
+        assert jarowinkler_similarity(s1, s2, processor=NATIVE) == jarowinkler_similarity(
+            s1, s2, processor=py_process
+        )
+
+
+def test_non_string_input():
+    # sequences which are not str are passed to the processor like any other callable
+    with pytest.raises(TypeError):
+        jarowinkler_similarity([1, 2], [1, 2], processor=NATIVE)
+
+
+def test_batch_functions():
+    query = "JOHNATHAN "
+    choices = [" jonathan!", None, "Johnathan", "NATHAN.", "äbc" * 30]
+    expected = list(jarowinkler_similarity_many(query, choices, processor=py_process))
+    assert list(jarowinkler_similarity_many(query, choices, processor=NATIVE)) == expected
+    assert list(cdist([query], choices, processor=NATIVE).tolist()[0]) == pytest.approx(expected)
+    assert extract(query, choices, processor=NATIVE, limit=None) == extract(
+        query, choices, processor=py_process, limit=None
+    )
+    assert JaroWinklerMatcher(query, processor=NATIVE).similarity(choices[0]) == expected[0]
+    assert JaroWinklerIndex(choices, processor=NATIVE).extract(query, limit=None) == extract(
+        query, choices, processor=py_process, limit=None
+    )
+
+
+def test_string_arrays():
+    np = pytest.importorskip("numpy")
+    choices = [" Jonathan!", "JOHNATHAN", "Nathan."]
+    expected = list(jarowinkler_similarity_many("johnathan", choices, processor=py_process))
+    for array in (np.array(choices), np.array([s.encode() for s in choices])):
+        assert list(jarowinkler_similarity_many("johnathan", array, processor=NATIVE)) == expected
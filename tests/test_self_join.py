@@ -0,0 +1,97 @@
+import random
+
+import pytest
+
+from jarowinkler import ThreadPool, jaro_similarity, jarowinkler_similarity, preprocess, processors, self_join
+
+
+def random_strings(count, seed=42):
+    rng = random.Random(seed)
+    alphabets = ["ab", "abcdef", "abcdefghijklmnopqrstuvwxyz", "äöüab", "東京都大阪ab"]
+    lengths = [0, 1, 2, 5, 8, 16, 17, 30, 70, 130]
+    return [
+        None if rng.random() < 0.05 else "".join(rng.choices(rng.choice(alphabets), k=rng.choice(lengths)))
+        for _ in range(count)
+    ]
+
+
+STRINGS = random_strings(300)
+
+
+def expected_pairs(scorer, strings, score_cutoff, **kwargs):
+    pairs = []
+    for i, s1 in enumerate(strings):
+        for j in range(i + 1, len(strings)):
+            if s1 is None or strings[j] is None:
+                continue
+            score = scorer(s1, strings[j], **kwargs)
+            if score >= score_cutoff:
+                pairs.append((i, j, score))
+    return pairs
+
+
+def as_pairs(result):
+    rows, cols, scores = result
+    return list(zip(rows.tolist(), cols.tolist(), scores.tolist()))
+
+
+@pytest.mark.parametrize("workers", [1, 3])
+@pytest.mark.parametrize("score_cutoff", [0.6, 0.8, 0.95, 1.0])
+def test_matches_single_calls(workers, score_cutoff):
+    result = self_join(STRINGS, score_cutoff, prefix_weight=0.2, dtype="float64", workers=workers)
+    assert as_pairs(result) == expected_pairs(jarowinkler_similarity, STRINGS, score_cutoff, prefix_weight=0.2)
+
+    result = self_join(STRINGS, score_cutoff, scorer=jaro_similarity, dtype="float64", workers=workers)
+    assert as_pairs(result) == expected_pairs(jaro_similarity, STRINGS, score_cutoff)
+
+
+def test_result_format():
+    rows, cols, scores = self_join(["Johnathan", "Jonathan", None, "Johnathan", "Peter"], 0.9)
+    assert rows.format == "q" and cols.format == "q" and scores.format == "f"
+    assert rows.tolist() == [0, 0, 1]
+    assert cols.tolist() == [1, 3, 3]
+    assert scores.tolist() == pytest.approx([0.9037037, 1.0, 0.9037037])
+
+    rows, cols, scores = self_join([], 0.9)
+    assert len(rows) == len(cols) == len(scores) == 0
+
+
+def test_duplicates():
+    """
+    the strings are sorted by length, so equal strings far apart in the list are found as well
+    """
+    strings = ["name"] + [f"other string {i}" for i in range(1000)] + ["name"]
+    assert as_pairs(self_join(strings, 1.0)) == [(0, 1001, 1.0)]
+
+
+def test_processor_and_corpus():
+    strings = ["JOHNATHAN", "johnathan", "Jonathan"]
+    expected = [(0, 1, 1.0)]
+    assert as_pairs(self_join(strings, 0.95, processor=processors.lowercase)) == expected
+    assert as_pairs(self_join(preprocess(strings, str.lower), 0.95)) == expected
+
+
+def test_thread_pool():
+    strings = random_strings(500, seed=7)
+    with ThreadPool(3) as pool:
+        assert as_pairs(self_join(strings, 0.8, workers=pool)) == as_pairs(self_join(strings, 0.8))
+
+
+def test_numpy():
+    np = pytest.importorskip("numpy")
+    rows, cols, scores = (np.asarray(x) for x in self_join(["abc", "abd", "abc"], 0.5))
+    assert rows.dtype == np.int64 and scores.dtype == np.float32
+    assert rows.tolist() == [0, 0, 1] and cols.tolist() == [1, 2, 2]
+
+
+@pytest.mark.parametrize("score_cutoff", [0, -0.5, 1.5, None])
+def test_invalid_score_cutoff(score_cutoff):
+    with pytest.raises((ValueError, TypeError)):
+        self_join(STRINGS, score_cutoff)
+
+
+def test_invalid_arguments():
+    with pytest.raises(ValueError):
+        self_join(STRINGS, 0.9, scorer=jaro_similarity, prefix_weight=0.1)
+    with pytest.raises(ValueError):
+        self_join(STRINGS, 0.9, dtype="int32")
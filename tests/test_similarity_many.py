@@ -0,0 +1,87 @@
+from array import array
+
+import pytest
+
+from jarowinkler import (
+    enable_stats,
+    get_stats,
+    jaro_similarity,
+    jaro_similarity_many,
+    jarowinkler_similarity,
+    jarowinkler_similarity_many,
+    reset_stats,
+)
+
+CHOICES = ["Jonathan", "Johnathan", "", "Jon", "0" * 65, "nathan", "Джонатан", None, ["J", "o", "n"]]
+
+
+@pytest.mark.parametrize("score_cutoff", [None, 0.5, 0.9])
+def test_matches_single_calls(score_cutoff):
+    for query in ["Johnathan", "", "0" * 70, "Джон"]:
+        expected = [
+            jarowinkler_similarity(query, choice, prefix_weight=0.2, score_cutoff=score_cutoff)
+            for choice in CHOICES
+        ]
+        result = jarowinkler_similarity_many(query, CHOICES, prefix_weight=0.2, score_cutoff=score_cutoff)
+        assert result == pytest.approx(expected)
+
+        expected = [jaro_similarity(query, choice, score_cutoff=score_cutoff) for choice in CHOICES]
+        assert jaro_similarity_many(query, CHOICES, score_cutoff=score_cutoff) == pytest.approx(expected)
+
+
+def test_processor():
+    result = jarowinkler_similarity_many("JOHN", ["john", "JOHN", "jane"], processor=str.lower)
+    assert result == pytest.approx([jarowinkler_similarity("john", c) for c in ["john", "john", "jane"]])
+
+
+def test_none_query():
+    assert jarowinkler_similarity_many(None, ["a", "b"]) == [0, 0]
+
+
+@pytest.mark.parametrize("typecode", ["f", "d"])
+def test_out_buffer(typecode):
+    out = array(typecode, [-1.0] * 3)
+    result = jarowinkler_similarity_many("Johnathan", ["Jonathan", "Johnathan", "x"], out=out)
+    assert result is out
+    assert list(out) == pytest.approx([0.9037037, 1.0, 0.0])
+
+
+def test_invalid_out_buffer():
+    with pytest.raises(ValueError):
+        jarowinkler_similarity_many("a", ["a", "b"], out=array("d", [0.0]))
+    with pytest.raises(ValueError):
+        jarowinkler_similarity_many("a", ["a", "b"], out=array("i", [0, 0]))
+    with pytest.raises(BufferError):
+        jarowinkler_similarity_many("a", ["a", "b"], out=b"12345678")
+
+
+def test_invalid_out_buffer_before_scoring():
+    enable_stats()
+    reset_stats()
+    try:
+        with pytest.raises(ValueError):
+            jaro_similarity_many("a", ["a", "b", "Джон"], out=array("d", [0.0]))
+        assert get_stats()["calls"] == 0
+    finally:
+        enable_stats(False)
+        reset_stats()
+
+
+def test_none_query_out_buffer():
+    out = array("d", [-1.0] * 2)
+    assert jarowinkler_similarity_many(None, ["a", "b"], out=out) is out
+    assert list(out) == [0.0, 0.0]
+
+
+def test_short_strings():
+    # enough short Latin-1 strings of every length to fill multiple batches of the SIMD kernel
+    choices = [("Jonathan Smith" * 2)[i % 7 : i % 7 + length] for i in range(40) for length in range(18)]
+    choices += ["Jöhn", "Jołn"]
+    for query in ["Johnathan", "Smith Jo", "J", "Jöhnathan", "Jołnathan", "n" * 64, "n" * 65]:
+        for score_cutoff in [None, 0.8]:
+            expected = [jarowinkler_similarity(query, choice, score_cutoff=score_cutoff) for choice in choices]
+            result = jarowinkler_similarity_many(query, choices, score_cutoff=score_cutoff)
+            assert result == pytest.approx(expected)
+
+            expected = [jaro_similarity(query, choice, score_cutoff=score_cutoff) for choice in choices]
+            assert jaro_similarity_many(query, choices, score_cutoff=score_cutoff) == pytest.approx(expected)
@@ -0,0 +1,177 @@
+import threading
+
+import pytest
+
+from jarowinkler import (
+    JaroWinklerIndex,
+    JaroWinklerMatcher,
+    cdist,
+    enable_stats,
+    extract,
+    get_stats,
+    jaro_similarity,
+    jarowinkler_similarity,
+    jarowinkler_similarity_many,
+    reset_stats,
+    self_join,
+)
+
+
+@pytest.fixture
+def stats():
+    enable_stats()
+    reset_stats()
+    yield
+    enable_stats(False)
+    reset_stats()
+
+
+def check_consistent(result):
+    assert result["calls"] == sum(result["paths"].values())
+    assert result["calls"] == sum(result["length_histogram"].values())
+
+
+def test_disabled_by_default():
+    reset_stats()
+    jarowinkler_similarity("abc", "abd")
+    result = get_stats()
+    assert not result["enabled"]
+    assert result["calls"] == 0
+
+
+def test_paths(stats):
+    jarowinkler_similarity("", "abc")
+    jarowinkler_similarity("a" * 10, "a" * 100, score_cutoff=0.9)
+    jarowinkler_similarity("abcde", "abdce")
+    jarowinkler_similarity("ab" * 50, "ba" * 50)
+    jarowinkler_similarity("東京都", "京都")
+    jarowinkler_similarity([1, 2, 3], [3, 2, 1])
+    jaro_similarity("abcdefgh", "stuvwxyz", score_cutoff=0.8)
+
+    result = get_stats()
+    assert result["enabled"]
+    assert result["calls"] == 7
+    assert result["paths"] == {
+        "empty": 1,
+        "length_rejected": 1,
+        "histogram_rejected": 0,
+        "single_word": 4,
+        "multi_word": 1,
+        "simd": 0,
+    }
+    assert result["hashed"] == 2
+    assert result["early_exits"] == 2
+    assert result["length_histogram"]["65-128"] == 2
+    check_consistent(result)
+
+
+def test_reset(stats):
+    jarowinkler_similarity("abc", "abd")
+    assert get_stats()["calls"] == 1
+    reset_stats()
+    assert get_stats()["calls"] == 0
+    jarowinkler_similarity("abc", "abd")
+    assert get_stats()["calls"] == 1
+
+
+def test_batch_functions(stats):
+    choices = ["abcd" * i for i in range(1, 40)] + ["wxyz" * i for i in range(1, 40)] + ["東京"] * 5 + [None]
+    jarowinkler_similarity_many("abcdabcd", choices, score_cutoff=0.8)
+    jarowinkler_similarity_many("abcd" * 20, choices)
+    extract("abcd", choices, score_cutoff=0.7, limit=None)
+    JaroWinklerIndex(choices).extract("abcdab")
+    JaroWinklerMatcher("abc").similarity("abd")
+
+    result = get_stats()
+    assert result["paths"]["histogram_rejected"] > 0
+    assert result["paths"]["multi_word"] > 0
+    assert result["hashed"] > 0
+    check_consistent(result)
+
+    # choices of lengths, which can not reach score_cutoff, are skipped without comparing them
+    reset_stats()
+    JaroWinklerIndex(["ЖЖЖЖЖЖЖЖ", "ЖЖЖЖЖЖЖЗ", "abcdefgh", "abcdefgh" * 4]).extract("aaaaaaaa", score_cutoff=0.9)
+    result = get_stats()
+    assert result["calls"] == 3
+    assert result["paths"]["histogram_rejected"] == 2
+    check_consistent(result)
+
+
+@pytest.mark.parametrize("score_cutoff", [0.9, 0.95])
+def test_same_path_in_all_apis(stats, score_cutoff):
+    """
+    the length bound is checked before the histogram filter in the batch functions as well
+    """
+    for query, choice in [("Johnathan", "Johnathan Smith" * 10), ("東京都", "京都大阪府兵庫県"), ("abc" * 30, "abc" * 10)]:
+        for search in [
+            lambda: jarowinkler_similarity(query, choice, score_cutoff=score_cutoff),
+            lambda: jarowinkler_similarity_many(query, [choice], score_cutoff=score_cutoff),
+            lambda: cdist([query], [choice], score_cutoff=score_cutoff),
+            lambda: extract(query, [choice], score_cutoff=score_cutoff),
+            lambda: jaro_similarity(query, choice, score_cutoff=score_cutoff),
+            lambda: cdist([query], [choice], scorer=jaro_similarity, score_cutoff=score_cutoff),
+        ]:
+            reset_stats()
+            search()
+            result = get_stats()
+            assert result["calls"] == 1
+            assert result["paths"]["length_rejected"] == 1
+
+
+@pytest.mark.parametrize("workers", [1, 4])
+def test_cdist_workers(stats, workers):
+    """
+    the counters of the worker threads are merged into the result
+    """
+    strings = ["abcd" * i for i in range(1, 40)] + ["東京"] * 5
+    cdist(strings, list(strings), workers=workers)
+    result = get_stats()
+    assert result["calls"] == len(strings) ** 2
+    check_consistent(result)
+
+
+def test_cdist_symmetric(stats):
+    """
+    only the upper triangle of the matrix is calculated, also by the SIMD kernel
+    """
+    strings = ["abcd" * (i % 8 + 1) for i in range(200)] + ["東京"] * 5
+    cdist(strings, strings)
+    result = get_stats()
+    assert result["calls"] == len(strings) * (len(strings) + 1) // 2
+    check_consistent(result)
+
+
+def test_self_join_window(stats):
+    """
+    only the pairs after each row, which are inside of its length window, are calculated
+    """
+    strings = ["abcd" * (i % 4 + 1) for i in range(40)]
+    self_join(strings, 0.99)
+    result = get_stats()
+    assert result["calls"] == 4 * (10 * 9 // 2)
+    check_consistent(result)
+
+
+def test_exited_threads(stats):
+    """
+    the counters of threads, which already exited, are kept
+    """
+
+    def work():
+        for _ in range(100):
+            jarowinkler_similarity("abc", "abd")
+
+    threads = [threading.Thread(target=work) for _ in range(4)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    assert get_stats()["calls"] == 400
+
+
+def test_stop_collecting(stats):
+    enable_stats(False)
+    jarowinkler_similarity("abc", "abd")
+    result = get_stats()
+    assert not result["enabled"]
+    assert result["calls"] == 0
@@ -0,0 +1,61 @@
+import pytest
+
+from jarowinkler import cdist, jaro_similarity_many, jarowinkler_similarity, jarowinkler_similarity_many
+
+CHOICES = ["Jonathan", "Johnathan", "", "Jon", "0" * 65, "nathan", "Jönathan", "Джонатан", "Jonathan 🙂"]
+
+
+def expected_scores(query, choices, **kwargs):
+    return [0.0 if choice is None else jarowinkler_similarity(query, choice, **kwargs) for choice in choices]
+
+
+@pytest.mark.parametrize("dtype", ["U", "S"])
+def test_numpy(dtype):
+    np = pytest.importorskip("numpy")
+    choices = CHOICES if dtype == "U" else [c for c in CHOICES if c.isascii()]
+    array = np.array(choices, dtype=dtype)
+    if dtype == "S":
+        choices = [c.encode() for c in choices]
+
+    for query in ["Johnathan", "Jönathan", "Джон"]:
+        query = query if dtype == "U" else query.encode("utf8")
+        for score_cutoff in [None, 0.9]:
+            result = jarowinkler_similarity_many(query, array, score_cutoff=score_cutoff)
+            assert result == pytest.approx(expected_scores(query, choices, score_cutoff=score_cutoff))
+
+    # strided views are read in place as well
+    assert jaro_similarity_many("Jon", array[::2]) == pytest.approx(jaro_similarity_many("Jon", list(array[::2])))
+
+
+@pytest.mark.parametrize("type_name", ["string", "large_string", "binary", "large_binary"])
+def test_arrow(type_name):
+    pa = pytest.importorskip("pyarrow")
+    choices = CHOICES + [None]
+    if "binary" in type_name:
+        choices = [None if c is None else c.encode() for c in choices]
+    array = pa.array(choices, type=getattr(pa, type_name)())
+
+    for query in ["Johnathan", "Jönathan", "Джон"]:
+        query = query if "string" in type_name else query.encode()
+        for score_cutoff in [None, 0.9]:
+            result = jarowinkler_similarity_many(query, array, score_cutoff=score_cutoff)
+            assert result == pytest.approx(expected_scores(query, choices, score_cutoff=score_cutoff))
+
+    # sliced arrays use an offset into the buffers
+    assert jarowinkler_similarity_many("Jon", array[3:7]) == pytest.approx(expected_scores("Jon", choices[3:7]))
+
+
+def test_arrow_cdist():
+    pa = pytest.importorskip("pyarrow")
+    array = pa.array(CHOICES)
+    result = cdist(array, array, dtype="float64").tolist()
+    for row, query in zip(result, CHOICES):
+        assert row == pytest.approx(expected_scores(query, CHOICES))
+
+
+def test_processor_uses_python_objects():
+    np = pytest.importorskip("numpy")
+    array = np.array(["JOHN", "jane"])
+    assert jarowinkler_similarity_many("john", array, processor=str.lower) == pytest.approx(
+        [1.0, jarowinkler_similarity("john", "jane")]
+    )
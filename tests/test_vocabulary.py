@@ -0,0 +1,99 @@
+import gc
+
+import pytest
+
+from jarowinkler import (
+    JaroWinklerIndex,
+    PreprocessedCorpus,
+    TokenVocabulary,
+    cdist,
+    extract,
+    jaro_similarity_many,
+    jarowinkler_similarity,
+    jarowinkler_similarity_many,
+)
+
+SENTENCES = ["this is an example", "this is a test", None, "", "an example is this", "東京 is a city"]
+
+
+def tokens(s):
+    return None if s is None else s.split()
+
+
+def test_ids_are_dense():
+    vocabulary = TokenVocabulary(["b", "a"])
+    assert vocabulary.tokens == ("b", "a")
+    vocabulary.encode_corpus(["a c", ["d", "b"]])
+    assert vocabulary.tokens == ("b", "a", "c", "d")
+    assert len(vocabulary) == 4
+    assert "c" in vocabulary
+    assert "e" not in vocabulary
+
+
+def test_same_as_token_lists():
+    vocabulary = TokenVocabulary()
+    corpus = vocabulary.encode_corpus(SENTENCES)
+    assert isinstance(corpus, PreprocessedCorpus)
+    assert corpus.processor is vocabulary
+    assert corpus.strings == tuple(SENTENCES)
+
+    lists = [tokens(s) for s in SENTENCES]
+    for s in SENTENCES[:2] + ["a completely new sentence"]:
+        query = vocabulary.encode(s)
+        assert jarowinkler_similarity_many(query, corpus) == jarowinkler_similarity_many(tokens(s), lists)
+        assert jaro_similarity_many(query, corpus) == jaro_similarity_many(tokens(s), lists)
+        assert cdist([query], corpus).tolist() == cdist([tokens(s)], lists).tolist()
+        for encoded, choice in zip(corpus, lists):
+            assert jarowinkler_similarity(query, encoded) == jarowinkler_similarity(tokens(s), choice)
+
+
+def test_elements():
+    vocabulary = TokenVocabulary()
+    corpus = vocabulary.encode_corpus(SENTENCES)
+    assert corpus[2] is None
+    assert list(corpus[0]) == ["this", "is", "an", "example"]
+    assert str(corpus[5]) == "['東京', 'is', 'a', 'city']"
+    assert corpus[5].original == "東京 is a city"
+    assert vocabulary.encode(None) is None
+
+
+def test_tokenizer():
+    vocabulary = TokenVocabulary()
+    query = vocabulary.encode("a-b-c", tokenizer=lambda s: s.split("-"))
+    assert list(query) == ["a", "b", "c"]
+    corpus = vocabulary.encode_corpus(["a-b", "c"], tokenizer=lambda s: s.split("-"))
+    assert list(corpus[0]) == ["a", "b"]
+    # sequences which are no str are used as tokens
+    assert list(vocabulary.encode([1, "a", (2, 3)])) == [1, "a", (2, 3)]
+
+
+def test_extract():
+    vocabulary = TokenVocabulary()
+    corpus = vocabulary.encode_corpus(SENTENCES)
+    query = vocabulary.encode("this is an example")
+    expected = jarowinkler_similarity(tokens(SENTENCES[0]), tokens(SENTENCES[1]))
+    assert extract(query, corpus, limit=2) == [("this is an example", 1.0, 0), ("this is a test", expected, 1)]
+    assert JaroWinklerIndex(corpus).extract(query, score_cutoff=0.99) == [("this is an example", 1.0, 0)]
+
+
+def test_many_tokens():
+    """
+    ids above 255 and 65535 use wider integers
+    """
+    vocabulary = TokenVocabulary(range(70000))
+    corpus = vocabulary.encode_corpus([[1, 300, 69999], [1, 300]])
+    assert jarowinkler_similarity_many(vocabulary.encode([1, 300, 69999]), corpus) == [
+        1.0,
+        jarowinkler_similarity([1, 300, 69999], [1, 300]),
+    ]
+
+
+def test_unhashable_token():
+    with pytest.raises(TypeError):
+        TokenVocabulary().encode([[1]])
+
+
+def test_corpus_outlives_vocabulary():
+    corpus = TokenVocabulary().encode_corpus(["a b"])
+    gc.collect()
+    assert list(corpus[0]) == ["a", "b"]